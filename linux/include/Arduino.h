@@ -0,0 +1,111 @@
+/*!
+ * @file
+ * @brief The subset of the Arduino core used by the bridge and its libraries, for Linux builds.
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+enum {
+  DEC = 10,
+  HEX = 16
+};
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void yield(void);
+
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+
+class String {
+ public:
+  String(const char* s = "");
+  String(const std::string& s);
+  String(char c);
+  String(int value, unsigned char base = DEC);
+  String(unsigned value, unsigned char base = DEC);
+  String(long value, unsigned char base = DEC);
+  String(unsigned long value, unsigned char base = DEC);
+  String(long long value, unsigned char base = DEC);
+  String(unsigned long long value, unsigned char base = DEC);
+
+  const char* c_str() const;
+  unsigned length() const;
+  bool reserve(unsigned size);
+  bool concat(const String& s);
+
+  String& operator+=(const String& s);
+  String& operator+=(const char* s);
+  String& operator+=(char c);
+  bool operator==(const String& s) const;
+  bool operator!=(const String& s) const;
+  char operator[](unsigned index) const;
+
+  friend String operator+(const String& a, const String& b);
+  friend String operator+(const String& a, const char* b);
+  friend String operator+(const char* a, const String& b);
+
+ private:
+  std::string value;
+};
+
+class Print {
+ public:
+  virtual ~Print() = default;
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* s);
+
+  size_t print(const char* s);
+  size_t print(const String& s);
+  size_t print(char c);
+  size_t print(int value, int base = DEC);
+  size_t print(unsigned value, int base = DEC);
+  size_t print(long value, int base = DEC);
+  size_t print(unsigned long value, int base = DEC);
+  size_t println(void);
+  size_t println(const char* s);
+  size_t println(const String& s);
+  size_t println(int value, int base = DEC);
+  size_t println(unsigned value, int base = DEC);
+  size_t println(long value, int base = DEC);
+  size_t println(unsigned long value, int base = DEC);
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+  virtual void flush() {}
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  size_t readBytes(uint8_t* buffer, size_t length);
+};
+
+// Console output for the log; there is no console input
+class ConsoleSerial : public Stream {
+ public:
+  void begin(unsigned long) {}
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  void flush() override;
+};
+
+extern ConsoleSerial Serial;
+
+#endif
@@ -0,0 +1,24 @@
+/*!
+ * @file
+ * @brief IPv4 address, as used by PubSubClient.
+ */
+
+#ifndef IPAddress_h
+#define IPAddress_h
+
+#include <cstdint>
+
+class IPAddress {
+ public:
+  IPAddress() : octets{ 0, 0, 0, 0 } {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : octets{ a, b, c, d } {}
+  IPAddress(const uint8_t* address) : octets{ address[0], address[1], address[2], address[3] } {}
+
+  uint8_t operator[](int index) const { return octets[index]; }
+  uint8_t& operator[](int index) { return octets[index]; }
+
+ private:
+  uint8_t octets[4];
+};
+
+#endif
@@ -0,0 +1,45 @@
+/*!
+ * @file
+ * @brief ESP32 Preferences on top of files, for Linux builds.
+ *
+ * Every namespace is a directory below the state directory and every key a file in it.
+ */
+
+#ifndef Preferences_h
+#define Preferences_h
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class Preferences {
+ public:
+  // Directory that holds every namespace, "." unless set before the first begin()
+  static void setStateDirectory(const char* directory);
+
+  bool begin(const char* name, bool readOnly = false);
+  void end();
+  bool clear();
+  bool isKey(const char* key);
+  size_t freeEntries();
+
+  size_t putUChar(const char* key, uint8_t value);
+  size_t putUShort(const char* key, uint16_t value);
+  size_t putUInt(const char* key, uint32_t value);
+  size_t putBytes(const char* key, const void* value, size_t length);
+
+  uint8_t getUChar(const char* key, uint8_t defaultValue = 0);
+  uint16_t getUShort(const char* key, uint16_t defaultValue = 0);
+  uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+  size_t getBytesLength(const char* key);
+  size_t getBytes(const char* key, void* buffer, size_t maxLength);
+
+ private:
+  std::string KeyPath(const char* key) const;
+
+  std::string directory;
+  bool opened = false;
+  bool readOnly = true;
+};
+
+#endif
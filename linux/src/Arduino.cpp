@@ -0,0 +1,257 @@
+/*!
+ * @file
+ * @brief
+ */
+
+#include <Arduino.h>
+#include <cstdarg>
+#include <ctime>
+#include <unistd.h>
+
+ConsoleSerial Serial;
+
+static uint64_t MonotonicMicroseconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+unsigned long millis(void)
+{
+  return MonotonicMicroseconds() / 1000;
+}
+
+unsigned long micros(void)
+{
+  return MonotonicMicroseconds();
+}
+
+void delay(unsigned long ms)
+{
+  usleep(ms * 1000);
+}
+
+void yield(void)
+{
+}
+
+// The heap statistics published by the bridge have no meaning for a Linux process
+uint32_t esp_get_free_heap_size(void)
+{
+  return 0;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+  return 0;
+}
+
+static std::string ToBase(unsigned long long value, unsigned char base)
+{
+  if(base != HEX) {
+    return std::to_string(value);
+  }
+
+  char buffer[20];
+  snprintf(buffer, sizeof(buffer), "%llx", value);
+  return buffer;
+}
+
+String::String(const char* s) : value(s ? s : "") {}
+String::String(const std::string& s) : value(s) {}
+String::String(char c) : value(1, c) {}
+String::String(int v, unsigned char base) : value((base == HEX) ? ToBase((unsigned)v, base) : std::to_string(v)) {}
+String::String(unsigned v, unsigned char base) : value(ToBase(v, base)) {}
+String::String(long v, unsigned char base) : value((base == HEX) ? ToBase((unsigned long)v, base) : std::to_string(v)) {}
+String::String(unsigned long v, unsigned char base) : value(ToBase(v, base)) {}
+String::String(long long v, unsigned char base) : value((base == HEX) ? ToBase((unsigned long long)v, base) : std::to_string(v)) {}
+String::String(unsigned long long v, unsigned char base) : value(ToBase(v, base)) {}
+
+const char* String::c_str() const
+{
+  return value.c_str();
+}
+
+unsigned String::length() const
+{
+  return value.length();
+}
+
+bool String::reserve(unsigned size)
+{
+  value.reserve(size);
+  return true;
+}
+
+bool String::concat(const String& s)
+{
+  value += s.value;
+  return true;
+}
+
+String& String::operator+=(const String& s)
+{
+  value += s.value;
+  return *this;
+}
+
+String& String::operator+=(const char* s)
+{
+  value += s;
+  return *this;
+}
+
+String& String::operator+=(char c)
+{
+  value += c;
+  return *this;
+}
+
+bool String::operator==(const String& s) const
+{
+  return value == s.value;
+}
+
+bool String::operator!=(const String& s) const
+{
+  return value != s.value;
+}
+
+char String::operator[](unsigned index) const
+{
+  return (index < value.length()) ? value[index] : 0;
+}
+
+String operator+(const String& a, const String& b)
+{
+  return String(a.value + b.value);
+}
+
+String operator+(const String& a, const char* b)
+{
+  return String(a.value + b);
+}
+
+String operator+(const char* a, const String& b)
+{
+  return String(a + b.value);
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+  size_t written = 0;
+  while(size--) {
+    written += write(*buffer++);
+  }
+  return written;
+}
+
+size_t Print::write(const char* s)
+{
+  return write(reinterpret_cast<const uint8_t*>(s), strlen(s));
+}
+
+size_t Print::print(const char* s)
+{
+  return write(s);
+}
+
+size_t Print::print(const String& s)
+{
+  return write(s.c_str());
+}
+
+size_t Print::print(char c)
+{
+  return write((uint8_t)c);
+}
+
+size_t Print::print(int value, int base)
+{
+  return print(String(value, base));
+}
+
+size_t Print::print(unsigned value, int base)
+{
+  return print(String(value, base));
+}
+
+size_t Print::print(long value, int base)
+{
+  return print(String(value, base));
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+  return print(String(value, base));
+}
+
+size_t Print::println(void)
+{
+  return write("\n");
+}
+
+size_t Print::println(const char* s)
+{
+  return print(s) + println();
+}
+
+size_t Print::println(const String& s)
+{
+  return print(s) + println();
+}
+
+size_t Print::println(int value, int base)
+{
+  return print(value, base) + println();
+}
+
+size_t Print::println(unsigned value, int base)
+{
+  return print(value, base) + println();
+}
+
+size_t Print::println(long value, int base)
+{
+  return print(value, base) + println();
+}
+
+size_t Print::println(unsigned long value, int base)
+{
+  return print(value, base) + println();
+}
+
+size_t Print::printf(const char* format, ...)
+{
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  return write(buffer);
+}
+
+size_t Stream::readBytes(uint8_t* buffer, size_t length)
+{
+  size_t count = 0;
+  while((count < length) && (available() > 0)) {
+    buffer[count++] = read();
+  }
+  return count;
+}
+
+size_t ConsoleSerial::write(uint8_t c)
+{
+  return fwrite(&c, 1, 1, stdout);
+}
+
+size_t ConsoleSerial::write(const uint8_t* buffer, size_t size)
+{
+  return fwrite(buffer, 1, size, stdout);
+}
+
+void ConsoleSerial::flush()
+{
+  fflush(stdout);
+}
@@ -0,0 +1,111 @@
+/*!
+ * @file
+ * @brief
+ */
+
+#include "PosixSerial.h"
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+static speed_t BaudToSpeed(unsigned long baud)
+{
+  switch(baud) {
+    case 9600:
+      return B9600;
+    case 19200:
+      return B19200;
+    case 38400:
+      return B38400;
+    case 57600:
+      return B57600;
+    case 115200:
+      return B115200;
+    case 230400:
+      return B230400;
+    default:
+      return B0;
+  }
+}
+
+PosixSerial::~PosixSerial()
+{
+  if(fd >= 0) {
+    close(fd);
+  }
+}
+
+bool PosixSerial::begin(const char* device, unsigned long baud, bool localEcho)
+{
+  speed_t speed = BaudToSpeed(baud);
+  if(speed == B0) {
+    return false;
+  }
+
+  fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if(fd < 0) {
+    return false;
+  }
+
+  struct termios options;
+  if(tcgetattr(fd, &options) != 0) {
+    close(fd);
+    fd = -1;
+    return false;
+  }
+  cfmakeraw(&options);
+  options.c_cflag |= CLOCAL | CREAD;
+  options.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+  options.c_cc[VMIN] = 0;
+  options.c_cc[VTIME] = 0;
+  cfsetispeed(&options, speed);
+  cfsetospeed(&options, speed);
+  tcsetattr(fd, TCSANOW, &options);
+  tcflush(fd, TCIOFLUSH);
+
+  this->localEcho = localEcho;
+  return true;
+}
+
+void PosixSerial::Fill()
+{
+  uint8_t buffer[256];
+  ssize_t count;
+  while((fd >= 0) && ((count = ::read(fd, buffer, sizeof(buffer))) > 0)) {
+    received.insert(received.end(), buffer, buffer + count);
+  }
+}
+
+size_t PosixSerial::write(uint8_t c)
+{
+  if((fd < 0) || (::write(fd, &c, 1) != 1)) {
+    return 0;
+  }
+  if(localEcho) {
+    received.push_back(c);
+  }
+  return 1;
+}
+
+int PosixSerial::available()
+{
+  Fill();
+  return received.size();
+}
+
+int PosixSerial::read()
+{
+  Fill();
+  if(received.empty()) {
+    return -1;
+  }
+  uint8_t c = received.front();
+  received.pop_front();
+  return c;
+}
+
+int PosixSerial::peek()
+{
+  Fill();
+  return received.empty() ? -1 : received.front();
+}
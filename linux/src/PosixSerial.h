@@ -0,0 +1,35 @@
+/*!
+ * @file
+ * @brief Arduino Stream over a Linux serial device or pty.
+ *
+ * GEA2 is a single wire bus and the GEA2 interface checks that every byte it sends is read back.
+ * Adapters wired to a real bus echo naturally; with local echo enabled, written bytes are also
+ * queued for reading, which is what a pty needs.
+ */
+
+#ifndef PosixSerial_h
+#define PosixSerial_h
+
+#include <Arduino.h>
+#include <deque>
+
+class PosixSerial : public Stream {
+ public:
+  ~PosixSerial() override;
+
+  bool begin(const char* device, unsigned long baud, bool localEcho);
+
+  size_t write(uint8_t c) override;
+  int available() override;
+  int read() override;
+  int peek() override;
+
+ private:
+  void Fill();
+
+  int fd = -1;
+  bool localEcho = false;
+  std::deque<uint8_t> received;
+};
+
+#endif
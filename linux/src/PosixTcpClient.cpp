@@ -0,0 +1,156 @@
+/*!
+ * @file
+ * @brief
+ */
+
+#include "PosixTcpClient.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+PosixTcpClient::~PosixTcpClient()
+{
+  stop();
+}
+
+int PosixTcpClient::connect(IPAddress ip, uint16_t port)
+{
+  char host[16];
+  snprintf(host, sizeof(host), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+  return connect(host, port);
+}
+
+// The connection is made blocking and then switched to non-blocking, as PubSubClient polls
+// available() from the main loop
+int PosixTcpClient::connect(const char* host, uint16_t port)
+{
+  stop();
+
+  struct addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* addresses;
+  if(getaddrinfo(host, std::to_string(port).c_str(), &hints, &addresses) != 0) {
+    return 0;
+  }
+
+  for(struct addrinfo* address = addresses; address != nullptr; address = address->ai_next) {
+    fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+    if(fd < 0) {
+      continue;
+    }
+    if(::connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+      break;
+    }
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(addresses);
+
+  if(fd < 0) {
+    return 0;
+  }
+
+  int noDelay = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return 1;
+}
+
+size_t PosixTcpClient::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+size_t PosixTcpClient::write(const uint8_t* buffer, size_t size)
+{
+  size_t written = 0;
+  while((fd >= 0) && (written < size)) {
+    ssize_t count = send(fd, buffer + written, size - written, MSG_NOSIGNAL);
+    if(count > 0) {
+      written += count;
+    }
+    else if((count < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+      usleep(1000);
+    }
+    else {
+      stop();
+    }
+  }
+  return written;
+}
+
+int PosixTcpClient::available()
+{
+  if(fd < 0) {
+    return 0;
+  }
+  int count = 0;
+  ioctl(fd, FIONREAD, &count);
+  return count + ((peeked >= 0) ? 1 : 0);
+}
+
+int PosixTcpClient::read()
+{
+  uint8_t c;
+  return (read(&c, 1) == 1) ? c : -1;
+}
+
+int PosixTcpClient::read(uint8_t* buffer, size_t size)
+{
+  if((fd < 0) || (size == 0)) {
+    return -1;
+  }
+
+  size_t count = 0;
+  if(peeked >= 0) {
+    buffer[count++] = peeked;
+    peeked = -1;
+  }
+
+  ssize_t received = recv(fd, buffer + count, size - count, 0);
+  if(received > 0) {
+    count += received;
+  }
+  else if((received == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK))) {
+    stop();
+  }
+  return (count > 0) ? (int)count : -1;
+}
+
+int PosixTcpClient::peek()
+{
+  if(peeked < 0) {
+    peeked = read();
+  }
+  return peeked;
+}
+
+void PosixTcpClient::stop()
+{
+  if(fd >= 0) {
+    close(fd);
+    fd = -1;
+  }
+  peeked = -1;
+}
+
+uint8_t PosixTcpClient::connected()
+{
+  if(fd < 0) {
+    return 0;
+  }
+
+  char c;
+  ssize_t received = recv(fd, &c, 1, MSG_PEEK);
+  if((received == 0) || ((received < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK))) {
+    stop();
+    return 0;
+  }
+  return 1;
+}
@@ -0,0 +1,33 @@
+/*!
+ * @file
+ * @brief Arduino Client over a non-blocking TCP socket, for PubSubClient.
+ */
+
+#ifndef PosixTcpClient_h
+#define PosixTcpClient_h
+
+#include <Client.h>
+
+class PosixTcpClient : public Client {
+ public:
+  ~PosixTcpClient() override;
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buffer, size_t size) override;
+  int peek() override;
+  void flush() override {}
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override { return fd >= 0; }
+
+ private:
+  int fd = -1;
+  int peeked = -1;
+};
+
+#endif
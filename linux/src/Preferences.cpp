@@ -0,0 +1,156 @@
+/*!
+ * @file
+ * @brief
+ */
+
+#include <Preferences.h>
+#include <cerrno>
+#include <cstdio>
+#include <dirent.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Roughly what an ESP32 NVS partition offers, so the free entry count logged by the bridge
+// stays meaningful
+enum {
+  nominal_free_entries = 500
+};
+
+static std::string stateDirectory = ".";
+
+void Preferences::setStateDirectory(const char* directory)
+{
+  stateDirectory = directory;
+}
+
+bool Preferences::begin(const char* name, bool readOnly)
+{
+  directory = stateDirectory + "/" + name;
+  if((mkdir(directory.c_str(), 0755) != 0) && (errno != EEXIST)) {
+    return false;
+  }
+  this->readOnly = readOnly;
+  opened = true;
+  return true;
+}
+
+void Preferences::end()
+{
+  opened = false;
+}
+
+std::string Preferences::KeyPath(const char* key) const
+{
+  return directory + "/" + key;
+}
+
+bool Preferences::clear()
+{
+  if(!opened || readOnly) {
+    return false;
+  }
+
+  DIR* dir = opendir(directory.c_str());
+  if(dir == nullptr) {
+    return false;
+  }
+  while(struct dirent* entry = readdir(dir)) {
+    if(entry->d_name[0] != '.') {
+      unlink(KeyPath(entry->d_name).c_str());
+    }
+  }
+  closedir(dir);
+  return true;
+}
+
+bool Preferences::isKey(const char* key)
+{
+  struct stat info;
+  return opened && (stat(KeyPath(key).c_str(), &info) == 0);
+}
+
+size_t Preferences::freeEntries()
+{
+  return nominal_free_entries;
+}
+
+// Values are written to a temporary file and renamed into place, so a crash never leaves a
+// partly written key
+size_t Preferences::putBytes(const char* key, const void* value, size_t length)
+{
+  if(!opened || readOnly) {
+    return 0;
+  }
+
+  std::string path = KeyPath(key);
+  std::string temporary = path + ".new";
+  FILE* file = fopen(temporary.c_str(), "wb");
+  if(file == nullptr) {
+    return 0;
+  }
+  size_t written = fwrite(value, 1, length, file);
+  if((fclose(file) != 0) || (written != length) || (rename(temporary.c_str(), path.c_str()) != 0)) {
+    unlink(temporary.c_str());
+    return 0;
+  }
+  return written;
+}
+
+size_t Preferences::putUChar(const char* key, uint8_t value)
+{
+  return putBytes(key, &value, sizeof(value));
+}
+
+size_t Preferences::putUShort(const char* key, uint16_t value)
+{
+  return putBytes(key, &value, sizeof(value));
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value)
+{
+  return putBytes(key, &value, sizeof(value));
+}
+
+size_t Preferences::getBytesLength(const char* key)
+{
+  struct stat info;
+  if(!opened || (stat(KeyPath(key).c_str(), &info) != 0)) {
+    return 0;
+  }
+  return info.st_size;
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, size_t maxLength)
+{
+  size_t length = getBytesLength(key);
+  if((length == 0) || (length > maxLength)) {
+    return 0;
+  }
+
+  FILE* file = fopen(KeyPath(key).c_str(), "rb");
+  if(file == nullptr) {
+    return 0;
+  }
+  size_t read = fread(buffer, 1, length, file);
+  fclose(file);
+  return read;
+}
+
+uint8_t Preferences::getUChar(const char* key, uint8_t defaultValue)
+{
+  uint8_t value;
+  return (getBytes(key, &value, sizeof(value)) == sizeof(value)) ? value : defaultValue;
+}
+
+uint16_t Preferences::getUShort(const char* key, uint16_t defaultValue)
+{
+  uint16_t value;
+  return (getBytes(key, &value, sizeof(value)) == sizeof(value)) ? value : defaultValue;
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue)
+{
+  uint32_t value;
+  return (getBytes(key, &value, sizeof(value)) == sizeof(value)) ? value : defaultValue;
+}
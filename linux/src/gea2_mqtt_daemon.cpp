@@ -0,0 +1,186 @@
+/*!
+ * @file
+ * @brief Linux process that bridges one or more GEA2 serial buses to an MQTT broker.
+ *
+ * Every bus gets its own serial device, MQTT connection and HomeAssistantGea2Bridge, and all of
+ * them are run from one loop. The bridge state of a bus is kept under the state directory in a
+ * namespace named after its device ID; polling profiles are shared.
+ */
+
+// The native unit tests in test/ bring their own main
+#ifndef PIO_UNIT_TESTING
+
+#include <Arduino.h>
+#include <PubSubClient.h>
+#include <Preferences.h>
+#include <csignal>
+#include <getopt.h>
+#include <memory>
+#include <unistd.h>
+#include <vector>
+#include "HomeAssistantGea2Bridge.h"
+#include "PosixSerial.h"
+#include "PosixTcpClient.h"
+
+enum {
+  default_mqtt_port = 1883,
+  default_client_address = 0xE4,
+  mqtt_retry_period = 5000,
+  idle_sleep_us = 200
+};
+
+struct Bus {
+  const char* device;
+  const char* deviceId;
+  uint8_t clientAddress;
+  PosixSerial serial;
+  PosixTcpClient tcpClient;
+  PubSubClient mqttClient{ tcpClient };
+  HomeAssistantGea2Bridge bridge;
+  unsigned long lastConnectAttempt;
+  bool connectAttempted;
+};
+
+static volatile sig_atomic_t running = 1;
+
+static void Usage(const char* program)
+{
+  fprintf(
+    stderr,
+    "Usage: %s --broker HOST[:PORT] [--user USER] [--password PASSWORD] [--state DIRECTORY] [--echo]\n"
+    "          --bus DEVICE,DEVICE_ID[,CLIENT_ADDRESS] [--bus ...]\n"
+    "\n"
+    "  --broker    MQTT broker, port 1883 unless given\n"
+    "  --state     directory for the bridge state, the current directory by default\n"
+    "  --echo      read back every byte written, for buses that do not echo (such as a pty)\n"
+    "  --bus       serial device, MQTT device ID and optionally the GEA2 address of the bridge\n"
+    "              (0xE4 by default); repeat for every bus\n",
+    program);
+}
+
+static std::unique_ptr<Bus> ParseBus(char* argument)
+{
+  std::unique_ptr<Bus> bus(new Bus());
+  bus->device = strtok(argument, ",");
+  bus->deviceId = strtok(nullptr, ",");
+  const char* clientAddress = strtok(nullptr, ",");
+  bus->clientAddress = clientAddress ? strtoul(clientAddress, nullptr, 0) : (unsigned long)default_client_address;
+
+  if((bus->device == nullptr) || (bus->deviceId == nullptr)) {
+    return nullptr;
+  }
+  return bus;
+}
+
+static void ConnectToMqtt(Bus& bus, const char* user, const char* password)
+{
+  if(bus.mqttClient.connected() ||
+    (bus.connectAttempted && (millis() - bus.lastConnectAttempt < mqtt_retry_period))) {
+    return;
+  }
+
+  bus.connectAttempted = true;
+  bus.lastConnectAttempt = millis();
+  Serial.print(String(bus.deviceId) + ": attempting MQTT connection...");
+  if(bus.mqttClient.connect("", user, password)) {
+    Serial.println("connected");
+    bus.bridge.notifyMqttDisconnected();
+  }
+  else {
+    Serial.println("failed, rc=" + String(bus.mqttClient.state()));
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  static const struct option options[] = {
+    { "broker", required_argument, nullptr, 'b' },
+    { "user", required_argument, nullptr, 'u' },
+    { "password", required_argument, nullptr, 'p' },
+    { "state", required_argument, nullptr, 's' },
+    { "echo", no_argument, nullptr, 'e' },
+    { "bus", required_argument, nullptr, 'B' },
+    { nullptr, 0, nullptr, 0 }
+  };
+
+  char* broker = nullptr;
+  uint16_t port = default_mqtt_port;
+  const char* user = nullptr;
+  const char* password = nullptr;
+  bool localEcho = false;
+  std::vector<std::unique_ptr<Bus>> buses;
+
+  int option;
+  while((option = getopt_long(argc, argv, "", options, nullptr)) != -1) {
+    switch(option) {
+      case 'b': {
+        broker = optarg;
+        char* separator = strrchr(broker, ':');
+        if(separator != nullptr) {
+          *separator = '\0';
+          port = strtoul(separator + 1, nullptr, 10);
+        }
+      } break;
+
+      case 'u':
+        user = optarg;
+        break;
+
+      case 'p':
+        password = optarg;
+        break;
+
+      case 's':
+        Preferences::setStateDirectory(optarg);
+        break;
+
+      case 'e':
+        localEcho = true;
+        break;
+
+      case 'B': {
+        auto bus = ParseBus(optarg);
+        if(!bus) {
+          Usage(argv[0]);
+          return 1;
+        }
+        buses.push_back(std::move(bus));
+      } break;
+
+      default:
+        Usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if((broker == nullptr) || buses.empty()) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+  signal(SIGINT, [](int) { running = 0; });
+  signal(SIGTERM, [](int) { running = 0; });
+
+  for(auto& bus : buses) {
+    if(!bus->serial.begin(bus->device, HomeAssistantGea2Bridge::baud, localEcho)) {
+      fprintf(stderr, "Cannot open %s\n", bus->device);
+      return 1;
+    }
+    bus->mqttClient.setServer(broker, port);
+    bus->bridge.begin(bus->mqttClient, bus->serial, bus->deviceId, bus->clientAddress, bus->deviceId);
+  }
+
+  while(running) {
+    for(auto& bus : buses) {
+      ConnectToMqtt(*bus, user, password);
+      bus->bridge.loop();
+    }
+    usleep(idle_sleep_us);
+  }
+
+  Serial.println("Stopping");
+  return 0;
+}
+
+#endif
@@ -3,10 +3,14 @@
  * @brief Erd lists for various appliances
  */
 
+#include <stddef.h>
+
+extern "C" {
 #include "ApplianceErds.h"
 #include "tiny_erd.h"
+}
 
-static const tiny_erd_t commonErds[] = {
+static constexpr tiny_erd_t commonErds[] = {
   0x0001,
   0x0002,
   0x0004,
@@ -38,9 +42,8 @@ static const tiny_erd_t commonErds[] = {
   0x0051,
   0x0052
 };
-static const uint16_t commonErdCount = sizeof(commonErds) / sizeof(commonErds[0]);
 
-static const tiny_erd_t refrigerationErds[] = {
+static constexpr tiny_erd_t refrigerationErds[] = {
   0x1000,
   0x1001,
   0x1003,
@@ -529,9 +532,8 @@ static const tiny_erd_t refrigerationErds[] = {
   0x141d,
   0x141e
 };
-static const uint16_t refrigerationErdCount = sizeof(refrigerationErds) / sizeof(refrigerationErds[0]);
 
-static const tiny_erd_t laundryErds[] = {
+static constexpr tiny_erd_t laundryErds[] = {
   0x2000,
   0x2001,
   0x2002,
@@ -959,9 +961,8 @@ static const tiny_erd_t laundryErds[] = {
   0x2f1a,
   0x2f1b
 };
-static const uint16_t laundryErdCount = sizeof(laundryErds) / sizeof(laundryErds[0]);
 
-static const tiny_erd_t dishWasherErds[] = {
+static constexpr tiny_erd_t dishWasherErds[] = {
   0x3000,
   0x3001,
   0x3003,
@@ -1104,9 +1105,8 @@ static const tiny_erd_t dishWasherErds[] = {
   0x361c,
   0x361d
 };
-static const uint16_t dishWasherErdCount = sizeof(dishWasherErds) / sizeof(dishWasherErds[0]);
 
-static const tiny_erd_t waterHeaterErds[] = {
+static constexpr tiny_erd_t waterHeaterErds[] = {
   0x4008,
   0x4009,
   0x400a,
@@ -1172,9 +1172,8 @@ static const tiny_erd_t waterHeaterErds[] = {
   0x4225,
   0x4226
 };
-static const uint16_t waterHeaterErdCount = sizeof(waterHeaterErds) / sizeof(waterHeaterErds[0]);
 
-static const tiny_erd_t rangeErds[] = {
+static constexpr tiny_erd_t rangeErds[] = {
   0x5000,
   0x5001,
   0x5003,
@@ -1681,9 +1680,8 @@ static const tiny_erd_t rangeErds[] = {
   0x5c40,
   0x5c41
 };
-static const uint16_t rangeErdCount = sizeof(rangeErds) / sizeof(rangeErds[0]);
 
-static const tiny_erd_t airConditioningErds[] = {
+static constexpr tiny_erd_t airConditioningErds[] = {
   0x7000,
   0x7001,
   0x7002,
@@ -1988,9 +1986,8 @@ static const tiny_erd_t airConditioningErds[] = {
   0x7b0e,
   0x7b0f
 };
-static const uint16_t airConditioningErdCount = sizeof(airConditioningErds) / sizeof(airConditioningErds[0]);
 
-static const tiny_erd_t waterFilterErds[] = {
+static constexpr tiny_erd_t waterFilterErds[] = {
   0x8000,
   0x8001,
   0x8002,
@@ -2046,9 +2043,8 @@ static const tiny_erd_t waterFilterErds[] = {
   0x8034,
   0x8035,
 };
-static const uint16_t waterFilterErdCount = sizeof(waterFilterErds) / sizeof(waterFilterErds[0]);
 
-static const tiny_erd_t smallApplianceErds[] = {
+static constexpr tiny_erd_t smallApplianceErds[] = {
   0x9000,
   0x9001,
   0x9002,
@@ -2339,9 +2335,8 @@ static const tiny_erd_t smallApplianceErds[] = {
   0x9500,
   0x9501
 };
-const uint16_t smallApplianceErdCount = sizeof(smallApplianceErds) / sizeof(smallApplianceErds[0]);
 
-const tiny_erd_t energyErds[] = {
+static constexpr tiny_erd_t energyErds[] = {
   0xd001,
   0xd002,
   0xd003,
@@ -2388,85 +2383,457 @@ const tiny_erd_t energyErds[] = {
   0xd205,
   0xd207
 };
-static const uint16_t energyErdCount = sizeof(energyErds) / sizeof(energyErds[0]);
 
-static const tiny_erd_list_t commonErdList = { commonErds, commonErdCount };
+template <size_t N>
+struct ErdTable {
+  tiny_erd_t erds[N];
+  uint16_t count;
+};
+
+template <size_t N>
+static constexpr void InsertSorted(ErdTable<N>& table, tiny_erd_t erd)
+{
+  uint16_t position = table.count;
+  while((position > 0) && (table.erds[position - 1] > erd)) {
+    position--;
+  }
+  if((position > 0) && (table.erds[position - 1] == erd)) {
+    return;
+  }
+  for(uint16_t i = table.count; i > position; i--) {
+    table.erds[i] = table.erds[i - 1];
+  }
+  table.erds[position] = erd;
+  table.count++;
+}
+
+template <size_t A, size_t B, size_t C>
+static constexpr ErdTable<A + B + C> SortedUnion(const tiny_erd_t (&a)[A], const tiny_erd_t (&b)[B], const tiny_erd_t (&c)[C])
+{
+  ErdTable<A + B + C> table = {};
+  for(size_t i = 0; i < A; i++) {
+    InsertSorted(table, a[i]);
+  }
+  for(size_t i = 0; i < B; i++) {
+    InsertSorted(table, b[i]);
+  }
+  for(size_t i = 0; i < C; i++) {
+    InsertSorted(table, c[i]);
+  }
+  return table;
+}
+
+template <size_t N>
+static constexpr uint16_t RangeCount(const ErdTable<N>& table)
+{
+  uint16_t count = (table.count > 0) ? 1 : 0;
+  for(uint16_t i = 1; i < table.count; i++) {
+    if(table.erds[i] != table.erds[i - 1] + 1) {
+      count++;
+    }
+  }
+  return count;
+}
+
+template <size_t R>
+struct ErdRanges {
+  erd_range_t ranges[R];
+  uint16_t rangeCount;
+  uint16_t erdCount;
+};
+
+template <size_t R, size_t N>
+static constexpr ErdRanges<R> ToRanges(const ErdTable<N>& table)
+{
+  ErdRanges<R> ranges = {};
+  uint16_t range = 0;
+  for(uint16_t i = 0; i < table.count; i++) {
+    if((i > 0) && (table.erds[i] == table.erds[i - 1] + 1)) {
+      ranges.ranges[range - 1].count++;
+    }
+    else {
+      ranges.ranges[range].first = table.erds[i];
+      ranges.ranges[range].count = 1;
+      range++;
+    }
+  }
+  ranges.rangeCount = range;
+  ranges.erdCount = table.count;
+  return ranges;
+}
+
+template <size_t N, size_t X>
+static constexpr ErdTable<N> Without(const ErdTable<N>& source, const erd_range_t (&exclusions)[X])
+{
+  ErdTable<N> table = {};
+  for(uint16_t i = 0; i < source.count; i++) {
+    bool excluded = false;
+    for(size_t x = 0; x < X; x++) {
+      if((source.erds[i] >= exclusions[x].first) && (source.erds[i] - exclusions[x].first < exclusions[x].count)) {
+        excluded = true;
+      }
+    }
+    if(!excluded) {
+      table.erds[table.count++] = source.erds[i];
+    }
+  }
+  return table;
+}
+
+// Exclusion masks for appliance types that share a family list but can never answer parts of it
+static constexpr erd_range_t noExclusions[] = {
+  { 0x0000, 0 }
+};
+
+// Delivery Box and In-Home Grower: keep the 0x10xx compartment, door and mode ERDs, drop the
+// ice, dispenser, drawer and full-size refrigerator blocks
+static constexpr erd_range_t refrigeratedCompartmentExclusions[] = {
+  { 0x1100, 0x0400 }
+};
+
+// Smart Plug: a plug meters energy but has none of the small appliance functions
+static constexpr erd_range_t smartPlugExclusions[] = {
+  { 0x9000, 0x0600 }
+};
+
+// BLE Mesh Gateway: no appliance function and no metering, only the common ERDs
+static constexpr erd_range_t gatewayExclusions[] = {
+  { 0x9000, 0x0600 },
+  { 0xD000, 0x0300 }
+};
+
+// Hit-probability score of ERD blocks. Discovery probes scored candidates first, highest score
+// first, so the ERDs that nearly every appliance has and that a dashboard needs are published
+// early. The blocks are taken from the lists themselves: the identity ERDs and the rest of the
+// common list, the status block at the start of each family list and the start of the energy list.
+struct ErdScore {
+  tiny_erd_t first;
+  uint16_t count;
+  uint8_t score;
+};
+
+enum {
+  identity_erd_count = 8,
+  status_block_erd_count = 16
+};
 
-const tiny_erd_list_t* GetCommonErdList(void)
+// A block covers the ERDs from the lowest to the highest of count entries of a list, which are
+// exactly those entries in the sorted lists
+template <size_t N>
+static constexpr ErdScore Block(const tiny_erd_t (&erds)[N], size_t start, size_t count, uint8_t score)
 {
-  return &commonErdList;
+  tiny_erd_t lowest = erds[start];
+  tiny_erd_t highest = erds[start];
+  for(size_t i = start; (i < start + count) && (i < N); i++) {
+    lowest = (erds[i] < lowest) ? erds[i] : lowest;
+    highest = (erds[i] > highest) ? erds[i] : highest;
+  }
+  return { lowest, (uint16_t)(highest - lowest + 1), score };
+}
+
+template <size_t N>
+static constexpr ErdScore StatusBlock(const tiny_erd_t (&erds)[N])
+{
+  return Block(erds, 0, status_block_erd_count, 200);
+}
+
+static constexpr ErdScore erdScores[] = {
+  Block(commonErds, 0, identity_erd_count, 250), // Model and serial number, appliance type
+  StatusBlock(refrigerationErds), // Refrigeration temperatures and setpoints
+  StatusBlock(laundryErds), // Laundry machine state, cycle and time remaining
+  StatusBlock(dishWasherErds), // Dishwasher operating mode and cycle state
+  StatusBlock(waterHeaterErds), // Water heater mode and temperatures
+  StatusBlock(rangeErds), // Range cooking status
+  StatusBlock(airConditioningErds), // Air conditioning mode, setpoint and fan
+  StatusBlock(waterFilterErds), // Water filter state and usage
+  StatusBlock(smallApplianceErds), // Small appliance status
+  Block(energyErds, 0, status_block_erd_count, 150), // Energy usage
+  Block(commonErds, identity_erd_count, sizeof(commonErds) / sizeof(commonErds[0]), 100) // Clock and common settings
 };
 
-static const tiny_erd_list_t energyErdList = { energyErds, energyErdCount };
+static constexpr uint8_t ErdScoreOf(tiny_erd_t erd)
+{
+  uint8_t score = 0;
+  for(auto& block : erdScores) {
+    if((erd >= block.first) && (erd - block.first < block.count) && (block.score > score)) {
+      score = block.score;
+    }
+  }
+  return score;
+}
+
+template <size_t N>
+static constexpr uint16_t PriorityCount(const ErdTable<N>& table)
+{
+  uint16_t count = 0;
+  for(uint16_t i = 0; i < table.count; i++) {
+    count += (ErdScoreOf(table.erds[i]) > 0) ? 1 : 0;
+  }
+  return count;
+}
+
+template <size_t P>
+struct ErdPriority {
+  uint16_t indexes[(P > 0) ? P : 1];
+  uint16_t count;
+};
 
-const tiny_erd_list_t* GetEnergyErdList(void)
+// Indexes of the scored ERDs, by descending score and ascending ERD within a score
+template <size_t P, size_t N>
+static constexpr ErdPriority<P> ToPriority(const ErdTable<N>& table)
 {
-  return &energyErdList;
+  ErdPriority<P> priority = {};
+  for(uint16_t i = 0; i < table.count; i++) {
+    uint8_t score = ErdScoreOf(table.erds[i]);
+    if(score == 0) {
+      continue;
+    }
+    uint16_t position = priority.count;
+    while((position > 0) && (ErdScoreOf(table.erds[priority.indexes[position - 1]]) < score)) {
+      priority.indexes[position] = priority.indexes[position - 1];
+      position--;
+    }
+    priority.indexes[position] = i;
+    priority.count++;
+  }
+  return priority;
+}
+
+// Everything worth probing on one appliance type: common, energy and family ERDs less the
+// type's exclusions, sorted with duplicates removed and stored as runs of consecutive ERDs.
+template <const auto& familyErds, const auto& exclusions>
+static constexpr auto mergedErds = Without(SortedUnion(commonErds, energyErds, familyErds), exclusions);
+
+template <const auto& familyErds, const auto& exclusions>
+static constexpr auto candidateErds = ToRanges<RangeCount(mergedErds<familyErds, exclusions>)>(mergedErds<familyErds, exclusions>);
+
+template <const auto& familyErds, const auto& exclusions>
+static constexpr auto candidatePriority = ToPriority<PriorityCount(mergedErds<familyErds, exclusions>)>(mergedErds<familyErds, exclusions>);
+
+template <const auto& familyErds, const auto& exclusions = noExclusions>
+static constexpr erd_range_list_t candidateList = {
+  candidateErds<familyErds, exclusions>.ranges,
+  candidateErds<familyErds, exclusions>.rangeCount,
+  candidateErds<familyErds, exclusions>.erdCount,
+  candidatePriority<familyErds, exclusions>.indexes,
+  candidatePriority<familyErds, exclusions>.count
+};
+
+// Poll rates by family. While a family with a state ERD is idle its cycle is stretched, but the
+// state ERD is still read every few seconds so the return to full speed is prompt. Cycle
+// periods stay well inside the 60 second lost appliance timeout.
+static constexpr uint8_t laundryIdleStates[] = {
+  0x00, // Idle
+  0x01, // Standby
+  0x04 // End of cycle
+};
+
+static constexpr uint8_t dishWasherIdleStates[] = {
+  0x00, // Low power
+  0x01, // Power up
+  0x02, // Standby
+  0x06 // End of cycle
 };
 
-static const tiny_erd_list_t applianceTypeToErdGroupTranslation[] = {
-  { waterHeaterErds, waterHeaterErdCount }, // 0x00 = Water heater
-  { laundryErds, laundryErdCount }, // 0x01 = Clothes washer
-  { laundryErds, laundryErdCount }, // 0x02 = Clothes dryer
-  { refrigerationErds, refrigerationErdCount }, // 0x03 = Refrigerator
-  { smallApplianceErds, smallApplianceErdCount }, // 0x04 = Microwave
-  { rangeErds, rangeErdCount }, // 0x05 = Advantium
-  { dishWasherErds, dishWasherErdCount }, // 0x06 = Dishwasher
-  { rangeErds, rangeErdCount }, // 0x07 = Oven
-  { rangeErds, rangeErdCount }, // 0x08 = Electric range
-  { rangeErds, rangeErdCount }, // 0x09 = Gas range
-  { airConditioningErds, airConditioningErdCount }, // 0x0A = Thermostat/RAC
-  { rangeErds, rangeErdCount }, // 0x0B = Electric Cooktop
-  { rangeErds, rangeErdCount }, // 0x0C = Pizza Oven
-  { rangeErds, rangeErdCount }, // 0x0D = Gas Cooktop
-  { airConditioningErds, airConditioningErdCount }, // 0x0E = Split / DFS (Duct-Free Split) AC
-  { rangeErds, rangeErdCount }, // 0x0F = Hood
-  { waterFilterErds, waterFilterErdCount }, // 0x10 = Point of Entry Water Filter
-  { rangeErds, rangeErdCount }, // 0x11 = Induction Cooktop
-  { refrigerationErds, refrigerationErdCount }, // 0x12 = Delivery Box
-  { rangeErds, rangeErdCount }, // 0x13 = Kitchen Hub Vent Hood
-  { airConditioningErds, airConditioningErdCount }, // 0x14 = Zoneline/PTAC
-  { waterFilterErds, waterFilterErdCount }, // 0x15 = Water Softener
-  { airConditioningErds, airConditioningErdCount }, // 0x16 = Portable AC
-  { laundryErds, laundryErdCount }, // 0x17 = Combination Washer Dryer
-  { refrigerationErds, refrigerationErdCount }, // 0x18 = Dual Zone Wine Chiller
-  { refrigerationErds, refrigerationErdCount }, // 0x19 = Beverage Center
-  { smallApplianceErds, smallApplianceErdCount }, // 0x1A = Coffee Brewer
-  { smallApplianceErds, smallApplianceErdCount }, // 0x1B = Opal Nugget Ice Maker
-  { refrigerationErds, refrigerationErdCount }, // 0x1C = In-Home Grower
-  { airConditioningErds, airConditioningErdCount }, // 0x1D = Dehumidifer
-  { refrigerationErds, refrigerationErdCount }, // 0x1E = Under Counter Ice Maker
-  { airConditioningErds, airConditioningErdCount }, // 0x1F = Through Wall AC
-  { dishWasherErds, dishWasherErdCount }, // 0x20 = F&P DishDrawer
-  { smallApplianceErds, smallApplianceErdCount }, // 0x21 = Espresso Coffee Maker
-  { smallApplianceErds, smallApplianceErdCount }, // 0x22 = Toaster Oven
-  { airConditioningErds, airConditioningErdCount }, // 0x23 = Zoneline/VTAC
-  { airConditioningErds, airConditioningErdCount }, // 0x24 = Central DFS (Duct-Free Split) Controller
-  { smallApplianceErds, smallApplianceErdCount }, // 0x25 = BLE Mesh Gateway
-  { smallApplianceErds, smallApplianceErdCount }, // 0x26 = Stand Mixer
-  { rangeErds, rangeErdCount }, // 0x27 = Fisher & Paykel Cooktop
-  { rangeErds, rangeErdCount }, // 0x28 = Fisher & Paykel Cooktop Teppanyaki
-  { rangeErds, rangeErdCount }, // 0x29 = Fisher & Paykel Ventilation Downdraft
-  { smallApplianceErds, smallApplianceErdCount }, // 0x2A = Smart Plug
-  { smallApplianceErds, smallApplianceErdCount }, // 0x2B = Smoker
-  { airConditioningErds, airConditioningErdCount }, // 0x2C = Air Handler VRF
-  { laundryErds, laundryErdCount }, // 0x2D = Fabric Care Cabinet Closet
-  { laundryErds, laundryErdCount }, // 0x2E = Laundry Center
-  { rangeErds, rangeErdCount }, // 0x2F = Grill
-  { refrigerationErds, refrigerationErdCount }, // 0x30 = Freezer
-  { rangeErds, rangeErdCount }, // 0x31 = Warming Drawer
-  { smallApplianceErds, smallApplianceErdCount }, // 0x32 = Vacuum Seal Drawer
-  { refrigerationErds, refrigerationErdCount }, // 0x33 = Wine Cabinet
-  { airConditioningErds, airConditioningErdCount }, // 0x34 = Central AC
-  { rangeErds, rangeErdCount }, // 0x35 = Hearth Pizza Oven
-  { smallApplianceErds, smallApplianceErdCount }, // 0x36 = Sourdough Starter
+static constexpr appliance_poll_rates_t unwatchedPollRates = {
+  0x0000, nullptr, 0, { 0, 0 }
 };
-static const uint16_t maximumApplianceType = sizeof(applianceTypeToErdGroupTranslation) / sizeof(applianceTypeToErdGroupTranslation[0]);
 
-const tiny_erd_list_t* GetApplianceErdList(uint8_t applianceType)
+static constexpr appliance_poll_rates_t laundryPollRates = {
+  0x2000, laundryIdleStates, sizeof(laundryIdleStates), { 0, 30 }
+};
+
+static constexpr appliance_poll_rates_t dishWasherPollRates = {
+  0x3001, dishWasherIdleStates, sizeof(dishWasherIdleStates), { 0, 30 }
+};
+
+// What is polled on each appliance type, and how fast
+struct ApplianceFamily {
+  const erd_range_list_t* candidates;
+  const appliance_poll_rates_t* pollRates;
+};
+
+static constexpr ApplianceFamily applianceFamilies[] = {
+  { &candidateList<waterHeaterErds>, &unwatchedPollRates }, // 0x00 = Water heater
+  { &candidateList<laundryErds>, &laundryPollRates }, // 0x01 = Clothes washer
+  { &candidateList<laundryErds>, &laundryPollRates }, // 0x02 = Clothes dryer
+  { &candidateList<refrigerationErds>, &unwatchedPollRates }, // 0x03 = Refrigerator
+  { &candidateList<smallApplianceErds>, &unwatchedPollRates }, // 0x04 = Microwave
+  { &candidateList<rangeErds>, &unwatchedPollRates }, // 0x05 = Advantium
+  { &candidateList<dishWasherErds>, &dishWasherPollRates }, // 0x06 = Dishwasher
+  { &candidateList<rangeErds>, &unwatchedPollRates }, // 0x07 = Oven
+  { &candidateList<rangeErds>, &unwatchedPollRates }, // 0x08 = Electric range
+  { &candidateList<rangeErds>, &unwatchedPollRates }, // 0x09 = Gas range
+  { &candidateList<airConditioningErds>, &unwatchedPollRates }, // 0x0A = Thermostat/RAC
+  { &candidateList<rangeErds>, &unwatchedPollRates }, // 0x0B = Electric Cooktop
+  { &candidateList<rangeErds>, &unwatchedPollRates }, // 0x0C = Pizza Oven
+  { &candidateList<rangeErds>, &unwatchedPollRates }, // 0x0D = Gas Cooktop
+  { &candidateList<airConditioningErds>, &unwatchedPollRates }, // 0x0E = Split / DFS (Duct-Free Split) AC
+  { &candidateList<rangeErds>, &unwatchedPollRates }, // 0x0F = Hood
+  { &candidateList<waterFilterErds>, &unwatchedPollRates }, // 0x10 = Point of Entry Water Filter
+  { &candidateList<rangeErds>, &unwatchedPollRates }, // 0x11 = Induction Cooktop
+  { &candidateList<refrigerationErds, refrigeratedCompartmentExclusions>, &unwatchedPollRates }, // 0x12 = Delivery Box
+  { &candidateList<rangeErds>, &unwatchedPollRates }, // 0x13 = Kitchen Hub Vent Hood
+  { &candidateList<airConditioningErds>, &unwatchedPollRates }, // 0x14 = Zoneline/PTAC
+  { &candidateList<waterFilterErds>, &unwatchedPollRates }, // 0x15 = Water Softener
+  { &candidateList<airConditioningErds>, &unwatchedPollRates }, // 0x16 = Portable AC
+  { &candidateList<laundryErds>, &laundryPollRates }, // 0x17 = Combination Washer Dryer
+  { &candidateList<refrigerationErds>, &unwatchedPollRates }, // 0x18 = Dual Zone Wine Chiller
+  { &candidateList<refrigerationErds>, &unwatchedPollRates }, // 0x19 = Beverage Center
+  { &candidateList<smallApplianceErds>, &unwatchedPollRates }, // 0x1A = Coffee Brewer
+  { &candidateList<smallApplianceErds>, &unwatchedPollRates }, // 0x1B = Opal Nugget Ice Maker
+  { &candidateList<refrigerationErds, refrigeratedCompartmentExclusions>, &unwatchedPollRates }, // 0x1C = In-Home Grower
+  { &candidateList<airConditioningErds>, &unwatchedPollRates }, // 0x1D = Dehumidifer
+  { &candidateList<refrigerationErds>, &unwatchedPollRates }, // 0x1E = Under Counter Ice Maker
+  { &candidateList<airConditioningErds>, &unwatchedPollRates }, // 0x1F = Through Wall AC
+  { &candidateList<dishWasherErds>, &dishWasherPollRates }, // 0x20 = F&P DishDrawer
+  { &candidateList<smallApplianceErds>, &unwatchedPollRates }, // 0x21 = Espresso Coffee Maker
+  { &candidateList<smallApplianceErds>, &unwatchedPollRates }, // 0x22 = Toaster Oven
+  { &candidateList<airConditioningErds>, &unwatchedPollRates }, // 0x23 = Zoneline/VTAC
+  { &candidateList<airConditioningErds>, &unwatchedPollRates }, // 0x24 = Central DFS (Duct-Free Split) Controller
+  { &candidateList<smallApplianceErds, gatewayExclusions>, &unwatchedPollRates }, // 0x25 = BLE Mesh Gateway
+  { &candidateList<smallApplianceErds>, &unwatchedPollRates }, // 0x26 = Stand Mixer
+  { &candidateList<rangeErds>, &unwatchedPollRates }, // 0x27 = Fisher & Paykel Cooktop
+  { &candidateList<rangeErds>, &unwatchedPollRates }, // 0x28 = Fisher & Paykel Cooktop Teppanyaki
+  { &candidateList<rangeErds>, &unwatchedPollRates }, // 0x29 = Fisher & Paykel Ventilation Downdraft
+  { &candidateList<smallApplianceErds, smartPlugExclusions>, &unwatchedPollRates }, // 0x2A = Smart Plug
+  { &candidateList<smallApplianceErds>, &unwatchedPollRates }, // 0x2B = Smoker
+  { &candidateList<airConditioningErds>, &unwatchedPollRates }, // 0x2C = Air Handler VRF
+  { &candidateList<laundryErds>, &laundryPollRates }, // 0x2D = Fabric Care Cabinet Closet
+  { &candidateList<laundryErds>, &laundryPollRates }, // 0x2E = Laundry Center
+  { &candidateList<rangeErds>, &unwatchedPollRates }, // 0x2F = Grill
+  { &candidateList<refrigerationErds>, &unwatchedPollRates }, // 0x30 = Freezer
+  { &candidateList<rangeErds>, &unwatchedPollRates }, // 0x31 = Warming Drawer
+  { &candidateList<smallApplianceErds>, &unwatchedPollRates }, // 0x32 = Vacuum Seal Drawer
+  { &candidateList<refrigerationErds>, &unwatchedPollRates }, // 0x33 = Wine Cabinet
+  { &candidateList<airConditioningErds>, &unwatchedPollRates }, // 0x34 = Central AC
+  { &candidateList<rangeErds>, &unwatchedPollRates }, // 0x35 = Hearth Pizza Oven
+  { &candidateList<smallApplianceErds>, &unwatchedPollRates }, // 0x36 = Sourdough Starter
+};
+static const uint16_t maximumApplianceType = sizeof(applianceFamilies) / sizeof(applianceFamilies[0]);
+
+static constexpr uint16_t LargestCandidateCount()
+{
+  uint16_t largest = 0;
+  for(auto family : applianceFamilies) {
+    largest = (family.candidates->erdCount > largest) ? family.candidates->erdCount : largest;
+  }
+  return largest;
+}
+
+static_assert(LargestCandidateCount() <= APPLIANCE_ERD_CANDIDATES_MAX, "Raise APPLIANCE_ERD_CANDIDATES_MAX");
+
+static const ApplianceFamily* GetApplianceFamily(uint8_t applianceType)
 {
   if(applianceType >= maximumApplianceType) {
     applianceType = 0;
   }
-  return &applianceTypeToErdGroupTranslation[applianceType];
-};
+  return &applianceFamilies[applianceType];
+}
+
+const erd_range_list_t* GetApplianceErdList(uint8_t applianceType)
+{
+  return GetApplianceFamily(applianceType)->candidates;
+}
+
+const appliance_poll_rates_t* GetAppliancePollRates(uint8_t applianceType)
+{
+  return GetApplianceFamily(applianceType)->pollRates;
+}
+
+bool IsApplianceErdCandidate(uint8_t applianceType, tiny_erd_t erd)
+{
+  return ErdRangeListContains(GetApplianceErdList(applianceType), erd);
+}
+
+uint8_t GetErdScore(tiny_erd_t erd)
+{
+  return ErdScoreOf(erd);
+}
+
+uint32_t ErdRangeListHash(const erd_range_list_t* list)
+{
+  uint32_t hash = 2166136261u;
+  for(uint16_t range = 0; range < list->rangeCount; range++) {
+    const uint8_t bytes[] = {
+      (uint8_t)(list->ranges[range].first >> 8),
+      (uint8_t)(list->ranges[range].first & 0xFF),
+      (uint8_t)(list->ranges[range].count >> 8),
+      (uint8_t)(list->ranges[range].count & 0xFF)
+    };
+    for(uint8_t i = 0; i < sizeof(bytes); i++) {
+      hash = (hash ^ bytes[i]) * 16777619u;
+    }
+  }
+  return hash;
+}
+
+bool ErdRangeListContains(const erd_range_list_t* list, tiny_erd_t erd)
+{
+  uint16_t low = 0;
+  uint16_t high = list->rangeCount;
+  while(low < high) {
+    uint16_t middle = low + (high - low) / 2;
+    const erd_range_t* range = &list->ranges[middle];
+    if(erd < range->first) {
+      high = middle;
+    }
+    else if(erd >= range->first + range->count) {
+      low = middle + 1;
+    }
+    else {
+      return true;
+    }
+  }
+  return false;
+}
+
+static tiny_erd_t ErdAtIndex(const erd_range_list_t* list, uint16_t index)
+{
+  for(uint16_t range = 0; range < list->rangeCount; range++) {
+    if(index < list->ranges[range].count) {
+      return list->ranges[range].first + index;
+    }
+    index -= list->ranges[range].count;
+  }
+  return 0;
+}
+
+void ErdRangeIteratorInit(erd_range_iterator_t* iterator, const erd_range_list_t* list)
+{
+  iterator->list = list;
+  iterator->range = 0;
+  iterator->offset = 0;
+  iterator->sequence = 0;
+  iterator->position = 0;
+  iterator->index = 0;
+}
+
+bool ErdRangeIteratorNext(erd_range_iterator_t* iterator, tiny_erd_t* erd)
+{
+  const erd_range_list_t* list = iterator->list;
+  if(iterator->position < list->priorityCount) {
+    iterator->index = list->priority[iterator->position];
+    *erd = ErdAtIndex(list, iterator->index);
+    iterator->position++;
+    return true;
+  }
+
+  // Scored ERDs have already been returned from the priority list
+  while(iterator->range < list->rangeCount) {
+    const erd_range_t* range = &list->ranges[iterator->range];
+    tiny_erd_t next = range->first + iterator->offset;
+    uint16_t index = iterator->sequence++;
+    if(++iterator->offset >= range->count) {
+      iterator->range++;
+      iterator->offset = 0;
+    }
+    if(ErdScoreOf(next) == 0) {
+      *erd = next;
+      iterator->index = index;
+      iterator->position++;
+      return true;
+    }
+  }
+  return false;
+}
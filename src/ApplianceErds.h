@@ -6,27 +6,104 @@
 #ifndef APPLIANCEERDS_H
 #define APPLIANCEERDS_H
 
+#include <stdbool.h>
 #include "tiny_erd.h"
 
+// Upper bound on the candidate count of any appliance type, for per-candidate bitmaps
+#define APPLIANCE_ERD_CANDIDATES_MAX 640
+
+typedef struct
+{
+  tiny_erd_t first;
+  uint16_t count;
+} erd_range_t;
+
+/*!
+ * Sorted, non-overlapping runs of consecutive ERDs, plus the indexes of the ERDs most likely to
+ * be supported, most likely first
+ */
+typedef struct
+{
+  const erd_range_t* ranges;
+  uint16_t rangeCount;
+  uint16_t erdCount;
+  const uint16_t* priority;
+  uint16_t priorityCount;
+} erd_range_list_t;
+
+typedef struct
+{
+  const erd_range_list_t* list;
+  uint16_t range;
+  uint16_t offset;
+  uint16_t sequence; // Index in the list of the ERD at range and offset
+  uint16_t position; // Number of ERDs returned so far
+  uint16_t index; // Index in the list of the last ERD returned
+} erd_range_iterator_t;
+
+enum {
+  poll_rate_active,
+  poll_rate_idle,
+  poll_rate_count
+};
+typedef uint8_t poll_rate_t;
+
+/*!
+ * How fast a family is polled. The first byte of stateErd tells whether the appliance is
+ * running; any value in idleStates means idle or off, anything else means running. Each rate
+ * gives the minimum number of seconds from the start of one poll cycle to the next, 0 to poll
+ * as fast as the bus allows.
+ */
 typedef struct
 {
-  const tiny_erd_t* erdList;
-  const uint16_t erdCount;
-} tiny_erd_list_t;
+  tiny_erd_t stateErd; // 0 if the family has no state to watch and is always polled as active
+  const uint8_t* idleStates;
+  uint8_t idleStateCount;
+  uint16_t cyclePeriod[poll_rate_count];
+} appliance_poll_rates_t;
+
+/*!
+ * Get the candidate ERDs for an appliance type: the common, energy and family ERDs, sorted and
+ * without duplicates
+ */
+const erd_range_list_t* GetApplianceErdList(uint8_t applianceType);
+
+/*!
+ * Get the poll rates of an appliance type
+ */
+const appliance_poll_rates_t* GetAppliancePollRates(uint8_t applianceType);
+
+/*!
+ * Check whether an ERD is a candidate for an appliance type
+ */
+bool IsApplianceErdCandidate(uint8_t applianceType, tiny_erd_t erd);
+
+/*!
+ * Get the hit-probability score of an ERD, 0 for ERDs outside the scored blocks. Scored ERDs
+ * are the ones a dashboard needs, so polling also favours them.
+ */
+uint8_t GetErdScore(tiny_erd_t erd);
+
+/*!
+ * Hash of the ERDs in a list, so records kept by candidate index can tell when the list they
+ * were made against has changed
+ */
+uint32_t ErdRangeListHash(const erd_range_list_t* list);
 
 /*!
- * Get the list of common ERDs
+ * Check whether an ERD is in a list, in O(log n) of the number of ranges
  */
-const tiny_erd_list_t* GetCommonErdList(void);
+bool ErdRangeListContains(const erd_range_list_t* list, tiny_erd_t erd);
 
 /*!
- * Get the list of energy ERDs
+ * Start iterating over a list in probe order: the likely ERDs by descending score, then the
+ * rest in ascending ERD order
  */
-const tiny_erd_list_t* GetEnergyErdList(void);
+void ErdRangeIteratorInit(erd_range_iterator_t* iterator, const erd_range_list_t* list);
 
 /*!
- * Get the list of appliance ERDs based on appliance type
+ * Get the next ERD, returns false once the list is exhausted
  */
-const tiny_erd_list_t* GetApplianceErdList(uint8_t applianceType);
+bool ErdRangeIteratorNext(erd_range_iterator_t* iterator, tiny_erd_t* erd);
 
 #endif
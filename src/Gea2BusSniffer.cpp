@@ -0,0 +1,98 @@
+/*!
+ * @file
+ * @brief
+ */
+
+extern "C" {
+#include "Gea2BusSniffer.h"
+#include "tiny_gea_constants.h"
+}
+
+typedef Gea2BusSniffer_t self_t;
+
+enum {
+  gea2_erd_read_command = 0xF0,
+  gea2_erd_write_command = 0xF1,
+  gea2_erd_publication_command = 0xF5,
+  header_size = 2,
+  erd_header_size = 3
+};
+
+// Read responses, write requests and publications share one layout: command, ERD count, then
+// per ERD the big endian ERD number, data size and data
+static bool ErdEntriesFillPayload(const tiny_gea_packet_t* packet)
+{
+  const uint8_t* payload = packet->payload;
+  if((packet->payload_length < header_size) || (payload[1] == 0)) {
+    return false;
+  }
+
+  uint16_t offset = header_size;
+  for(uint8_t i = 0; i < payload[1]; i++) {
+    if(offset + erd_header_size > packet->payload_length) {
+      return false;
+    }
+    offset += erd_header_size + payload[offset + 2];
+  }
+  return offset == packet->payload_length;
+}
+
+static void PacketReceived(void* context, const void* _args)
+{
+  auto self = reinterpret_cast<self_t*>(context);
+  auto packet = reinterpret_cast<const tiny_gea_interface_on_receive_args_t*>(_args)->packet;
+
+  if((packet->source == self->client_address) ||
+    (packet->payload_length < 1) ||
+    ((packet->destination == self->client_address) && (packet->payload[0] != gea2_erd_publication_command))) {
+    return;
+  }
+
+  gea2_bus_sniffer_on_erd_args_t args;
+  switch(packet->payload[0]) {
+    case gea2_erd_read_command:
+    case gea2_erd_publication_command:
+      args.address = packet->source;
+      break;
+
+    case gea2_erd_write_command:
+      if(packet->destination == tiny_gea_broadcast_address) {
+        return;
+      }
+      args.address = packet->destination;
+      break;
+
+    default:
+      return;
+  }
+
+  if(!ErdEntriesFillPayload(packet)) {
+    return;
+  }
+
+  uint16_t offset = header_size;
+  for(uint8_t i = 0; i < packet->payload[1]; i++) {
+    args.erd = (packet->payload[offset] << 8) | packet->payload[offset + 1];
+    args.data_size = packet->payload[offset + 2];
+    args.data = &packet->payload[offset + erd_header_size];
+    tiny_event_publish(&self->on_erd, &args);
+    offset += erd_header_size + args.data_size;
+  }
+}
+
+void gea2_bus_sniffer_init(
+  self_t* self,
+  i_tiny_gea_interface_t* gea2_interface,
+  uint8_t client_address)
+{
+  self->client_address = client_address;
+
+  tiny_event_init(&self->on_erd);
+  tiny_event_subscription_init(&self->on_receive_subscription, self, PacketReceived);
+  tiny_event_subscribe(tiny_gea_interface_on_receive(gea2_interface), &self->on_receive_subscription);
+}
+
+i_tiny_event_t* gea2_bus_sniffer_on_erd(self_t* self)
+{
+  return &self->on_erd.interface;
+}
@@ -0,0 +1,48 @@
+/*!
+ * @file
+ * @brief Harvests ERD values from GEA2 traffic between other nodes.
+ *
+ * The boards in an appliance read, write and publish ERDs among themselves. With the GEA2
+ * interface receiving every packet regardless of destination, read responses, write requests
+ * and publications that do not involve this node are decoded and reported with the address of
+ * the node that owns the ERD. Publications addressed to this node, sent for ERDs it has
+ * subscribed to, are reported the same way. Packets are only accepted if their ERD entries
+ * exactly fill the payload.
+ */
+
+#ifndef Gea2BusSniffer_h
+#define Gea2BusSniffer_h
+
+#include "i_tiny_gea_interface.h"
+#include "tiny_erd.h"
+#include "tiny_event.h"
+
+typedef struct {
+  uint8_t address;
+  tiny_erd_t erd;
+  const void* data;
+  uint8_t data_size;
+} gea2_bus_sniffer_on_erd_args_t;
+
+typedef struct {
+  tiny_event_subscription_t on_receive_subscription;
+  tiny_event_t on_erd;
+  uint8_t client_address;
+} Gea2BusSniffer_t;
+
+/*!
+ * Initialize the sniffer. Packets from client_address, and packets other than publications to
+ * client_address, are ignored.
+ */
+void gea2_bus_sniffer_init(
+  Gea2BusSniffer_t* self,
+  i_tiny_gea_interface_t* gea2_interface,
+  uint8_t client_address);
+
+/*!
+ * Raised for every ERD value seen on the bus.
+ */
+i_tiny_event_t* gea2_bus_sniffer_on_erd(
+  Gea2BusSniffer_t* self);
+
+#endif
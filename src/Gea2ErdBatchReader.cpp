@@ -0,0 +1,255 @@
+/*!
+ * @file
+ * @brief
+ */
+
+extern "C" {
+#include "Gea2ErdBatchReader.h"
+#include "tiny_utils.h"
+}
+
+typedef Gea2ErdBatchReader_t self_t;
+
+enum {
+  gea2_erd_read_command = 0xF0,
+  request_header_size = 2,
+  response_header_size = 2,
+  response_erd_header_size = GEA2_ERD_BATCH_READER_ERD_OVERHEAD,
+  packet_overhead = 5,
+  frame_overhead = GEA2_ROUND_TRIP_ESTIMATOR_FRAME_OVERHEAD
+};
+
+static uint8_t RequestFrameSize(self_t* self)
+{
+  return request_header_size + self->erd_count * sizeof(tiny_erd_t) + frame_overhead;
+}
+
+static void SendRequest(self_t* self)
+{
+  self->bus_bytes += RequestFrameSize(self);
+  self->bus_shared = false;
+  tiny_gea_interface_send(
+    self->gea2_interface,
+    self->address,
+    RequestFrameSize(self) - frame_overhead,
+    self,
+    +[](void* context, tiny_gea_packet_t* packet) {
+      auto self = reinterpret_cast<self_t*>(context);
+      self->sent_at = tiny_time_source_ticks(self->timer_group->time_source);
+      packet->payload[0] = gea2_erd_read_command;
+      packet->payload[1] = self->erd_count;
+      for(uint8_t i = 0; i < self->erd_count; i++) {
+        packet->payload[request_header_size + i * 2] = self->erds[i] >> 8;
+        packet->payload[request_header_size + i * 2 + 1] = self->erds[i] & 0xFF;
+      }
+    });
+}
+
+// An ERD of unknown size could take up the whole response
+static uint16_t ExpectedResponseSize(self_t* self, const uint8_t* sizes)
+{
+  if(sizes == nullptr) {
+    return self->response_capacity;
+  }
+
+  uint16_t expected = 0;
+  for(uint8_t i = 0; i < self->erd_count; i++) {
+    if(sizes[i] == 0) {
+      return self->response_capacity;
+    }
+    expected += response_erd_header_size + sizes[i];
+  }
+  return (expected < self->response_capacity) ? expected : self->response_capacity;
+}
+
+// The wait allows for the request and the response expected to it
+static void ArmTimer(self_t* self)
+{
+  uint16_t wire_time = gea2_round_trip_estimator_wire_time(
+    RequestFrameSize(self) + response_header_size + self->expected_response_size + frame_overhead);
+  tiny_timer_start(
+    self->timer_group,
+    &self->timer,
+    gea2_round_trip_estimator_timeout(self->round_trip_estimator, self->address, wire_time),
+    self,
+    +[](void* context) {
+      auto self = reinterpret_cast<self_t*>(context);
+
+      if(self->retries_left > 0) {
+        self->retries_left--;
+        self->retries_sent++;
+        SendRequest(self);
+        ArmTimer(self);
+        return;
+      }
+
+      self->busy = false;
+      gea2_erd_batch_reader_on_activity_args_t args;
+      args.type = gea2_erd_batch_reader_activity_type_batch_failed;
+      args.address = self->address;
+      args.batch_failed.erd_count = self->erd_count;
+      args.batch_failed.bus_bytes = self->bus_bytes;
+      tiny_event_publish(&self->on_activity, &args);
+    });
+}
+
+static bool ErdRequested(self_t* self, tiny_erd_t erd)
+{
+  for(uint8_t i = 0; i < self->erd_count; i++) {
+    if(self->erds[i] == erd) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool ResponseIsValid(self_t* self, const tiny_gea_packet_t* packet)
+{
+  const uint8_t* payload = packet->payload;
+
+  if((packet->payload_length < response_header_size) ||
+    (payload[0] != gea2_erd_read_command) ||
+    (payload[1] == 0) ||
+    (payload[1] > self->erd_count)) {
+    return false;
+  }
+
+  uint16_t offset = response_header_size;
+  for(uint8_t i = 0; i < payload[1]; i++) {
+    if(offset + response_erd_header_size > packet->payload_length) {
+      return false;
+    }
+    tiny_erd_t erd = (payload[offset] << 8) | payload[offset + 1];
+    if(!ErdRequested(self, erd)) {
+      return false;
+    }
+    offset += response_erd_header_size + payload[offset + 2];
+  }
+
+  return offset == packet->payload_length;
+}
+
+static void PacketReceived(void* context, const void* _args)
+{
+  auto self = reinterpret_cast<self_t*>(context);
+  auto packet = reinterpret_cast<const tiny_gea_interface_on_receive_args_t*>(_args)->packet;
+
+  if(!self->busy) {
+    return;
+  }
+
+  if((packet->source != self->address) ||
+    (packet->destination != self->client_address) ||
+    !ResponseIsValid(self, packet)) {
+    self->bus_shared = true;
+    return;
+  }
+
+  tiny_timer_stop(self->timer_group, &self->timer);
+  self->busy = false;
+  self->bus_bytes += packet->payload_length + frame_overhead;
+
+  // The request may have waited behind other packets before it went out, which would show up
+  // as a slow turnaround, so only clean first attempts are measured
+  if((self->retries_left == self->request_retries) && !self->bus_shared) {
+    uint16_t elapsed = tiny_time_source_ticks(self->timer_group->time_source) - self->sent_at;
+    uint16_t wire_time = gea2_round_trip_estimator_wire_time(RequestFrameSize(self) + packet->payload_length + frame_overhead);
+    gea2_round_trip_estimator_add_sample(self->round_trip_estimator, self->address, (elapsed > wire_time) ? elapsed - wire_time : 0);
+  }
+
+  // A subscriber may start the next batch from read_completed, so the batch is reported from
+  // what it was before any ERD is
+  uint8_t erd_count = self->erd_count;
+  uint16_t bus_bytes = self->bus_bytes;
+
+  gea2_erd_batch_reader_on_activity_args_t args;
+  args.type = gea2_erd_batch_reader_activity_type_read_completed;
+  args.address = self->address;
+
+  uint8_t erds_read = packet->payload[1];
+  uint16_t offset = response_header_size;
+  for(uint8_t i = 0; i < erds_read; i++) {
+    args.read_completed.erd = (packet->payload[offset] << 8) | packet->payload[offset + 1];
+    args.read_completed.data_size = packet->payload[offset + 2];
+    args.read_completed.data = &packet->payload[offset + response_erd_header_size];
+    tiny_event_publish(&self->on_activity, &args);
+    offset += response_erd_header_size + args.read_completed.data_size;
+  }
+
+  args.type = gea2_erd_batch_reader_activity_type_batch_completed;
+  args.batch_completed.erd_count = erd_count;
+  args.batch_completed.erds_read = erds_read;
+  args.batch_completed.bus_bytes = bus_bytes;
+  tiny_event_publish(&self->on_activity, &args);
+}
+
+void gea2_erd_batch_reader_init(
+  self_t* self,
+  tiny_timer_group_t* timer_group,
+  i_tiny_gea_interface_t* gea2_interface,
+  uint8_t client_address,
+  uint8_t receive_buffer_size,
+  Gea2RoundTripEstimator_t* round_trip_estimator,
+  uint8_t request_retries)
+{
+  self->timer_group = timer_group;
+  self->gea2_interface = gea2_interface;
+  self->client_address = client_address;
+  self->response_capacity = receive_buffer_size - packet_overhead - response_header_size;
+  self->round_trip_estimator = round_trip_estimator;
+  self->request_retries = request_retries;
+  self->retries_sent = 0;
+  self->busy = false;
+  self->bus_shared = false;
+
+  tiny_event_init(&self->on_activity);
+  tiny_event_subscription_init(&self->on_receive_subscription, self, PacketReceived);
+  tiny_event_subscribe(tiny_gea_interface_on_receive(gea2_interface), &self->on_receive_subscription);
+}
+
+bool gea2_erd_batch_reader_read(self_t* self, uint8_t address, const tiny_erd_t* erds, const uint8_t* sizes, uint8_t erd_count)
+{
+  if(self->busy || (erd_count == 0) || (erd_count > GEA2_ERD_BATCH_READER_MAX_ERDS)) {
+    return false;
+  }
+
+  self->busy = true;
+  self->address = address;
+  self->erd_count = erd_count;
+  self->retries_left = self->request_retries;
+  self->bus_bytes = 0;
+  for(uint8_t i = 0; i < erd_count; i++) {
+    self->erds[i] = erds[i];
+  }
+  self->expected_response_size = ExpectedResponseSize(self, sizes);
+
+  SendRequest(self);
+  ArmTimer(self);
+  return true;
+}
+
+bool gea2_erd_batch_reader_busy(self_t* self)
+{
+  return self->busy;
+}
+
+uint32_t gea2_erd_batch_reader_retries_sent(self_t* self)
+{
+  return self->retries_sent;
+}
+
+void gea2_erd_batch_reader_cancel(self_t* self)
+{
+  tiny_timer_stop(self->timer_group, &self->timer);
+  self->busy = false;
+}
+
+uint16_t gea2_erd_batch_reader_response_capacity(self_t* self)
+{
+  return self->response_capacity;
+}
+
+i_tiny_event_t* gea2_erd_batch_reader_on_activity(self_t* self)
+{
+  return &self->on_activity.interface;
+}
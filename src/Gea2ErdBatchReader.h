@@ -0,0 +1,134 @@
+/*!
+ * @file
+ * @brief Reads several ERDs from one GEA2 node with a single ERD read request.
+ *
+ * GEA2 read requests carry an ERD count, so a node that supports it answers a whole batch
+ * in one response frame. A batch of one is an ordinary single ERD read. Only one batch is
+ * outstanding at a time; it is retried on timeout and then reported as failed. Timeouts come
+ * from a round trip estimator, which is fed with every batch answered on its first attempt.
+ */
+
+#ifndef Gea2ErdBatchReader_h
+#define Gea2ErdBatchReader_h
+
+#include "Gea2RoundTripEstimator.h"
+#include "i_tiny_gea_interface.h"
+#include "tiny_erd.h"
+#include "tiny_event.h"
+#include "tiny_timer.h"
+
+#define GEA2_ERD_BATCH_READER_MAX_ERDS 32
+#define GEA2_ERD_BATCH_READER_ERD_OVERHEAD 3
+
+enum {
+  gea2_erd_batch_reader_activity_type_read_completed,
+  gea2_erd_batch_reader_activity_type_batch_completed,
+  gea2_erd_batch_reader_activity_type_batch_failed
+};
+typedef uint8_t gea2_erd_batch_reader_activity_type_t;
+
+typedef struct {
+  gea2_erd_batch_reader_activity_type_t type;
+  uint8_t address;
+  union {
+    struct {
+      tiny_erd_t erd;
+      const void* data;
+      uint8_t data_size;
+    } read_completed;
+
+    struct {
+      uint8_t erd_count;
+      uint8_t erds_read;
+      uint16_t bus_bytes;
+    } batch_completed;
+
+    struct {
+      uint8_t erd_count;
+      uint16_t bus_bytes;
+    } batch_failed;
+  };
+} gea2_erd_batch_reader_on_activity_args_t;
+
+typedef struct {
+  tiny_timer_group_t* timer_group;
+  i_tiny_gea_interface_t* gea2_interface;
+  tiny_event_subscription_t on_receive_subscription;
+  tiny_event_t on_activity;
+  tiny_timer_t timer;
+  Gea2RoundTripEstimator_t* round_trip_estimator;
+  tiny_time_source_ticks_t sent_at;
+  bool bus_shared; // Other traffic was seen while waiting, so the turnaround is not clean
+  uint32_t retries_sent;
+  uint8_t request_retries;
+  uint8_t retries_left;
+  uint16_t response_capacity;
+  uint16_t expected_response_size;
+  uint8_t client_address;
+  uint8_t address;
+  uint8_t erd_count;
+  tiny_erd_t erds[GEA2_ERD_BATCH_READER_MAX_ERDS];
+  uint16_t bus_bytes;
+  bool busy;
+} Gea2ErdBatchReader_t;
+
+/*!
+ * Initialize the batch reader. Only responses addressed to client_address are accepted, so
+ * reads between other nodes are never taken for ours. Readers sharing a bus can share one
+ * round trip estimator and keep their own retry limits.
+ */
+void gea2_erd_batch_reader_init(
+  Gea2ErdBatchReader_t* self,
+  tiny_timer_group_t* timer_group,
+  i_tiny_gea_interface_t* gea2_interface,
+  uint8_t client_address,
+  uint8_t receive_buffer_size,
+  Gea2RoundTripEstimator_t* round_trip_estimator,
+  uint8_t request_retries);
+
+/*!
+ * Bytes available in one response for ERD entries. Each entry takes its data size plus
+ * GEA2_ERD_BATCH_READER_ERD_OVERHEAD.
+ */
+uint16_t gea2_erd_batch_reader_response_capacity(
+  Gea2ErdBatchReader_t* self);
+
+/*!
+ * Request erd_count ERDs from address. sizes gives the data size of each ERD, 0 where it is not
+ * known, or is null if none are known; the wait for the response allows for those sizes, or for
+ * the largest response that fits when any is unknown. Returns false if a batch is already
+ * outstanding.
+ */
+bool gea2_erd_batch_reader_read(
+  Gea2ErdBatchReader_t* self,
+  uint8_t address,
+  const tiny_erd_t* erds,
+  const uint8_t* sizes,
+  uint8_t erd_count);
+
+/*!
+ * Check whether a batch is outstanding.
+ */
+bool gea2_erd_batch_reader_busy(
+  Gea2ErdBatchReader_t* self);
+
+/*!
+ * Number of requests sent again after a timeout since the reader was initialized.
+ */
+uint32_t gea2_erd_batch_reader_retries_sent(
+  Gea2ErdBatchReader_t* self);
+
+/*!
+ * Drop the outstanding batch, if any, without reporting it.
+ */
+void gea2_erd_batch_reader_cancel(
+  Gea2ErdBatchReader_t* self);
+
+/*!
+ * Raised for each ERD read and when a batch completes or fails. Completed and failed batches
+ * report the bytes every attempt put on the bus, framing and acknowledgements included.
+ */
+i_tiny_event_t* gea2_erd_batch_reader_on_activity(
+  Gea2ErdBatchReader_t* self);
+
+#endif
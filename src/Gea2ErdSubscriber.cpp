@@ -0,0 +1,161 @@
+/*!
+ * @file
+ * @brief
+ */
+
+extern "C" {
+#include "Gea2ErdSubscriber.h"
+#include "tiny_utils.h"
+}
+
+typedef Gea2ErdSubscriber_t self_t;
+
+enum {
+  gea2_erd_subscribe_command = 0xF2,
+  header_size = 2
+};
+
+static void SendRequest(self_t* self)
+{
+  self->bus_bytes += header_size + self->erd_count * sizeof(tiny_erd_t) + GEA2_ROUND_TRIP_ESTIMATOR_FRAME_OVERHEAD;
+  tiny_gea_interface_send(
+    self->gea2_interface,
+    self->address,
+    header_size + self->erd_count * sizeof(tiny_erd_t),
+    self,
+    +[](void* context, tiny_gea_packet_t* packet) {
+      auto self = reinterpret_cast<self_t*>(context);
+      packet->payload[0] = gea2_erd_subscribe_command;
+      packet->payload[1] = self->erd_count;
+      for(uint8_t i = 0; i < self->erd_count; i++) {
+        packet->payload[header_size + i * 2] = self->erds[i] >> 8;
+        packet->payload[header_size + i * 2 + 1] = self->erds[i] & 0xFF;
+      }
+    });
+}
+
+static void ArmTimer(self_t* self)
+{
+  tiny_timer_start(
+    self->timer_group, &self->timer, self->request_timeout, self, +[](void* context) {
+      auto self = reinterpret_cast<self_t*>(context);
+
+      if(self->retries_left > 0) {
+        self->retries_left--;
+        SendRequest(self);
+        ArmTimer(self);
+        return;
+      }
+
+      self->busy = false;
+      gea2_erd_subscriber_on_activity_args_t args;
+      args.type = gea2_erd_subscriber_activity_type_request_failed;
+      args.address = self->address;
+      args.request_failed.erd_count = self->erd_count;
+      args.request_failed.bus_bytes = self->bus_bytes;
+      tiny_event_publish(&self->on_activity, &args);
+    });
+}
+
+static bool ErdAccepted(const tiny_gea_packet_t* packet, tiny_erd_t erd)
+{
+  for(uint8_t i = 0; i < packet->payload[1]; i++) {
+    if(((packet->payload[header_size + i * 2] << 8) | packet->payload[header_size + i * 2 + 1]) == erd) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void PacketReceived(void* context, const void* _args)
+{
+  auto self = reinterpret_cast<self_t*>(context);
+  auto packet = reinterpret_cast<const tiny_gea_interface_on_receive_args_t*>(_args)->packet;
+
+  if(!self->busy ||
+    (packet->source != self->address) ||
+    (packet->destination != self->client_address) ||
+    (packet->payload_length < header_size) ||
+    (packet->payload[0] != gea2_erd_subscribe_command) ||
+    (packet->payload_length != header_size + packet->payload[1] * sizeof(tiny_erd_t))) {
+    return;
+  }
+
+  tiny_timer_stop(self->timer_group, &self->timer);
+  self->busy = false;
+  self->bus_bytes += packet->payload_length + GEA2_ROUND_TRIP_ESTIMATOR_FRAME_OVERHEAD;
+
+  gea2_erd_subscriber_on_activity_args_t args;
+  args.address = self->address;
+
+  uint8_t erds_accepted = 0;
+  for(uint8_t i = 0; i < self->erd_count; i++) {
+    if(ErdAccepted(packet, self->erds[i])) {
+      args.type = gea2_erd_subscriber_activity_type_erd_subscribed;
+      args.erd_subscribed.erd = self->erds[i];
+      erds_accepted++;
+    }
+    else {
+      args.type = gea2_erd_subscriber_activity_type_erd_rejected;
+      args.erd_rejected.erd = self->erds[i];
+    }
+    tiny_event_publish(&self->on_activity, &args);
+  }
+
+  args.type = gea2_erd_subscriber_activity_type_request_completed;
+  args.request_completed.erd_count = self->erd_count;
+  args.request_completed.erds_accepted = erds_accepted;
+  args.request_completed.bus_bytes = self->bus_bytes;
+  tiny_event_publish(&self->on_activity, &args);
+}
+
+void gea2_erd_subscriber_init(
+  self_t* self,
+  tiny_timer_group_t* timer_group,
+  i_tiny_gea_interface_t* gea2_interface,
+  uint8_t client_address,
+  uint16_t request_timeout,
+  uint8_t request_retries)
+{
+  self->timer_group = timer_group;
+  self->gea2_interface = gea2_interface;
+  self->client_address = client_address;
+  self->request_timeout = request_timeout;
+  self->request_retries = request_retries;
+  self->busy = false;
+  self->bus_bytes = 0;
+
+  tiny_event_init(&self->on_activity);
+  tiny_event_subscription_init(&self->on_receive_subscription, self, PacketReceived);
+  tiny_event_subscribe(tiny_gea_interface_on_receive(gea2_interface), &self->on_receive_subscription);
+}
+
+bool gea2_erd_subscriber_subscribe(self_t* self, uint8_t address, const tiny_erd_t* erds, uint8_t erd_count)
+{
+  if(self->busy || (erd_count == 0) || (erd_count > GEA2_ERD_SUBSCRIBER_MAX_ERDS)) {
+    return false;
+  }
+
+  self->busy = true;
+  self->address = address;
+  self->erd_count = erd_count;
+  self->retries_left = self->request_retries;
+  self->bus_bytes = 0;
+  for(uint8_t i = 0; i < erd_count; i++) {
+    self->erds[i] = erds[i];
+  }
+
+  SendRequest(self);
+  ArmTimer(self);
+  return true;
+}
+
+bool gea2_erd_subscriber_busy(self_t* self)
+{
+  return self->busy;
+}
+
+i_tiny_event_t* gea2_erd_subscriber_on_activity(self_t* self)
+{
+  return &self->on_activity.interface;
+}
@@ -0,0 +1,106 @@
+/*!
+ * @file
+ * @brief Asks a GEA2 node to publish changes to a set of ERDs.
+ *
+ * A subscribe request carries an ERD count followed by the ERD numbers, and a node that
+ * supports publications answers with the ERDs it accepted, in the same layout. The values are
+ * then published with 0xF5 publications, which Gea2BusSniffer decodes. A node that does not
+ * answer after the retries does not support subscriptions. Only one request is outstanding at
+ * a time.
+ */
+
+#ifndef Gea2ErdSubscriber_h
+#define Gea2ErdSubscriber_h
+
+#include "Gea2RoundTripEstimator.h"
+#include "i_tiny_gea_interface.h"
+#include "tiny_erd.h"
+#include "tiny_event.h"
+#include "tiny_timer.h"
+
+#define GEA2_ERD_SUBSCRIBER_MAX_ERDS 16
+
+enum {
+  gea2_erd_subscriber_activity_type_erd_subscribed,
+  gea2_erd_subscriber_activity_type_erd_rejected,
+  gea2_erd_subscriber_activity_type_request_completed,
+  gea2_erd_subscriber_activity_type_request_failed
+};
+typedef uint8_t gea2_erd_subscriber_activity_type_t;
+
+typedef struct {
+  gea2_erd_subscriber_activity_type_t type;
+  uint8_t address;
+  union {
+    struct {
+      tiny_erd_t erd;
+    } erd_subscribed;
+
+    struct {
+      tiny_erd_t erd;
+    } erd_rejected;
+
+    struct {
+      uint8_t erd_count;
+      uint8_t erds_accepted;
+      uint16_t bus_bytes;
+    } request_completed;
+
+    struct {
+      uint8_t erd_count;
+      uint16_t bus_bytes;
+    } request_failed;
+  };
+} gea2_erd_subscriber_on_activity_args_t;
+
+typedef struct {
+  tiny_timer_group_t* timer_group;
+  i_tiny_gea_interface_t* gea2_interface;
+  tiny_event_subscription_t on_receive_subscription;
+  tiny_event_t on_activity;
+  tiny_timer_t timer;
+  uint16_t request_timeout;
+  uint8_t request_retries;
+  uint8_t retries_left;
+  uint8_t client_address;
+  uint8_t address;
+  uint8_t erd_count;
+  tiny_erd_t erds[GEA2_ERD_SUBSCRIBER_MAX_ERDS];
+  uint16_t bus_bytes;
+  bool busy;
+} Gea2ErdSubscriber_t;
+
+/*!
+ * Initialize the subscriber. Only responses addressed to client_address are accepted.
+ */
+void gea2_erd_subscriber_init(
+  Gea2ErdSubscriber_t* self,
+  tiny_timer_group_t* timer_group,
+  i_tiny_gea_interface_t* gea2_interface,
+  uint8_t client_address,
+  uint16_t request_timeout,
+  uint8_t request_retries);
+
+/*!
+ * Subscribe to erd_count ERDs on address. Returns false if a request is already outstanding.
+ */
+bool gea2_erd_subscriber_subscribe(
+  Gea2ErdSubscriber_t* self,
+  uint8_t address,
+  const tiny_erd_t* erds,
+  uint8_t erd_count);
+
+/*!
+ * True while a request is outstanding.
+ */
+bool gea2_erd_subscriber_busy(
+  Gea2ErdSubscriber_t* self);
+
+/*!
+ * Raised for each ERD requested, accepted or not, and when a request completes or fails.
+ * Completed and failed requests report the bytes every attempt put on the bus.
+ */
+i_tiny_event_t* gea2_erd_subscriber_on_activity(
+  Gea2ErdSubscriber_t* self);
+
+#endif
@@ -6,24 +6,76 @@
 #include <Arduino.h>
 
 extern "C" {
+#include "ApplianceErds.h"
 #include "Gea2MqttBridge.h"
 #include "i_tiny_gea2_erd_client.h"
 #include "tiny_gea_constants.h"
 #include "tiny_utils.h"
 }
-#include "ApplianceErds.h"
 
 #include <Preferences.h>
-#include <set>
 
-using namespace std;
 typedef Gea2MqttBridge_t self_t;
 
 enum {
   retry_delay = 3000,
   appliance_lost_timeout = 60000,
   mqtt_info_update_period = 1000,
-  ticks_per_second = 1000
+  republish_step_period = 100,
+  republish_erds_per_step = 16,
+  ticks_per_second = 1000,
+  max_erds_per_unsized_batch = 8,
+  new_size_confirmations = 2,
+  changed_size_confirmations = 3,
+  assumed_erd_size = 16,
+  max_batch_failures = 3,
+  snapshot_holdoff = 10000,
+  appliance_type_unknown = 0xFF,
+  profile_verify_cycles = 2,
+  max_profile_erd_failures = 2,
+  max_recovery_attempts = 10,
+  background_probes_per_cycle = 2,
+  discovery_checkpoint_interval = 32,
+  max_discovery_poll_share = 90,
+  min_bus_duty_cycle = 10,
+  max_bus_duty_cycle = 100,
+  bus_byte_time = GEA2_ROUND_TRIP_ESTIMATOR_BYTE_TIME,
+  microseconds_per_tick = 1000,
+  bus_utilization_period = 10,
+  poll_rate_automatic = 0,
+  poll_rate_forced_active,
+  poll_rate_forced_idle,
+  poll_cycle_period_family_default = 0xFFFF,
+  max_poll_cycle_period = 50,
+  appliance_state_check_period = 5000,
+  node_scan_time = 500,
+  seconds_per_hour = 3600,
+  absent_erd_max_age_hours = 168,
+  subscribe_retry_delay_seconds = 60,
+  push_support_unknown = 0,
+  push_support_probing,
+  push_supported,
+  push_unsupported
+};
+
+enum {
+  poll_batch_selected,
+  poll_batch_starts_cycle,
+  poll_batch_none_due
+};
+
+enum {
+  erd_client_request_size = 4, // Command, ERD count and ERD
+  erd_client_value_header_size = 5 // The same followed by the data size
+};
+
+enum {
+  command_failure_reason_rate_limited = 0x80,
+  command_failure_reason_unknown_command,
+  command_failure_reason_bad_chunk,
+  command_failure_reason_bad_profile,
+  command_failure_reason_bad_setting,
+  command_failure_reason_busy
 };
 
 enum {
@@ -33,39 +85,267 @@ enum {
   signal_read_completed,
   signal_mqtt_disconnected,
   signal_appliance_lost,
-  signal_write_requested
+  signal_write_requested,
+  signal_batch_read_completed,
+  signal_batch_completed,
+  signal_batch_failed,
+  signal_nodes_scanned,
+  signal_erd_heard,
+  signal_subscriber_activity,
+  signal_poll_pause_ended,
+  signal_probe_answered,
+  signal_probe_unanswered,
+  signal_profile_imported
 };
 
-static Preferences nvStorage;
 #define RW_MODE false
 #define RO_MODE true
 
+static bool BitIsSet(const uint8_t* bits, uint16_t index)
+{
+  return bits[index / 8] & (1 << (index % 8));
+}
+
+static void SetBit(uint8_t* bits, uint16_t index)
+{
+  bits[index / 8] |= (1 << (index % 8));
+}
+
+static void ClearBit(uint8_t* bits, uint16_t index)
+{
+  bits[index / 8] &= ~(1 << (index % 8));
+}
+
+static void CopyBit(uint8_t* bits, uint16_t to, uint16_t from)
+{
+  if(BitIsSet(bits, from)) {
+    SetBit(bits, to);
+  }
+  else {
+    ClearBit(bits, to);
+  }
+}
+
+// Frees the slot of an ERD by moving the slots above it down, so the arena never has holes and
+// the other ERDs keep their cached values
+static void FreeErdValueSlot(self_t* self, uint16_t index)
+{
+  uint16_t offset = self->erd_value_offset[index];
+  if(offset == ERD_VALUE_NO_SLOT) {
+    return;
+  }
+
+  uint8_t size = self->erd_value_slot_size[index];
+  memmove(
+    &self->erd_value_arena[offset],
+    &self->erd_value_arena[offset + size],
+    self->erdValueArenaUsed - offset - size);
+  self->erdValueArenaUsed -= size;
+  for(uint16_t i = 0; i < self->pollingListCount; i++) {
+    if((self->erd_value_offset[i] != ERD_VALUE_NO_SLOT) && (self->erd_value_offset[i] > offset)) {
+      self->erd_value_offset[i] -= size;
+    }
+  }
+  self->erd_value_offset[index] = ERD_VALUE_NO_SLOT;
+}
+
+// An ERD whose size is relearned keeps its slot when the new size fits and otherwise gives it
+// up for a new one, so a size that keeps changing cannot use up the arena
+static void AssignErdValueSlot(self_t* self, uint16_t index)
+{
+  uint8_t size = self->erd_size_list[index];
+  ClearBit(self->erd_value_cached, index);
+  if((self->erd_value_offset[index] != ERD_VALUE_NO_SLOT) && (size <= self->erd_value_slot_size[index])) {
+    return;
+  }
+
+  FreeErdValueSlot(self, index);
+  if((size > 0) && (self->erdValueArenaUsed + size <= ERD_VALUE_ARENA_SIZE)) {
+    self->erd_value_offset[index] = self->erdValueArenaUsed;
+    self->erd_value_slot_size[index] = size;
+    self->erdValueArenaUsed += size;
+  }
+}
+
+static void NewErdValueSlot(self_t* self, uint16_t index)
+{
+  self->erd_value_offset[index] = ERD_VALUE_NO_SLOT;
+  AssignErdValueSlot(self, index);
+}
+
+static void LayoutErdValueArena(self_t* self)
+{
+  self->erdValueArenaUsed = 0;
+  for(uint16_t i = 0; i < self->pollingListCount; i++) {
+    NewErdValueSlot(self, i);
+  }
+}
+
+// Returns true if the value differs from the cached one. ERDs without a slot always count as changed.
+static bool StoreErdValue(self_t* self, uint16_t index, const void* data, uint8_t size)
+{
+  uint16_t offset = self->erd_value_offset[index];
+  if((offset == ERD_VALUE_NO_SLOT) || (size != self->erd_size_list[index])) {
+    return true;
+  }
+
+  uint8_t* value = &self->erd_value_arena[offset];
+  if(BitIsSet(self->erd_value_cached, index) && (memcmp(value, data, size) == 0)) {
+    return false;
+  }
+
+  memcpy(value, data, size);
+  SetBit(self->erd_value_cached, index);
+  return true;
+}
+
+static void RegisterErd(self_t* self, uint16_t index)
+{
+  if(!BitIsSet(self->erd_registered, index)) {
+    mqtt_client_register_erd(self->mqtt_client, self->erd_polling_list[index]);
+    SetBit(self->erd_registered, index);
+  }
+}
+
+// The cache is republished a few ERDs at a time, so the burst fits in the MQTT queue alongside
+// everything else being published
+static void RepublishNextErdValues(void* context)
+{
+  self_t* self = (self_t*)context;
+  uint16_t end = self->republishIndex + republish_erds_per_step;
+  for(; (self->republishIndex < end) && (self->republishIndex < self->pollingListCount); self->republishIndex++) {
+    uint16_t i = self->republishIndex;
+    RegisterErd(self, i);
+    if(BitIsSet(self->erd_value_cached, i)) {
+      mqtt_client_update_erd(
+        self->mqtt_client,
+        self->erd_polling_list[i],
+        &self->erd_value_arena[self->erd_value_offset[i]],
+        self->erd_size_list[i]);
+    }
+  }
+  if(self->republishIndex < self->pollingListCount) {
+    tiny_timer_start(self->timer_group, &self->republishTimer, republish_step_period, self, RepublishNextErdValues);
+  }
+}
+
+static void RepublishErdValues(self_t* self)
+{
+  self->republishIndex = 0;
+  RepublishNextErdValues(self);
+}
+
 static bool ValidPollingListLoaded(self_t* self)
 {
+  Preferences nvStorage;
   char buffer[80];
   self->pollingListCount = 0;
-  if(nvStorage.begin("storage", RO_MODE)) {
+  if(nvStorage.begin(self->storage_namespace, RO_MODE)) {
     Serial.println("NV storage found and opened");
     self->pollingListCount = nvStorage.getUInt("erdCount", 0);
     sprintf(buffer, "Stored number of polled ERDs is %d\n", self->pollingListCount);
     Serial.print(buffer);
     if(self->pollingListCount > 0) {
       size_t bytesRead = nvStorage.getBytes("erdList", self->erd_polling_list, sizeof(self->erd_polling_list));
-      sprintf(buffer, "Loaded %d bytes into polling list\n", bytesRead);
+      sprintf(buffer, "Loaded %u bytes into polling list\n", (unsigned)bytesRead);
+      Serial.print(buffer);
+      memset(self->erd_size_list, 0, sizeof(self->erd_size_list));
+      bytesRead = nvStorage.getBytes("erdSizes", self->erd_size_list, sizeof(self->erd_size_list));
+      sprintf(buffer, "Loaded %u bytes into ERD size list\n", (unsigned)bytesRead);
       Serial.print(buffer);
+      memset(self->erd_size_votes, 0, sizeof(self->erd_size_votes));
+      LayoutErdValueArena(self);
       self->erd_host_address = nvStorage.getUChar("erdAddress", 0xFF);
       sprintf(buffer, "GEA address set to 0x%02X\n", self->erd_host_address);
       Serial.print(buffer);
+      if(nvStorage.getBytes("erdAddrs", self->erd_address_list, sizeof(self->erd_address_list)) == 0) {
+        memset(self->erd_address_list, self->erd_host_address, sizeof(self->erd_address_list));
+      }
+      self->appliance_type = nvStorage.getUChar("applianceType", appliance_type_unknown);
+      sprintf(buffer, "Appliance type set to 0x%02X\n", self->appliance_type);
+      Serial.print(buffer);
+      self->model_key = nvStorage.getUInt("modelKey", 0);
     }
     nvStorage.end();
   }
   return (self->pollingListCount > 0);
 }
 
+// While discovery runs, the ERDs found so far and the candidate position are checkpointed under
+// keys of their own, so a reboot resumes discovery. Any full save or clear of the store drops them.
+// The ERDs are only written again when a candidate has answered since the last checkpoint, so
+// most checkpoints only move the position.
+static bool DiscoveryCheckpointLoaded(self_t* self)
+{
+  polling_profile_t profile;
+  profile.erds = self->erd_polling_list;
+  profile.sizes = self->erd_size_list;
+  profile.addresses = self->erd_address_list;
+  uint8_t encoded[POLLING_PROFILE_SIZE(POLLING_LIST_MAX_SIZE)];
+  size_t size = 0;
+  Preferences nvStorage;
+
+  self->discoveryCheckpoint = 0;
+  if(nvStorage.begin(self->storage_namespace, RO_MODE)) {
+    if(nvStorage.isKey("checkpoint")) {
+      size = nvStorage.getBytes("checkpoint", encoded, sizeof(encoded));
+      self->discoveryCheckpoint = nvStorage.getUShort("checkpointAt", 0);
+      self->discoveryNode = nvStorage.getUChar("checkpointNode", 0);
+      self->nodeCount = nvStorage.getBytes("nodes", self->node_addresses, sizeof(self->node_addresses));
+      self->model_key = nvStorage.getUInt("modelKey", 0);
+    }
+    nvStorage.end();
+  }
+
+  if((size == 0) || (self->discoveryCheckpoint == 0) || (self->discoveryNode >= self->nodeCount) ||
+    !polling_profile_decode(&profile, POLLING_LIST_MAX_SIZE, encoded, size)) {
+    self->discoveryCheckpoint = 0;
+    return false;
+  }
+
+  self->appliance_type = profile.applianceType;
+  self->erd_host_address = profile.address;
+  self->pollingListCount = profile.erdCount;
+  self->discoveryCheckpointErds = profile.erdCount;
+  memset(self->erd_registered, 0, sizeof(self->erd_registered));
+  memset(self->erd_size_votes, 0, sizeof(self->erd_size_votes));
+  LayoutErdValueArena(self);
+  return true;
+}
+
+static void SaveDiscoveryCheckpoint(self_t* self)
+{
+  Preferences nvStorage;
+
+  self->discoveryCheckpoint = self->candidateIterator.position;
+  if(nvStorage.begin(self->storage_namespace, RW_MODE)) {
+    if(self->pollingListCount != self->discoveryCheckpointErds) {
+      polling_profile_t profile;
+      profile.applianceType = self->appliance_type;
+      profile.address = self->erd_host_address;
+      profile.erdCount = self->pollingListCount;
+      profile.erds = self->erd_polling_list;
+      profile.sizes = self->erd_size_list;
+      profile.addresses = self->erd_address_list;
+      uint8_t encoded[POLLING_PROFILE_SIZE(POLLING_LIST_MAX_SIZE)];
+      size_t size = polling_profile_encode(&profile, encoded, sizeof(encoded));
+      nvStorage.putBytes("checkpoint", encoded, size);
+      nvStorage.putBytes("nodes", self->node_addresses, self->nodeCount);
+      nvStorage.putUInt("modelKey", self->model_key);
+      self->discoveryCheckpointErds = self->pollingListCount;
+    }
+    nvStorage.putUShort("checkpointAt", self->discoveryCheckpoint);
+    nvStorage.putUChar("checkpointNode", self->discoveryNode);
+    nvStorage.end();
+  }
+  Serial.println("Discovery checkpoint at candidate " + String(self->discoveryCheckpoint));
+}
+
 static void SavePollingListToNVStore(self_t* self)
 {
+  Preferences nvStorage;
   char buffer[80];
-  if(nvStorage.begin("storage", RW_MODE)) {
+  if(nvStorage.begin(self->storage_namespace, RW_MODE)) {
     Serial.println("NV storage found and opened for write");
     if(nvStorage.clear()) {
       Serial.println("NV storage cleared");
@@ -74,27 +354,178 @@ static void SavePollingListToNVStore(self_t* self)
       Serial.println("NV storage not cleared");
     }
     size_t freeEntries = nvStorage.freeEntries();
-    sprintf(buffer, "Initial free entries = %d\n", freeEntries);
+    sprintf(buffer, "Initial free entries = %u\n", (unsigned)freeEntries);
     Serial.print(buffer);
     size_t bytesWritten = nvStorage.putBytes("erdList", self->erd_polling_list, sizeof(self->erd_polling_list));
-    sprintf(buffer, "Wrote %d bytes to store list\n", bytesWritten);
+    sprintf(buffer, "Wrote %u bytes to store list\n", (unsigned)bytesWritten);
+    Serial.print(buffer);
+    bytesWritten = nvStorage.putBytes("erdSizes", self->erd_size_list, sizeof(self->erd_size_list));
+    sprintf(buffer, "Wrote %u bytes to store ERD sizes\n", (unsigned)bytesWritten);
+    Serial.print(buffer);
+    bytesWritten = nvStorage.putBytes("erdAddrs", self->erd_address_list, sizeof(self->erd_address_list));
+    sprintf(buffer, "Wrote %u bytes to store ERD addresses\n", (unsigned)bytesWritten);
     Serial.print(buffer);
     bytesWritten = nvStorage.putUInt("erdCount", self->pollingListCount);
-    sprintf(buffer, "Wrote %d bytes to store erd count of %d\n", bytesWritten, self->pollingListCount);
+    sprintf(buffer, "Wrote %u bytes to store erd count of %d\n", (unsigned)bytesWritten, self->pollingListCount);
     Serial.print(buffer);
     bytesWritten = nvStorage.putUChar("erdAddress", self->erd_host_address);
-    sprintf(buffer, "Wrote %d bytes to store GEA address of 0x%02X\n", bytesWritten, self->erd_host_address);
+    sprintf(buffer, "Wrote %u bytes to store GEA address of 0x%02X\n", (unsigned)bytesWritten, self->erd_host_address);
+    Serial.print(buffer);
+    bytesWritten = nvStorage.putUChar("applianceType", self->appliance_type);
+    sprintf(buffer, "Wrote %u bytes to store appliance type of 0x%02X\n", (unsigned)bytesWritten, self->appliance_type);
+    Serial.print(buffer);
+    bytesWritten = nvStorage.putUInt("modelKey", self->model_key);
+    sprintf(buffer, "Wrote %u bytes to store model key of %08lX\n", (unsigned)bytesWritten, (unsigned long)self->model_key);
     Serial.print(buffer);
     freeEntries = nvStorage.freeEntries();
-    sprintf(buffer, "Final free entries = %d\n", freeEntries);
+    sprintf(buffer, "Final free entries = %u\n", (unsigned)freeEntries);
     Serial.print(buffer);
     nvStorage.end();
   }
 }
 
+static bool LoadKnownPollingProfile(self_t* self)
+{
+  polling_profile_t profile;
+  profile.erds = self->erd_polling_list;
+  profile.sizes = self->erd_size_list;
+  profile.addresses = self->erd_address_list;
+
+  if((self->model_key == 0) ||
+    !polling_profile_load(self->model_key, &profile, POLLING_LIST_MAX_SIZE) ||
+    (profile.applianceType != self->appliance_type)) {
+    return false;
+  }
+
+  self->pollingListCount = profile.erdCount;
+  memset(self->erd_registered, 0, sizeof(self->erd_registered));
+  memset(self->erd_poll_failures, 0, sizeof(self->erd_poll_failures));
+  memset(self->erd_size_votes, 0, sizeof(self->erd_size_votes));
+  LayoutErdValueArena(self);
+  self->profileVerifyCycles = profile_verify_cycles;
+  self->pollingListChanged = false;
+  return true;
+}
+
+static void SaveKnownPollingProfile(self_t* self)
+{
+  if(self->model_key == 0) {
+    return;
+  }
+
+  polling_profile_t profile;
+  profile.applianceType = self->appliance_type;
+  profile.address = self->erd_host_address;
+  profile.erdCount = self->pollingListCount;
+  profile.erds = self->erd_polling_list;
+  profile.sizes = self->erd_size_list;
+  profile.addresses = self->erd_address_list;
+  polling_profile_save(self->model_key, &profile);
+}
+
+// Candidates that did not answer are remembered per model, by index in the candidate list, so
+// discovery and background probing can skip them. A candidate is only taken as absent once it
+// has missed in two passes, since each pass asks for it once, and the record is dropped if the
+// candidate list changes or after a week of operation so that ERDs added by a firmware update
+// are found eventually.
+static void ClearAbsentErds(self_t* self)
+{
+  memset(self->absent_erds, 0, sizeof(self->absent_erds));
+  memset(self->missed_erds, 0, sizeof(self->missed_erds));
+  self->absentErdsAge = 0;
+  self->absentErdsChanged = true;
+}
+
+static uint32_t CandidateListHash(self_t* self)
+{
+  return ErdRangeListHash(GetApplianceErdList(self->appliance_type));
+}
+
+static void LoadAbsentErds(self_t* self)
+{
+  if(self->model_key != 0) {
+    polling_profile_load_absent_erds(
+      self->model_key,
+      CandidateListHash(self),
+      self->absent_erds,
+      self->missed_erds,
+      sizeof(self->absent_erds),
+      &self->absentErdsAge);
+    self->absentErdsChanged = false;
+  }
+  else {
+    ClearAbsentErds(self);
+  }
+  if(self->absentErdsAge >= absent_erd_max_age_hours) {
+    Serial.println("Absent erd record aged out");
+    ClearAbsentErds(self);
+  }
+  self->absentErdsAgedAt = self->uptime;
+}
+
+static void SaveAbsentErds(self_t* self)
+{
+  if((self->model_key != 0) && self->absentErdsChanged) {
+    polling_profile_save_absent_erds(
+      self->model_key,
+      CandidateListHash(self),
+      self->absent_erds,
+      self->missed_erds,
+      sizeof(self->absent_erds),
+      self->absentErdsAge);
+  }
+  self->absentErdsChanged = false;
+}
+
+static void AgeAbsentErds(self_t* self)
+{
+  while(self->uptime - self->absentErdsAgedAt >= seconds_per_hour) {
+    self->absentErdsAgedAt += seconds_per_hour;
+    self->absentErdsAge++;
+    self->absentErdsChanged = true;
+  }
+  if(self->absentErdsAge >= absent_erd_max_age_hours) {
+    Serial.println("Absent erd record aged out");
+    ClearAbsentErds(self);
+  }
+}
+
+static void RecordCandidateAnswer(self_t* self, uint16_t candidate, bool answered)
+{
+  if(answered) {
+    if(!BitIsSet(self->absent_erds, candidate) && !BitIsSet(self->missed_erds, candidate)) {
+      return;
+    }
+    ClearBit(self->absent_erds, candidate);
+    ClearBit(self->missed_erds, candidate);
+  }
+  else if(BitIsSet(self->missed_erds, candidate)) {
+    if(BitIsSet(self->absent_erds, candidate)) {
+      return;
+    }
+    SetBit(self->absent_erds, candidate);
+  }
+  else {
+    SetBit(self->missed_erds, candidate);
+  }
+  self->absentErdsChanged = true;
+}
+
+// Advance to the next candidate that is not known to be absent
+static bool NextCandidateToProbe(self_t* self, erd_range_iterator_t* iterator, tiny_erd_t* erd)
+{
+  while(ErdRangeIteratorNext(iterator, erd)) {
+    if(!BitIsSet(self->absent_erds, iterator->index)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 static void ClearNVStorage(self_t* self)
 {
-  if(nvStorage.begin("storage", RW_MODE)) {
+  Preferences nvStorage;
+  if(nvStorage.begin(self->storage_namespace, RW_MODE)) {
     Serial.println("NV storage found and opened for write");
     if(nvStorage.clear()) {
       Serial.println("NV storage cleared");
@@ -106,6 +537,21 @@ static void ClearNVStorage(self_t* self)
   }
 }
 
+static uint16_t ExchangeBusBytes(uint16_t requestPayload, uint16_t responsePayload)
+{
+  return requestPayload + responsePayload + 2 * GEA2_ROUND_TRIP_ESTIMATOR_FRAME_OVERHEAD;
+}
+
+// Everything the bridge puts on the bus (polls, probes, subscriptions, and the reads and writes
+// made through the ERD client) counts towards busUtilization and, below a 100% duty cycle, is
+// owed as a pause before the next poll batch
+static void ChargeBusBytes(self_t* self, uint16_t busBytes)
+{
+  uint32_t busTime = (uint32_t)busBytes * bus_byte_time;
+  self->busTimeUsed += busTime;
+  self->pollPauseOwed += busTime * (max_bus_duty_cycle - self->busDutyCycle) / self->busDutyCycle;
+}
+
 static void publishMqttInfo(void* context)
 {
   self_t* self = (self_t*)context;
@@ -126,6 +572,12 @@ static void publishMqttInfo(void* context)
   }
   lastErdPayload = "0x" + lastErdPayload;
   mqtt_client_publish_sub_topic(self->mqtt_client, "lastErd", lastErdPayload.c_str());
+
+  if((self->uptime % bus_utilization_period) == 0) {
+    auto busUtilizationPayload = String(self->busTimeUsed / (bus_utilization_period * (1000000UL / 100)));
+    mqtt_client_publish_sub_topic(self->mqtt_client, "busUtilization", busUtilizationPayload.c_str());
+    self->busTimeUsed = 0;
+  }
 }
 
 static void startMqttInfoTimer(self_t* self)
@@ -166,299 +618,1565 @@ static void DisarmRetryTimer(self_t* self)
   tiny_timer_stop(self->timer_group, &self->timer);
 }
 
-static set<tiny_erd_t>& erd_set(self_t* self)
-{
-  return *reinterpret_cast<set<tiny_erd_t>*>(self->erd_set);
-}
-
 static tiny_hsm_result_t State_Top(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data);
 static tiny_hsm_result_t State_IdentifyAppliance(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data);
-static tiny_hsm_result_t State_AddCommonErds(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data);
-static tiny_hsm_result_t State_AddEnergyErds(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data);
+static tiny_hsm_result_t State_IdentifyModel(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data);
+static tiny_hsm_result_t State_RecoverAppliance(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data);
+static tiny_hsm_result_t State_ScanNodes(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data);
+
+static uint8_t PlanPollBatch(self_t* self);
+static uint8_t SelectNextPollBatch(self_t* self);
+static void ResetPollNodes(self_t* self);
+static void StorePolledErdValue(self_t* self, const gea2_erd_batch_reader_on_activity_args_t* args);
+static void PollBatchFinished(self_t* self, uint8_t erd_count, uint8_t erds_read);
+static void ReleasePollCycle(self_t* self);
 static tiny_hsm_result_t State_AddApplianceErds(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data);
 static tiny_hsm_result_t State_PollErdsFromList(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data);
 
-static tiny_hsm_result_t State_Top(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data)
+static void RegisterCommandErds(self_t* self)
 {
-  self_t* self = container_of(self_t, hsm, hsm);
-  (void)data;
-
-  switch(signal) {
-    case signal_write_requested: {
-      auto args = reinterpret_cast<const mqtt_client_on_write_request_args_t*>(data);
-      tiny_gea2_erd_client_write(self->erd_client, &self->request_id, self->erd_host_address, args->erd, args->value, args->size);
-    } break;
-
-    case signal_appliance_lost: {
-      ClearNVStorage(self);
-      tiny_hsm_transition(hsm, State_IdentifyAppliance);
-    } break;
-
-    default:
-      return tiny_hsm_result_signal_deferred;
-  }
-
-  return tiny_hsm_result_signal_consumed;
+  mqtt_client_register_erd(self->mqtt_client, BRIDGE_COMMAND_ERD_SNAPSHOT);
+  mqtt_client_register_erd(self->mqtt_client, BRIDGE_COMMAND_ERD_IMPORT_PROFILE);
+  mqtt_client_register_erd(self->mqtt_client, BRIDGE_COMMAND_ERD_DISCOVERY_POLL_SHARE);
+  mqtt_client_register_erd(self->mqtt_client, BRIDGE_COMMAND_ERD_BUS_DUTY_CYCLE);
+  mqtt_client_register_erd(self->mqtt_client, BRIDGE_COMMAND_ERD_POLL_RATE);
 }
 
-static tiny_hsm_result_t State_IdentifyAppliance(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data)
+static void HandleSnapshotCommand(self_t* self, const mqtt_client_on_write_request_args_t* args)
 {
-  self_t* self = container_of(self_t, hsm, hsm);
-  auto args = reinterpret_cast<const tiny_gea2_erd_client_on_activity_args_t*>(data);
-  char buffer[80];
-
-  switch(signal) {
-    case tiny_hsm_signal_entry: {
-      self->erd_host_address = tiny_gea_broadcast_address;
-    }
-      __attribute__((fallthrough));
+  if(tiny_timer_is_running(self->timer_group, &self->snapshotHoldoffTimer)) {
+    mqtt_client_update_erd_write_result(self->mqtt_client, args->erd, false, command_failure_reason_rate_limited);
+    return;
+  }
+  tiny_timer_start(self->timer_group, &self->snapshotHoldoffTimer, snapshot_holdoff, self, +[](void*) {});
 
-    case signal_timer_expired: {
-      sprintf(buffer, "Asking for appliance type ERD 0x0008 from address 0x%02X\n", self->erd_host_address);
-      Serial.print(buffer);
-      tiny_gea2_erd_client_read(self->erd_client, &self->request_id, self->erd_host_address, 0x0008);
-      arm_timer(self, retry_delay);
-      break;
-    }
-    case signal_read_completed: {
-      DisarmRetryTimer(self);
-      DisarmLostApplianceTimer(self);
-      if(args->read_completed.erd == 0x0008) {
-        self->erd_host_address = args->address;
-        sprintf(buffer, "Using GEA address 0x%02X\n", self->erd_host_address);
-        Serial.print(buffer);
-      }
+  Serial.println("Snapshot of " + String(self->pollingListCount) + " cached erds requested");
+  RepublishErdValues(self);
 
-      const uint8_t* applianceTypeResponse = (const uint8_t*)args->read_completed.data;
-      self->appliance_type = *applianceTypeResponse;
-      tiny_hsm_transition(hsm, State_AddCommonErds);
-      break;
+  if((args->size > 0) && (*reinterpret_cast<const uint8_t*>(args->value) & BRIDGE_COMMAND_SNAPSHOT_REFRESH)) {
+    if(self->pollCycleHeld) {
+      // A held poll cycle is waiting at the top of the list already
+      ReleasePollCycle(self);
     }
-    case tiny_hsm_signal_exit: {
-      DisarmRetryTimer(self);
-      break;
+    else {
+      self->refreshRequested = true;
     }
-    default:
-      return tiny_hsm_result_signal_deferred;
   }
-
-  return tiny_hsm_result_signal_consumed;
+  mqtt_client_update_erd_write_result(self->mqtt_client, args->erd, true, 0);
 }
 
-static bool SendNextReadRequest(self_t* self)
+static void PublishPollingProfile(self_t* self)
 {
-  self->erd_index++;
-  bool more_erds_to_try = (self->erd_index < self->applianceErdListCount);
-  if(more_erds_to_try) {
-    self->request_id++;
-    tiny_gea2_erd_client_read(self->erd_client, &self->request_id, self->erd_host_address, self->applianceErdList[self->erd_index]);
-    arm_timer(self, retry_delay);
+  static const char hexDigits[] = "0123456789ABCDEF";
+  polling_profile_t profile;
+  profile.applianceType = self->appliance_type;
+  profile.address = self->erd_host_address;
+  profile.erdCount = self->pollingListCount;
+  profile.erds = self->erd_polling_list;
+  profile.sizes = self->erd_size_list;
+  profile.addresses = self->erd_address_list;
+
+  // Encoded into the front of the buffer and then spelled out as hex from the back, so neither
+  // the profile nor its hex goes on the bus task stack or the heap. Every bridge runs in the
+  // same bus task, so one buffer does for all of them.
+  static char payload[POLLING_PROFILE_SIZE(POLLING_LIST_MAX_SIZE) * 2 + 1];
+  auto encoded = reinterpret_cast<uint8_t*>(payload);
+  size_t size = polling_profile_encode(&profile, encoded, POLLING_PROFILE_SIZE(POLLING_LIST_MAX_SIZE));
+
+  payload[size * 2] = '\0';
+  for(size_t i = size; i-- > 0;) {
+    uint8_t byte = encoded[i];
+    payload[i * 2] = hexDigits[byte >> 4];
+    payload[i * 2 + 1] = hexDigits[byte & 0x0F];
   }
-  return more_erds_to_try;
+  mqtt_client_publish_sub_topic(self->mqtt_client, "pollingProfile", payload);
 }
 
-static void AddErdToPollingList(self_t* self, tiny_erd_t erd)
+// An imported profile is decoded apart from the polling list, which is only replaced once the
+// profile has been found to be for this appliance type and to hold only its candidate ERDs
+static bool ImportedProfileIsValid(self_t* self)
 {
-  if(erd_set(self).find(erd) == erd_set(self).end()) {
-    mqtt_client_register_erd(self->mqtt_client, erd);
-    erd_set(self).insert(erd);
+  polling_profile_t* profile = &self->imported_profile;
+  profile->erds = self->imported_erds;
+  profile->sizes = self->imported_sizes;
+  profile->addresses = self->imported_addresses;
+
+  if(!polling_profile_decode(profile, POLLING_LIST_MAX_SIZE, self->profile_import_buffer, self->profileImportSize) ||
+    (profile->erdCount == 0)) {
+    return false;
   }
-  self->erd_polling_list[self->pollingListCount] = erd;
-  self->pollingListCount++;
+  if((self->appliance_type != appliance_type_unknown) && (profile->applianceType != self->appliance_type)) {
+    return false;
+  }
+  for(uint16_t i = 0; i < profile->erdCount; i++) {
+    if(!IsApplianceErdCandidate(profile->applianceType, profile->erds[i])) {
+      return false;
+    }
+  }
+  return true;
+}
 
-  char buffer[40];
-  sprintf(buffer, "#%d Add ERD erd %04X to polling list\n", self->pollingListCount, erd);
-  Serial.print(buffer);
+// The profile is verified like a stored one, and only saved as the known profile for the model
+// once verification has finished
+static void InstallImportedProfile(self_t* self)
+{
+  const polling_profile_t* profile = &self->imported_profile;
+  memcpy(self->erd_polling_list, profile->erds, profile->erdCount * sizeof(tiny_erd_t));
+  memcpy(self->erd_size_list, profile->sizes, profile->erdCount);
+  memcpy(self->erd_address_list, profile->addresses, profile->erdCount);
+  self->appliance_type = profile->applianceType;
+  self->erd_host_address = profile->address;
+  self->pollingListCount = profile->erdCount;
+  memset(self->erd_registered, 0, sizeof(self->erd_registered));
+  memset(self->erd_poll_failures, 0, sizeof(self->erd_poll_failures));
+  memset(self->erd_size_votes, 0, sizeof(self->erd_size_votes));
+  LayoutErdValueArena(self);
+  self->profileVerifyCycles = profile_verify_cycles;
+  self->pollingListChanged = true;
+  Serial.println("Imported polling profile with " + String(self->pollingListCount) + " erds");
 }
 
-static tiny_hsm_result_t State_AddCommonErds(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data)
+// Profiles are imported in chunks: a big endian byte offset followed by the next part of the
+// encoded profile. Offset 0 starts a new import; the profile is installed once it is complete.
+static void HandleImportProfileCommand(self_t* self, const mqtt_client_on_write_request_args_t* args)
 {
-  self_t* self = container_of(self_t, hsm, hsm);
-  auto args = reinterpret_cast<const tiny_gea2_erd_client_on_activity_args_t*>(data);
+  const uint8_t* payload = reinterpret_cast<const uint8_t*>(args->value);
+  if(args->size < 3) {
+    mqtt_client_update_erd_write_result(self->mqtt_client, args->erd, false, command_failure_reason_bad_chunk);
+    return;
+  }
 
-  switch(signal) {
-    case tiny_hsm_signal_entry: {
-      const tiny_erd_list_t* commonErds = GetCommonErdList();
-      self->applianceErdList = commonErds->erdList;
-      self->applianceErdListCount = commonErds->erdCount;
-      Serial.println("Starting looking for " + String(self->applianceErdListCount) + " common erds");
-      self->erd_index = 0;
-      self->pollingListCount = 0;
-      tiny_gea2_erd_client_read(self->erd_client, &self->request_id, self->erd_host_address, self->applianceErdList[self->erd_index]);
-      arm_timer(self, retry_delay);
-    } break;
+  uint16_t offset = (payload[0] << 8) | payload[1];
+  uint8_t chunkSize = args->size - 2;
+  if(offset == 0) {
+    self->profileImportSize = 0;
+  }
+  if((offset != self->profileImportSize) || (offset + chunkSize > sizeof(self->profile_import_buffer))) {
+    self->profileImportSize = 0;
+    mqtt_client_update_erd_write_result(self->mqtt_client, args->erd, false, command_failure_reason_bad_chunk);
+    return;
+  }
 
-    case signal_timer_expired:
-      if(!SendNextReadRequest(self)) {
-        tiny_hsm_transition(hsm, State_AddEnergyErds);
-      }
-      break;
+  memcpy(&self->profile_import_buffer[offset], &payload[2], chunkSize);
+  self->profileImportSize += chunkSize;
 
-    case signal_read_completed:
-      DisarmRetryTimer(self);
-      AddErdToPollingList(self, args->read_completed.erd);
-      mqtt_client_update_erd(
-        self->mqtt_client,
-        args->read_completed.erd,
-        args->read_completed.data,
-        args->read_completed.data_size);
+  if(self->profileImportSize < POLLING_PROFILE_HEADER_SIZE) {
+    mqtt_client_update_erd_write_result(self->mqtt_client, args->erd, true, 0);
+    return;
+  }
 
-      if(!SendNextReadRequest(self)) {
-        tiny_hsm_transition(hsm, State_AddEnergyErds);
-      }
-      break;
+  size_t profileSize = polling_profile_encoded_size(self->profile_import_buffer);
+  if((profileSize == 0) || (profileSize > sizeof(self->profile_import_buffer))) {
+    self->profileImportSize = 0;
+    mqtt_client_update_erd_write_result(self->mqtt_client, args->erd, false, command_failure_reason_bad_profile);
+    return;
+  }
+  if(self->profileImportSize < profileSize) {
+    mqtt_client_update_erd_write_result(self->mqtt_client, args->erd, true, 0);
+    return;
+  }
 
-    default:
-      return tiny_hsm_result_signal_deferred;
+  bool valid = ImportedProfileIsValid(self);
+  self->profileImportSize = 0;
+  if(!valid) {
+    mqtt_client_update_erd_write_result(self->mqtt_client, args->erd, false, command_failure_reason_bad_profile);
+    return;
   }
 
-  return tiny_hsm_result_signal_consumed;
+  // Only the states that are not building a polling list install it
+  tiny_hsm_send_signal(&self->hsm, signal_profile_imported, args);
 }
 
-static tiny_hsm_result_t State_AddEnergyErds(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data)
+static void HandleDiscoveryPollShareCommand(self_t* self, const mqtt_client_on_write_request_args_t* args)
 {
-  self_t* self = container_of(self_t, hsm, hsm);
-  auto args = reinterpret_cast<const tiny_gea2_erd_client_on_activity_args_t*>(data);
-  switch(signal) {
-    case tiny_hsm_signal_entry: {
-      const tiny_erd_list_t* energyErds = GetEnergyErdList();
-      self->applianceErdList = energyErds->erdList;
-      self->applianceErdListCount = energyErds->erdCount;
-      Serial.println("Starting looking for " + String(self->applianceErdListCount) + " energy erds");
-      self->erd_index = 0;
+  uint8_t share = (args->size > 0) ? *reinterpret_cast<const uint8_t*>(args->value) : 0xFF;
+  if((args->size != 1) || (share > max_discovery_poll_share)) {
+    mqtt_client_update_erd_write_result(self->mqtt_client, args->erd, false, command_failure_reason_bad_setting);
+    return;
+  }
 
-      tiny_gea2_erd_client_read(self->erd_client, &self->request_id, self->erd_host_address, self->applianceErdList[self->erd_index]);
-      arm_timer(self, retry_delay);
-    } break;
+  self->discoveryPollShare = share;
+  self->discoveryPollCredit = 0;
+  mqtt_client_update_erd_write_result(self->mqtt_client, args->erd, true, 0);
+}
 
-    case signal_timer_expired:
-      if(!SendNextReadRequest(self)) {
-        tiny_hsm_transition(hsm, State_AddApplianceErds);
-      }
-      break;
+static void HandleBusDutyCycleCommand(self_t* self, const mqtt_client_on_write_request_args_t* args)
+{
+  uint8_t dutyCycle = (args->size > 0) ? *reinterpret_cast<const uint8_t*>(args->value) : 0;
+  if((args->size != 1) || (dutyCycle < min_bus_duty_cycle) || (dutyCycle > max_bus_duty_cycle)) {
+    mqtt_client_update_erd_write_result(self->mqtt_client, args->erd, false, command_failure_reason_bad_setting);
+    return;
+  }
 
-    case signal_read_completed:
-      DisarmRetryTimer(self);
-      AddErdToPollingList(self, args->read_completed.erd);
+  self->busDutyCycle = dutyCycle;
+  self->pollPauseOwed = 0;
+  mqtt_client_update_erd_write_result(self->mqtt_client, args->erd, true, 0);
+}
+
+static void PollRateChanged(self_t* self);
+
+// One byte selects the rate, optionally followed by the active and idle cycle periods in
+// seconds, big endian, where FFFF restores the family default
+static void HandlePollRateCommand(self_t* self, const mqtt_client_on_write_request_args_t* args)
+{
+  auto payload = reinterpret_cast<const uint8_t*>(args->value);
+  if(((args->size != 1) && (args->size != 1 + 2 * poll_rate_count)) || (payload[0] > poll_rate_forced_idle)) {
+    mqtt_client_update_erd_write_result(self->mqtt_client, args->erd, false, command_failure_reason_bad_setting);
+    return;
+  }
+
+  uint16_t periods[poll_rate_count];
+  for(uint8_t rate = 0; rate < poll_rate_count; rate++) {
+    periods[rate] = self->poll_cycle_period[rate];
+    if(args->size > 1) {
+      periods[rate] = (payload[1 + rate * 2] << 8) | payload[2 + rate * 2];
+      if((periods[rate] != poll_cycle_period_family_default) && (periods[rate] > max_poll_cycle_period)) {
+        mqtt_client_update_erd_write_result(self->mqtt_client, args->erd, false, command_failure_reason_bad_setting);
+        return;
+      }
+    }
+  }
+
+  self->pollRateOverride = payload[0];
+  memcpy(self->poll_cycle_period, periods, sizeof(periods));
+  mqtt_client_update_erd_write_result(self->mqtt_client, args->erd, true, 0);
+  PollRateChanged(self);
+}
+
+static void HandleBridgeCommand(self_t* self, const mqtt_client_on_write_request_args_t* args)
+{
+  switch(args->erd) {
+    case BRIDGE_COMMAND_ERD_SNAPSHOT:
+      HandleSnapshotCommand(self, args);
+      break;
+
+    case BRIDGE_COMMAND_ERD_IMPORT_PROFILE:
+      HandleImportProfileCommand(self, args);
+      break;
+
+    case BRIDGE_COMMAND_ERD_DISCOVERY_POLL_SHARE:
+      HandleDiscoveryPollShareCommand(self, args);
+      break;
+
+    case BRIDGE_COMMAND_ERD_BUS_DUTY_CYCLE:
+      HandleBusDutyCycleCommand(self, args);
+      break;
+
+    case BRIDGE_COMMAND_ERD_POLL_RATE:
+      HandlePollRateCommand(self, args);
+      break;
+
+    default:
+      mqtt_client_update_erd_write_result(self->mqtt_client, args->erd, false, command_failure_reason_unknown_command);
+      break;
+  }
+}
+
+static bool PollingListContains(self_t* self, tiny_erd_t erd)
+{
+  for(uint16_t i = 0; i < self->pollingListCount; i++) {
+    if(self->erd_polling_list[i] == erd) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static uint8_t AddressOfErd(self_t* self, tiny_erd_t erd)
+{
+  for(uint16_t i = 0; i < self->pollingListCount; i++) {
+    if(self->erd_polling_list[i] == erd) {
+      return self->erd_address_list[i];
+    }
+  }
+  return self->erd_host_address;
+}
+
+static bool ErdHeardRecently(self_t* self, uint16_t index)
+{
+  uint16_t freshness = BitIsSet(self->erd_subscribed, index) ? GEA2_MQTT_BRIDGE_SUBSCRIBED_VERIFY_PERIOD : GEA2_MQTT_BRIDGE_PASSIVE_FRESHNESS;
+  return BitIsSet(self->erd_heard, index) && ((uint16_t)(self->uptime - self->erd_heard_at[index]) < freshness);
+}
+
+// While the duty cycle is what holds polling back, the bus time it leaves goes to the scored
+// ERDs that a dashboard needs; the others only get a turn every few cycles, or when nothing
+// else is due.
+static bool ErdPollDeferred(self_t* self, uint16_t index)
+{
+  if(ErdHeardRecently(self, index)) {
+    return true;
+  }
+  return self->deferLowPriority &&
+    self->pollThrottled &&
+    ((self->pollCycle % GEA2_MQTT_BRIDGE_LOW_PRIORITY_POLL_DIVISOR) != 0) &&
+    (GetErdScore(self->erd_polling_list[index]) == 0);
+}
+
+static poll_rate_t CurrentPollRate(self_t* self)
+{
+  switch(self->pollRateOverride) {
+    case poll_rate_forced_active:
+      return poll_rate_active;
+
+    case poll_rate_forced_idle:
+      return poll_rate_idle;
+
+    default:
+      return self->detectedPollRate;
+  }
+}
+
+static uint16_t PollCyclePeriod(self_t* self)
+{
+  poll_rate_t rate = CurrentPollRate(self);
+  uint16_t period = self->poll_cycle_period[rate];
+  if(period == poll_cycle_period_family_default) {
+    period = GetAppliancePollRates(self->appliance_type)->cyclePeriod[rate];
+  }
+  return period;
+}
+
+static void PublishPollRate(self_t* self)
+{
+  mqtt_client_publish_sub_topic(self->mqtt_client, "pollRate", (CurrentPollRate(self) == poll_rate_idle) ? "idle" : "active");
+}
+
+static int16_t ApplianceStateErdIndex(self_t* self)
+{
+  tiny_erd_t stateErd = GetAppliancePollRates(self->appliance_type)->stateErd;
+  for(uint16_t i = 0; (stateErd != 0) && (i < self->pollingListCount); i++) {
+    if(self->erd_polling_list[i] == stateErd) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Any new value of the family's state ERD, polled, read while the poll cycle is held or heard
+// on the bus, picks the poll rate
+static void WatchApplianceState(self_t* self, uint16_t index, const void* data, uint8_t size)
+{
+  const appliance_poll_rates_t* rates = GetAppliancePollRates(self->appliance_type);
+  if((size == 0) || (rates->stateErd == 0) || (self->erd_polling_list[index] != rates->stateErd)) {
+    return;
+  }
+
+  uint8_t state = *reinterpret_cast<const uint8_t*>(data);
+  poll_rate_t rate = poll_rate_active;
+  for(uint8_t i = 0; i < rates->idleStateCount; i++) {
+    if(rates->idleStates[i] == state) {
+      rate = poll_rate_idle;
+    }
+  }
+
+  if(rate != self->detectedPollRate) {
+    self->detectedPollRate = rate;
+    PollRateChanged(self);
+  }
+}
+
+static bool ErdSizeIsExpected(self_t* self, int16_t index, tiny_erd_t erd, uint8_t size);
+
+// A value heard on the bus is cached and published like a polled one, and keeps the ERD out of
+// the poll schedule while it is fresh. Traffic between other nodes never changes a known size.
+static void StoreHeardErdValue(self_t* self, const gea2_bus_sniffer_on_erd_args_t* args)
+{
+  for(uint16_t i = 0; i < self->pollingListCount; i++) {
+    if((self->erd_polling_list[i] != args->erd) || (self->erd_address_list[i] != args->address)) {
+      continue;
+    }
+    if((self->erd_size_list[i] != 0) && (self->erd_size_list[i] != args->data_size)) {
+      return;
+    }
+    ErdSizeIsExpected(self, i, args->erd, args->data_size);
+
+    SetBit(self->erd_heard, i);
+    self->erd_heard_at[i] = self->uptime;
+    if(StoreErdValue(self, i, args->data, args->data_size)) {
+      mqtt_client_update_erd(self->mqtt_client, args->erd, args->data, args->data_size);
+      WatchApplianceState(self, i, args->data, args->data_size);
+    }
+    return;
+  }
+}
+
+static int16_t HostErdIndex(self_t* self, tiny_erd_t erd)
+{
+  for(uint16_t i = 0; i < self->pollingListCount; i++) {
+    if((self->erd_polling_list[i] == erd) && (self->erd_address_list[i] == self->erd_host_address)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Whether the machine control publishes ERD changes is found by subscribing to the appliance
+// type ERD. A node without publication support does not answer the request at all.
+static void ProbePushSupport(self_t* self)
+{
+  static const tiny_erd_t probeErd = 0x0008;
+
+  if((self->pushSupport != push_support_unknown) || gea2_erd_subscriber_busy(self->erd_subscriber)) {
+    return;
+  }
+  self->pushSupport = push_support_probing;
+  gea2_erd_subscriber_subscribe(self->erd_subscriber, self->erd_host_address, &probeErd, 1);
+}
+
+// Subscribes to the next machine control ERDs on the polling list that are neither subscribed
+// nor known to be rejected. ERDs on other boards are always polled.
+static void SubscribeNextErds(self_t* self)
+{
+  if((self->pushSupport != push_supported) ||
+    gea2_erd_subscriber_busy(self->erd_subscriber) ||
+    (self->uptime < self->subscribeAfter)) {
+    return;
+  }
+
+  tiny_erd_t erds[GEA2_ERD_SUBSCRIBER_MAX_ERDS];
+  uint8_t count = 0;
+  for(; (self->subscribeIndex < self->pollingListCount) && (count < GEA2_ERD_SUBSCRIBER_MAX_ERDS); self->subscribeIndex++) {
+    uint16_t i = self->subscribeIndex;
+    if((self->erd_address_list[i] == self->erd_host_address) &&
+      !BitIsSet(self->erd_subscribed, i) &&
+      !BitIsSet(self->erd_push_rejected, i)) {
+      erds[count++] = self->erd_polling_list[i];
+    }
+  }
+
+  if(count == 0) {
+    self->subscribeIndex = 0;
+    return;
+  }
+  gea2_erd_subscriber_subscribe(self->erd_subscriber, self->erd_host_address, erds, count);
+}
+
+// A subscribed ERD only needs the occasional verification poll, so it is treated as heard
+static void SubscriberActivity(self_t* self, const gea2_erd_subscriber_on_activity_args_t* args)
+{
+  if(args->address != self->erd_host_address) {
+    return;
+  }
+
+  switch(args->type) {
+    case gea2_erd_subscriber_activity_type_erd_subscribed: {
+      int16_t index = HostErdIndex(self, args->erd_subscribed.erd);
+      if(index >= 0) {
+        SetBit(self->erd_subscribed, index);
+        SetBit(self->erd_heard, index);
+        self->erd_heard_at[index] = self->uptime;
+      }
+    } break;
+
+    case gea2_erd_subscriber_activity_type_erd_rejected: {
+      int16_t index = HostErdIndex(self, args->erd_rejected.erd);
+      if(index >= 0) {
+        ClearBit(self->erd_subscribed, index);
+        SetBit(self->erd_push_rejected, index);
+      }
+    } break;
+
+    case gea2_erd_subscriber_activity_type_request_completed:
+      if(self->pushSupport != push_supported) {
+        Serial.println("Appliance publishes ERD changes, subscribing");
+        self->pushSupport = push_supported;
+        self->subscribeIndex = 0;
+      }
+      break;
+
+    case gea2_erd_subscriber_activity_type_request_failed:
+      if(self->pushSupport == push_support_probing) {
+        Serial.println("Appliance does not publish ERD changes, polling");
+        self->pushSupport = push_unsupported;
+      }
+      else {
+        self->subscribeAfter = self->uptime + subscribe_retry_delay_seconds;
+        self->subscribeIndex = 0;
+      }
+      break;
+  }
+}
+
+static tiny_hsm_result_t State_Top(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data)
+{
+  self_t* self = container_of(self_t, hsm, hsm);
+  (void)data;
+
+  switch(signal) {
+    case signal_write_requested: {
+      auto args = reinterpret_cast<const mqtt_client_on_write_request_args_t*>(data);
+      if(args->erd >= BRIDGE_COMMAND_ERD_FIRST) {
+        HandleBridgeCommand(self, args);
+        break;
+      }
+      tiny_gea2_erd_client_write(self->erd_client, &self->request_id, AddressOfErd(self, args->erd), args->erd, args->value, args->size);
+    } break;
+
+    case signal_appliance_lost: {
+      tiny_hsm_transition(hsm, State_RecoverAppliance);
+    } break;
+
+    case signal_profile_imported: {
+      auto args = reinterpret_cast<const mqtt_client_on_write_request_args_t*>(data);
+      Serial.println("Polling profiles are only imported while polling or waiting for an appliance");
+      mqtt_client_update_erd_write_result(self->mqtt_client, args->erd, false, command_failure_reason_busy);
+    } break;
+
+    case signal_erd_heard:
+      StoreHeardErdValue(self, reinterpret_cast<const gea2_bus_sniffer_on_erd_args_t*>(data));
+      break;
+
+    case signal_subscriber_activity:
+      SubscriberActivity(self, reinterpret_cast<const gea2_erd_subscriber_on_activity_args_t*>(data));
+      break;
+
+    default:
+      return tiny_hsm_result_signal_deferred;
+  }
+
+  return tiny_hsm_result_signal_consumed;
+}
+
+static tiny_hsm_result_t State_IdentifyAppliance(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data)
+{
+  self_t* self = container_of(self_t, hsm, hsm);
+  auto args = reinterpret_cast<const tiny_gea2_erd_client_on_activity_args_t*>(data);
+  char buffer[80];
+
+  switch(signal) {
+    case tiny_hsm_signal_entry: {
+      self->erd_host_address = tiny_gea_broadcast_address;
+      self->pushSupport = push_support_unknown;
+    }
+      __attribute__((fallthrough));
+
+    case signal_timer_expired: {
+      sprintf(buffer, "Asking for appliance type ERD 0x0008 from address 0x%02X\n", self->erd_host_address);
+      Serial.print(buffer);
+      tiny_gea2_erd_client_read(self->erd_client, &self->request_id, self->erd_host_address, 0x0008);
+      arm_timer(self, retry_delay);
+      break;
+    }
+    case signal_read_completed: {
+      DisarmRetryTimer(self);
+      DisarmLostApplianceTimer(self);
+      if(args->read_completed.erd == 0x0008) {
+        self->erd_host_address = args->address;
+        sprintf(buffer, "Using GEA address 0x%02X\n", self->erd_host_address);
+        Serial.print(buffer);
+      }
+
+      const uint8_t* applianceTypeResponse = (const uint8_t*)args->read_completed.data;
+      self->appliance_type = *applianceTypeResponse;
+      ProbePushSupport(self);
+      tiny_hsm_transition(hsm, State_IdentifyModel);
+      break;
+    }
+    case signal_profile_imported: {
+      // The model is not known until the appliance answers, so the profile is not kept for one
+      self->model_key = 0;
+      InstallImportedProfile(self);
+      mqtt_client_update_erd_write_result(
+        self->mqtt_client, reinterpret_cast<const mqtt_client_on_write_request_args_t*>(data)->erd, true, 0);
+      tiny_hsm_transition(hsm, State_PollErdsFromList);
+      break;
+    }
+    case tiny_hsm_signal_exit: {
+      DisarmRetryTimer(self);
+      break;
+    }
+    default:
+      return tiny_hsm_result_signal_deferred;
+  }
+
+  return tiny_hsm_result_signal_consumed;
+}
+
+static tiny_hsm_result_t State_IdentifyModel(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data)
+{
+  self_t* self = container_of(self_t, hsm, hsm);
+  auto args = reinterpret_cast<const tiny_gea2_erd_client_on_activity_args_t*>(data);
+  char buffer[80];
+
+  switch(signal) {
+    case tiny_hsm_signal_entry:
+      self->model_key = 0;
+      sprintf(buffer, "Asking for model number ERD 0x0001 from address 0x%02X\n", self->erd_host_address);
+      Serial.print(buffer);
+      tiny_gea2_erd_client_read(self->erd_client, &self->request_id, self->erd_host_address, 0x0001);
+      arm_timer(self, retry_delay);
+      break;
+
+    case signal_read_completed:
+      if(args->read_completed.erd != 0x0001) {
+        break;
+      }
+      DisarmRetryTimer(self);
+      self->model_key = polling_profile_key(self->appliance_type, args->read_completed.data, args->read_completed.data_size);
+      if(LoadKnownPollingProfile(self)) {
+        Serial.println("Known model, polling " + String(self->pollingListCount) + " erds from stored profile");
+        tiny_hsm_transition(hsm, State_PollErdsFromList);
+      }
+      else {
+        tiny_hsm_transition(hsm, State_ScanNodes);
+      }
+      break;
+
+    case signal_timer_expired:
+      Serial.println("No model number, discovering erds");
+      tiny_hsm_transition(hsm, State_ScanNodes);
+      break;
+
+    case tiny_hsm_signal_exit:
+      DisarmRetryTimer(self);
+      break;
+
+    default:
+      return tiny_hsm_result_signal_deferred;
+  }
+
+  return tiny_hsm_result_signal_consumed;
+}
+
+// The board that answered the appliance type read is probed first; other boards on the bus are
+// then probed for the candidates it does not have.
+static tiny_hsm_result_t State_ScanNodes(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data)
+{
+  self_t* self = container_of(self_t, hsm, hsm);
+  auto args = reinterpret_cast<const gea2_node_scanner_on_activity_args_t*>(data);
+  char buffer[40];
+
+  switch(signal) {
+    case tiny_hsm_signal_entry:
+      Serial.println("Scanning for GEA2 nodes");
+      gea2_node_scanner_scan(self->node_scanner, node_scan_time);
+      break;
+
+    case signal_nodes_scanned:
+      self->node_addresses[0] = self->erd_host_address;
+      self->nodeCount = 1;
+      for(uint8_t i = 0; i < args->scan_completed.node_count; i++) {
+        uint8_t address = args->scan_completed.addresses[i];
+        if((address != self->erd_host_address) && (self->nodeCount < GEA2_NODE_SCANNER_MAX_NODES)) {
+          self->node_addresses[self->nodeCount++] = address;
+          sprintf(buffer, "Found GEA2 node 0x%02X\n", address);
+          Serial.print(buffer);
+        }
+      }
+      self->discoveryNode = 0;
+      tiny_hsm_transition(hsm, State_AddApplianceErds);
+      break;
+
+    case tiny_hsm_signal_exit:
+      gea2_node_scanner_cancel(self->node_scanner);
+      break;
+
+    default:
+      return tiny_hsm_result_signal_deferred;
+  }
+
+  return tiny_hsm_result_signal_consumed;
+}
+
+static void ResumeRecoveredAppliance(self_t* self, uint32_t model_key)
+{
+  if(model_key == self->model_key) {
+    Serial.println("Same appliance found again, resuming polling");
+  }
+  else {
+    self->model_key = model_key;
+    if(LoadKnownPollingProfile(self)) {
+      Serial.println("Appliance model changed, polling " + String(self->pollingListCount) + " erds from stored profile");
+    }
+    else {
+      // Same family, so most of the list still applies: drop what no longer answers and let
+      // background probing find what is new.
+      Serial.println("Appliance model changed, verifying existing polling list");
+      memset(self->erd_poll_failures, 0, sizeof(self->erd_poll_failures));
+      self->profileVerifyCycles = profile_verify_cycles;
+      self->pollingListChanged = true;
+    }
+  }
+  tiny_hsm_transition(&self->hsm, State_PollErdsFromList);
+}
+
+static tiny_hsm_result_t State_RecoverAppliance(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data)
+{
+  self_t* self = container_of(self_t, hsm, hsm);
+  auto args = reinterpret_cast<const tiny_gea2_erd_client_on_activity_args_t*>(data);
+  char buffer[80];
+
+  switch(signal) {
+    case tiny_hsm_signal_entry:
+      self->recoveryAttempts = 0;
+      __attribute__((fallthrough));
+
+    case signal_timer_expired:
+      if(++self->recoveryAttempts > max_recovery_attempts) {
+        Serial.println("Appliance not found at known address, identifying again");
+        ClearNVStorage(self);
+        tiny_hsm_transition(hsm, State_IdentifyAppliance);
+        break;
+      }
+      sprintf(buffer, "Checking appliance type ERD 0x0008 at address 0x%02X\n", self->erd_host_address);
+      Serial.print(buffer);
+      tiny_gea2_erd_client_read(self->erd_client, &self->request_id, self->erd_host_address, 0x0008);
+      arm_timer(self, retry_delay);
+      break;
+
+    case signal_read_completed:
+      if(args->read_completed.erd == 0x0008) {
+        uint8_t applianceType = *reinterpret_cast<const uint8_t*>(args->read_completed.data);
+        if(applianceType != self->appliance_type) {
+          sprintf(buffer, "Appliance type changed to 0x%02X\n", applianceType);
+          Serial.print(buffer);
+          ClearNVStorage(self);
+          self->appliance_type = applianceType;
+          tiny_hsm_transition(hsm, State_IdentifyModel);
+          break;
+        }
+        tiny_gea2_erd_client_read(self->erd_client, &self->request_id, self->erd_host_address, 0x0001);
+        arm_timer(self, retry_delay);
+      }
+      else if(args->read_completed.erd == 0x0001) {
+        DisarmRetryTimer(self);
+        ResumeRecoveredAppliance(
+          self,
+          polling_profile_key(self->appliance_type, args->read_completed.data, args->read_completed.data_size));
+      }
+      break;
+
+    case tiny_hsm_signal_exit:
+      DisarmRetryTimer(self);
+      break;
+
+    default:
+      return tiny_hsm_result_signal_deferred;
+  }
+
+  return tiny_hsm_result_signal_consumed;
+}
+
+// The first node uses the absent candidate record; the others are only asked for candidates
+// that no earlier node has answered.
+static bool NextDiscoveryCandidate(self_t* self)
+{
+  while(true) {
+    if(self->discoveryNode == 0) {
+      if(NextCandidateToProbe(self, &self->candidateIterator, &self->candidateErd)) {
+        return true;
+      }
+    }
+    else {
+      while(ErdRangeIteratorNext(&self->candidateIterator, &self->candidateErd)) {
+        if(!PollingListContains(self, self->candidateErd)) {
+          return true;
+        }
+      }
+    }
+
+    if(++self->discoveryNode >= self->nodeCount) {
+      return false;
+    }
+    ErdRangeIteratorInit(&self->candidateIterator, GetApplianceErdList(self->appliance_type));
+    self->discoveryCheckpoint = 0;
+    Serial.println("Looking for appliance erds on node " + String(self->node_addresses[self->discoveryNode], HEX));
+  }
+}
+
+static bool SendCandidateReadRequest(self_t* self)
+{
+  bool more_erds_to_try = NextDiscoveryCandidate(self);
+  if(more_erds_to_try) {
+    gea2_erd_batch_reader_read(self->probe_reader, self->node_addresses[self->discoveryNode], &self->candidateErd, nullptr, 1);
+  }
+  return more_erds_to_try;
+}
+
+static bool SendNextReadRequest(self_t* self)
+{
+  if(self->candidateIterator.position - self->discoveryCheckpoint >= discovery_checkpoint_interval) {
+    SaveDiscoveryCheckpoint(self);
+    SaveAbsentErds(self);
+  }
+  return SendCandidateReadRequest(self);
+}
+
+static void AddErdToPollingList(self_t* self, tiny_erd_t erd, uint8_t address, const void* data, uint8_t size)
+{
+  if((self->pollingListCount >= POLLING_LIST_MAX_SIZE) || PollingListContains(self, erd)) {
+    return;
+  }
+
+  // The size of a single answer is not trusted until a poll confirms it
+  uint16_t index = self->pollingListCount;
+  self->erd_polling_list[index] = erd;
+  self->erd_size_list[index] = 0;
+  self->erd_size_candidate[index] = size;
+  self->erd_size_votes[index] = 1;
+  self->erd_address_list[index] = address;
+  self->erd_poll_failures[index] = 0;
+  ClearBit(self->erd_heard, index);
+  ClearBit(self->erd_subscribed, index);
+  ClearBit(self->erd_push_rejected, index);
+  ClearBit(self->erd_registered, index);
+  RegisterErd(self, index);
+  NewErdValueSlot(self, index);
+  StoreErdValue(self, index, data, size);
+  self->pollingListCount++;
+
+  char buffer[60];
+  sprintf(buffer, "#%d Add ERD erd %04X from 0x%02X to polling list\n", self->pollingListCount, erd, address);
+  Serial.print(buffer);
+}
+
+// Discovery and polling of the ERDs found so far take turns on the bus. Every candidate probed
+// earns the configured share in credit, and a poll batch is sent each time the credit covers
+// the share left for probing, so a 50% share alternates one probe with one poll batch. No credit
+// is earned while there is nothing to poll, so it stays below 100 and is not saved up for later.
+static bool InterleavedPollDue(self_t* self)
+{
+  uint8_t probeShare = 100 - self->discoveryPollShare;
+  if((self->discoveryPollShare == 0) || (self->pollingListCount == 0) || (self->discoveryPollCredit < probeShare)) {
+    return false;
+  }
+  self->discoveryPollCredit -= probeShare;
+  return true;
+}
+
+static bool SendInterleavedPollRequest(self_t* self)
+{
+  if(SelectNextPollBatch(self) == poll_batch_none_due) {
+    return false;
+  }
+  gea2_erd_batch_reader_read(
+    self->batch_reader,
+    self->erd_address_list[self->erd_index],
+    &self->erd_polling_list[self->erd_index],
+    &self->erd_size_list[self->erd_index],
+    self->batch_count);
+  return true;
+}
+
+static void FinishDiscovery(self_t* self);
+
+static void ContinueDiscovery(self_t* self)
+{
+  if(InterleavedPollDue(self) && SendInterleavedPollRequest(self)) {
+    return;
+  }
+  if(!SendNextReadRequest(self)) {
+    FinishDiscovery(self);
+  }
+}
+
+static void CandidateProbed(self_t* self)
+{
+  if(self->pollingListCount > 0) {
+    self->discoveryPollCredit += self->discoveryPollShare;
+  }
+  ContinueDiscovery(self);
+}
+
+static void FinishDiscovery(self_t* self)
+{
+  SaveAbsentErds(self);
+  self->profileVerifyCycles = 0;
+  self->pollingListChanged = false;
+  SaveKnownPollingProfile(self);
+  tiny_hsm_transition(&self->hsm, State_PollErdsFromList);
+}
+
+static tiny_hsm_result_t State_AddApplianceErds(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data)
+{
+  self_t* self = container_of(self_t, hsm, hsm);
+  auto args = reinterpret_cast<const gea2_erd_batch_reader_on_activity_args_t*>(data);
+  switch(signal) {
+    case tiny_hsm_signal_entry: {
+      const erd_range_list_t* applianceErds = GetApplianceErdList(self->appliance_type);
+      ErdRangeIteratorInit(&self->candidateIterator, applianceErds);
+      Serial.println();
+      if(self->discoveryCheckpoint > 0) {
+        Serial.println("Resuming looking for " + String(applianceErds->erdCount) + " appliance erds at " + String(self->discoveryCheckpoint));
+        tiny_erd_t skipped;
+        while((self->candidateIterator.position < self->discoveryCheckpoint) &&
+          ErdRangeIteratorNext(&self->candidateIterator, &skipped)) {
+        }
+        for(uint16_t i = 0; i < self->pollingListCount; i++) {
+          RegisterErd(self, i);
+        }
+      }
+      else {
+        Serial.println("Starting looking for " + String(applianceErds->erdCount) + " appliance erds");
+        self->pollingListCount = 0;
+        self->erdValueArenaUsed = 0;
+        // Whatever checkpoint is in the store is from an earlier discovery, so the first one is written in full
+        self->discoveryCheckpointErds = UINT16_MAX;
+      }
+      LoadAbsentErds(self);
+      ResetPollNodes(self);
+      self->batch_fallback_count = 0;
+      self->batch_failures = 0;
+      self->batching_supported = true;
+      self->discoveryPollCredit = 0;
+      self->pollCycle = 0;
+      self->profileVerifyCycles = 0;
+
+      if(!SendCandidateReadRequest(self)) {
+        FinishDiscovery(self);
+      }
+    } break;
+
+    case signal_probe_unanswered:
+      if(self->discoveryNode == 0) {
+        RecordCandidateAnswer(self, self->candidateIterator.index, false);
+      }
+      CandidateProbed(self);
+      break;
+
+    case signal_probe_answered:
+      if(args->read_completed.erd != self->candidateErd) {
+        break;
+      }
+      if(self->discoveryNode == 0) {
+        RecordCandidateAnswer(self, self->candidateIterator.index, true);
+      }
+      AddErdToPollingList(self, args->read_completed.erd, args->address, args->read_completed.data, args->read_completed.data_size);
       mqtt_client_update_erd(
         self->mqtt_client,
         args->read_completed.erd,
         args->read_completed.data,
         args->read_completed.data_size);
+      CandidateProbed(self);
+      break;
+
+    case signal_batch_read_completed:
+      StorePolledErdValue(self, reinterpret_cast<const gea2_erd_batch_reader_on_activity_args_t*>(data));
+      break;
+
+    case signal_batch_completed: {
+      auto batch = reinterpret_cast<const gea2_erd_batch_reader_on_activity_args_t*>(data);
+      PollBatchFinished(self, batch->batch_completed.erd_count, batch->batch_completed.erds_read);
+      ContinueDiscovery(self);
+    } break;
+
+    case signal_batch_failed: {
+      auto batch = reinterpret_cast<const gea2_erd_batch_reader_on_activity_args_t*>(data);
+      PollBatchFinished(self, batch->batch_failed.erd_count, 0);
+      ContinueDiscovery(self);
+    } break;
+
+    case tiny_hsm_signal_exit:
+      gea2_erd_batch_reader_cancel(self->batch_reader);
+      gea2_erd_batch_reader_cancel(self->probe_reader);
+      self->discoveryCheckpoint = 0;
+      break;
+
+    default:
+      return tiny_hsm_result_signal_deferred;
+  }
+
+  return tiny_hsm_result_signal_consumed;
+}
+
+// Candidates that are not on the polling list are re-probed a few per poll cycle, so ERDs
+// added by an appliance firmware update are picked up without stopping the poll loop.
+static void SendNextBackgroundProbe(self_t* self)
+{
+  if((self->probesThisCycle == 0) || gea2_erd_batch_reader_busy(self->probe_reader)) {
+    return;
+  }
+
+  while(NextCandidateToProbe(self, &self->probeIterator, &self->probeErd)) {
+    if(!PollingListContains(self, self->probeErd)) {
+      gea2_erd_batch_reader_read(self->probe_reader, self->erd_host_address, &self->probeErd, nullptr, 1);
+      return;
+    }
+  }
+
+  ErdRangeIteratorInit(&self->probeIterator, GetApplianceErdList(self->appliance_type));
+  self->probesThisCycle = 0;
+  AgeAbsentErds(self);
+  SaveAbsentErds(self);
+}
+
+static void BackgroundProbeFinished(self_t* self, bool answered)
+{
+  RecordCandidateAnswer(self, self->probeIterator.index, answered);
+  if(self->probesThisCycle > 0) {
+    self->probesThisCycle--;
+  }
+  SendNextBackgroundProbe(self);
+}
+
+static uint8_t PlanPollBatch(self_t* self)
+{
+  if(self->batch_fallback_count > 0) {
+    self->batch_fallback_count--;
+    return 1;
+  }
 
-      if(!SendNextReadRequest(self)) {
-        tiny_hsm_transition(hsm, State_AddApplianceErds);
+  if(!self->batching_supported) {
+    return 1;
+  }
+
+  uint16_t capacity = gea2_erd_batch_reader_response_capacity(self->batch_reader);
+  uint16_t used = 0;
+  uint8_t count = 0;
+  uint8_t address = self->erd_address_list[self->erd_index];
+  while((count < GEA2_ERD_BATCH_READER_MAX_ERDS) &&
+    (self->erd_index + count < self->pollingListCount) &&
+    (self->erd_address_list[self->erd_index + count] == address) &&
+    ((count == 0) || !ErdPollDeferred(self, self->erd_index + count))) {
+    uint8_t size = self->erd_size_list[self->erd_index + count];
+    if(size == 0) {
+      if(count >= max_erds_per_unsized_batch) {
+        break;
       }
+      size = assumed_erd_size;
+    }
+    if(used + GEA2_ERD_BATCH_READER_ERD_OVERHEAD + size > capacity) {
       break;
+    }
+    used += GEA2_ERD_BATCH_READER_ERD_OVERHEAD + size;
+    count++;
+  }
+  return (count > 0) ? count : 1;
+}
 
-    default:
-      return tiny_hsm_result_signal_deferred;
+static void ResetPollNodes(self_t* self)
+{
+  memset(self->node_poll_index, 0, sizeof(self->node_poll_index));
+  self->pollNode = self->nodeCount - 1;
+  self->erd_index = 0;
+  self->batch_count = 0;
+}
+
+// The nodes to poll are the host followed by every other address on the polling list
+static void RebuildPollNodes(self_t* self)
+{
+  self->node_addresses[0] = self->erd_host_address;
+  self->nodeCount = 1;
+  for(uint16_t i = 0; i < self->pollingListCount; i++) {
+    uint8_t address = self->erd_address_list[i];
+    bool known = false;
+    for(uint8_t node = 0; node < self->nodeCount; node++) {
+      known = known || (self->node_addresses[node] == address);
+    }
+    if(!known && (self->nodeCount < GEA2_NODE_SCANNER_MAX_NODES)) {
+      self->node_addresses[self->nodeCount++] = address;
+    }
   }
+  ResetPollNodes(self);
+}
 
-  return tiny_hsm_result_signal_consumed;
+static int16_t NextErdOnNode(self_t* self, uint8_t address, uint16_t from)
+{
+  for(uint16_t i = from; i < self->pollingListCount; i++) {
+    if((self->erd_address_list[i] == address) && !ErdPollDeferred(self, i)) {
+      return i;
+    }
+  }
+  return -1;
 }
 
-static tiny_hsm_result_t State_AddApplianceErds(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data)
+static bool FindNextPollBatch(self_t* self, bool* wrapped)
 {
-  self_t* self = container_of(self_t, hsm, hsm);
-  auto args = reinterpret_cast<const tiny_gea2_erd_client_on_activity_args_t*>(data);
-  switch(signal) {
-    case tiny_hsm_signal_entry: {
-      const tiny_erd_list_t* applianceErds = GetApplianceErdList(self->appliance_type);
-      self->applianceErdList = applianceErds->erdList;
-      self->applianceErdListCount = applianceErds->erdCount;
-      Serial.println();
-      Serial.println("Starting looking for " + String(self->applianceErdListCount) + " appliance erds");
-      self->erd_index = 0;
+  for(uint8_t tries = 0; tries < self->nodeCount; tries++) {
+    uint8_t address = self->node_addresses[self->pollNode];
+    int16_t index = NextErdOnNode(self, address, self->node_poll_index[self->pollNode]);
+    if(index < 0) {
+      *wrapped = *wrapped || (self->pollNode == 0);
+      index = NextErdOnNode(self, address, 0);
+    }
+    if(index >= 0) {
+      self->erd_index = index;
+      self->batch_count = PlanPollBatch(self);
+      return true;
+    }
+    self->pollNode = (self->pollNode + 1) % self->nodeCount;
+  }
+  return false;
+}
 
-      tiny_gea2_erd_client_read(self->erd_client, &self->request_id, self->erd_host_address, self->applianceErdList[self->erd_index]);
-      arm_timer(self, retry_delay);
-    } break;
+// Nodes take turns batch by batch, each keeping its own place in the polling list, so every
+// board gets the same number of requests however many ERDs it has. A node that is reading a
+// failed batch one ERD at a time keeps its turn until that is done. Tells whether the batch
+// starts a new cycle, because the first node has wrapped round to the start of the list, or
+// whether nothing is due because every ERD on the list has been heard recently.
+static uint8_t SelectNextPollBatch(self_t* self)
+{
+  bool wrapped = false;
 
-    case signal_timer_expired:
-      if(!SendNextReadRequest(self)) {
-        tiny_hsm_transition(hsm, State_PollErdsFromList);
-      }
-      break;
+  self->node_poll_index[self->pollNode] = self->erd_index + self->batch_count;
+  if(self->refreshRequested) {
+    self->refreshRequested = false;
+    for(uint8_t node = 0; node < self->nodeCount; node++) {
+      self->node_poll_index[node] = self->pollingListCount;
+    }
+    self->pollNode = self->nodeCount - 1;
+    self->batch_fallback_count = 0;
+  }
+  if(self->batch_fallback_count == 0) {
+    self->pollNode = (self->pollNode + 1) % self->nodeCount;
+  }
 
-    case signal_read_completed:
-      DisarmRetryTimer(self);
-      AddErdToPollingList(self, args->read_completed.erd);
-      mqtt_client_update_erd(
-        self->mqtt_client,
-        args->read_completed.erd,
-        args->read_completed.data,
-        args->read_completed.data_size);
+  self->deferLowPriority = true;
+  bool found = FindNextPollBatch(self, &wrapped);
+  if(!found) {
+    self->deferLowPriority = false;
+    found = FindNextPollBatch(self, &wrapped);
+    self->deferLowPriority = true;
+  }
+  if(!found) {
+    // Leave the places on the list as they are, so the next selection starts from them again
+    self->erd_index = self->node_poll_index[self->pollNode];
+    self->batch_count = 0;
+    return poll_batch_none_due;
+  }
+  return wrapped ? poll_batch_starts_cycle : poll_batch_selected;
+}
 
-      if(!SendNextReadRequest(self)) {
-        tiny_hsm_transition(hsm, State_PollErdsFromList);
+// Ticks until the first ERD that has been heard recently needs polling again
+static tiny_timer_ticks_t TicksUntilPollDue(self_t* self)
+{
+  uint16_t seconds = GEA2_MQTT_BRIDGE_SUBSCRIBED_VERIFY_PERIOD;
+  for(uint16_t i = 0; i < self->pollingListCount; i++) {
+    if(ErdHeardRecently(self, i)) {
+      uint16_t freshness = BitIsSet(self->erd_subscribed, i) ? GEA2_MQTT_BRIDGE_SUBSCRIBED_VERIFY_PERIOD : GEA2_MQTT_BRIDGE_PASSIVE_FRESHNESS;
+      uint16_t remaining = freshness - (uint16_t)(self->uptime - self->erd_heard_at[i]);
+      if(remaining < seconds) {
+        seconds = remaining;
       }
-      break;
+    }
+  }
+  return (tiny_timer_ticks_t)seconds * ticks_per_second;
+}
 
-    default:
-      return tiny_hsm_result_signal_deferred;
+static void SendSelectedPollBatch(self_t* self)
+{
+  gea2_erd_batch_reader_read(
+    self->batch_reader,
+    self->erd_address_list[self->erd_index],
+    &self->erd_polling_list[self->erd_index],
+    &self->erd_size_list[self->erd_index],
+    self->batch_count);
+  Serial.print(".");
+}
+
+static bool PollCycleDue(self_t* self)
+{
+  return (self->uptime - self->pollCycleStartedAt) >= PollCyclePeriod(self);
+}
+
+static void StartPollPauseTimer(self_t* self, tiny_timer_ticks_t ticks)
+{
+  tiny_timer_start(
+    self->timer_group, &self->pollPauseTimer, ticks, self, +[](void* context) {
+      tiny_hsm_send_signal(&reinterpret_cast<self_t*>(context)->hsm, signal_poll_pause_ended, nullptr);
+    });
+}
+
+// A poll cycle that would start before the period of the current rate is up waits, with its
+// first batch already selected. Meanwhile the state ERD is read every few seconds unless it is
+// being heard on the bus, so a change to a faster rate ends the wait at once.
+static void HoldPollCycle(self_t* self)
+{
+  self->pollCycleHeld = true;
+
+  int16_t index = ApplianceStateErdIndex(self);
+  if((index >= 0) && !ErdHeardRecently(self, index)) {
+    self->request_id++;
+    tiny_gea2_erd_client_read(self->erd_client, &self->request_id, self->erd_address_list[index], self->erd_polling_list[index]);
   }
 
-  return tiny_hsm_result_signal_consumed;
+  tiny_timer_ticks_t ticks = (PollCyclePeriod(self) - (self->uptime - self->pollCycleStartedAt)) * ticks_per_second;
+  if(ticks > appliance_state_check_period) {
+    ticks = appliance_state_check_period;
+  }
+  StartPollPauseTimer(self, ticks);
+}
+
+static void ReleasePollCycle(self_t* self)
+{
+  tiny_timer_stop(self->timer_group, &self->pollPauseTimer);
+  self->pollCycleHeld = false;
+  self->pollPauseOwed = 0;
+  self->pollCycleStartedAt = self->uptime;
+  SendSelectedPollBatch(self);
+}
+
+static void PollRateChanged(self_t* self)
+{
+  Serial.println(String("Poll rate ") + ((CurrentPollRate(self) == poll_rate_idle) ? "idle" : "active"));
+  PublishPollRate(self);
+  if(self->pollCycleHeld && PollCycleDue(self)) {
+    ReleasePollCycle(self);
+  }
+}
+
+static bool StoreApplianceStateRead(self_t* self, const tiny_gea2_erd_client_on_activity_args_t* args)
+{
+  int16_t index = ApplianceStateErdIndex(self);
+  if((index < 0) ||
+    (args->read_completed.erd != self->erd_polling_list[index]) ||
+    (args->address != self->erd_address_list[index])) {
+    return false;
+  }
+
+  DisarmLostApplianceTimer(self);
+  ResetLostApplianceTimer(self);
+  if((args->read_completed.data_size == self->erd_size_list[index]) &&
+    StoreErdValue(self, index, args->read_completed.data, args->read_completed.data_size)) {
+    mqtt_client_update_erd(self->mqtt_client, args->read_completed.erd, args->read_completed.data, args->read_completed.data_size);
+    WatchApplianceState(self, index, args->read_completed.data, args->read_completed.data_size);
+  }
+  return true;
 }
 
 static void SendNextPollReadRequest(self_t* self)
 {
-  self->erd_index++;
-  if(self->erd_index >= self->pollingListCount) {
-    self->erd_index = 0;
+  uint8_t selected = SelectNextPollBatch(self);
+  if(selected == poll_batch_none_due) {
+    self->pollPauseOwed = 0;
+    StartPollPauseTimer(self, TicksUntilPollDue(self));
+    return;
+  }
+  if(selected == poll_batch_starts_cycle) {
+    self->pollCycle++;
+    if(self->profileVerifyCycles > 0) {
+      self->profileVerifyCycles--;
+    }
+    // Sizes are learned over several cycles, so the list is only saved once a whole cycle has
+    // gone by without learning another
+    if(self->erdSizesLearned) {
+      self->erdSizesLearned = false;
+      self->erdSizesUnsaved = true;
+    }
+    else if(self->erdSizesUnsaved || (self->pollingListChanged && (self->profileVerifyCycles == 0))) {
+      self->erdSizesUnsaved = false;
+      SavePollingListToNVStore(self);
+      PublishPollingProfile(self);
+    }
+    if(self->pollingListChanged && (self->profileVerifyCycles == 0)) {
+      self->pollingListChanged = false;
+      SaveKnownPollingProfile(self);
+    }
+    // The duty cycle only throttled the last cycle if its pauses made it run past the period
+    self->pollThrottled = self->pollPausedThisCycle && PollCycleDue(self);
+    self->pollPausedThisCycle = false;
+    self->probesThisCycle = background_probes_per_cycle;
+    SendNextBackgroundProbe(self);
+    SubscribeNextErds(self);
+    if(!PollCycleDue(self)) {
+      HoldPollCycle(self);
+      return;
+    }
+    self->pollCycleStartedAt = self->uptime;
+  }
+  SendSelectedPollBatch(self);
+}
+
+// Each poll batch is followed by a pause long enough that the bus time of everything the bridge
+// sent since the last batch, the batch included, is the configured share of the time from one
+// batch to the next. Pauses shorter than a tick are carried over to the next batch.
+static void SendNextPollReadRequestWhenDue(self_t* self)
+{
+  tiny_timer_ticks_t pause = self->pollPauseOwed / microseconds_per_tick;
+  if(pause == 0) {
+    SendNextPollReadRequest(self);
+    return;
+  }
+
+  self->pollPauseOwed -= pause * microseconds_per_tick;
+  self->pollPausedThisCycle = true;
+  StartPollPauseTimer(self, pause);
+}
+
+static int16_t PollingListIndexInBatch(self_t* self, tiny_erd_t erd)
+{
+  for(uint16_t i = self->erd_index; i < self->erd_index + self->batch_count; i++) {
+    if(self->erd_polling_list[i] == erd) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// A size is only learned once it has been seen in consecutive responses, twice for an ERD whose
+// size is not known yet and three times to replace a known size, so one short or corrupt
+// response cannot teach the bridge a wrong size. Values of an ERD whose size is not known are
+// published without being cached; responses that do not match a known size are dropped.
+static bool ErdSizeIsExpected(self_t* self, int16_t index, tiny_erd_t erd, uint8_t size)
+{
+  uint8_t expected = self->erd_size_list[index];
+  if(expected == size) {
+    self->erd_size_votes[index] = 0;
+    return true;
+  }
+
+  if((self->erd_size_votes[index] > 0) && (self->erd_size_candidate[index] == size)) {
+    self->erd_size_votes[index]++;
+  }
+  else {
+    self->erd_size_candidate[index] = size;
+    self->erd_size_votes[index] = 1;
+  }
+
+  char buffer[80];
+  if(self->erd_size_votes[index] >= ((expected == 0) ? new_size_confirmations : changed_size_confirmations)) {
+    if(expected != 0) {
+      sprintf(buffer, "Size of ERD %04X changed from %d to %d bytes\n", erd, expected, size);
+      Serial.print(buffer);
+    }
+    self->erd_size_list[index] = size;
+    self->erd_size_votes[index] = 0;
+    self->erdSizesLearned = true;
+    AssignErdValueSlot(self, index);
+    return true;
+  }
+
+  if(expected == 0) {
+    return true;
+  }
+
+  sprintf(buffer, "Dropped ERD %04X with %d bytes, expected %d\n", erd, size, expected);
+  Serial.print(buffer);
+  return false;
+}
+
+static void StorePolledErdValue(self_t* self, const gea2_erd_batch_reader_on_activity_args_t* args)
+{
+  self->lastErdPolledSuccessfully = args->read_completed.erd;
+
+  int16_t index = PollingListIndexInBatch(self, args->read_completed.erd);
+  if(index < 0) {
+    return;
+  }
+  if(!ErdSizeIsExpected(self, index, args->read_completed.erd, args->read_completed.data_size)) {
+    return;
+  }
+
+  bool wasCached = BitIsSet(self->erd_value_cached, index);
+  bool changed = StoreErdValue(self, index, args->read_completed.data, args->read_completed.data_size);
+  if(changed) {
+    mqtt_client_update_erd(
+      self->mqtt_client,
+      args->read_completed.erd,
+      args->read_completed.data,
+      args->read_completed.data_size);
+    WatchApplianceState(self, index, args->read_completed.data, args->read_completed.data_size);
+  }
+
+  // A verification poll that finds a new value means a publication was missed, most likely
+  // because the appliance has dropped the subscription
+  if(BitIsSet(self->erd_subscribed, index)) {
+    SetBit(self->erd_heard, index);
+    self->erd_heard_at[index] = self->uptime;
+    if(changed && wasCached) {
+      char buffer[60];
+      sprintf(buffer, "Missed publication of ERD %04X, subscribing again\n", args->read_completed.erd);
+      Serial.print(buffer);
+      ClearBit(self->erd_subscribed, index);
+    }
+  }
+}
+
+static void RemoveErdFromPollingList(self_t* self, uint16_t index)
+{
+  char buffer[60];
+  sprintf(buffer, "Removing ERD %04X from polling list\n", self->erd_polling_list[index]);
+  Serial.print(buffer);
+
+  FreeErdValueSlot(self, index);
+  for(uint16_t i = index; i + 1 < self->pollingListCount; i++) {
+    self->erd_polling_list[i] = self->erd_polling_list[i + 1];
+    self->erd_size_list[i] = self->erd_size_list[i + 1];
+    self->erd_size_candidate[i] = self->erd_size_candidate[i + 1];
+    self->erd_size_votes[i] = self->erd_size_votes[i + 1];
+    self->erd_address_list[i] = self->erd_address_list[i + 1];
+    self->erd_poll_failures[i] = self->erd_poll_failures[i + 1];
+    self->erd_heard_at[i] = self->erd_heard_at[i + 1];
+    self->erd_value_offset[i] = self->erd_value_offset[i + 1];
+    self->erd_value_slot_size[i] = self->erd_value_slot_size[i + 1];
+    CopyBit(self->erd_value_cached, i, i + 1);
+    CopyBit(self->erd_registered, i, i + 1);
+    CopyBit(self->erd_heard, i, i + 1);
+    CopyBit(self->erd_subscribed, i, i + 1);
+    CopyBit(self->erd_push_rejected, i, i + 1);
+  }
+  self->pollingListCount--;
+
+  // The caller moves on from the ERD of the node being polled; every other node keeps its place
+  for(uint8_t node = 0; node < self->nodeCount; node++) {
+    if(self->node_poll_index[node] > index) {
+      self->node_poll_index[node]--;
+    }
+  }
+  self->pollingListChanged = true;
+}
+
+// While a stored profile is being verified, an ERD that fails single reads repeatedly is dropped.
+static void VerifyProfileErd(self_t* self, uint8_t erd_count, uint8_t erds_read)
+{
+  if((self->profileVerifyCycles == 0) || (erd_count != 1) || (erds_read == 1)) {
+    return;
+  }
+
+  if(++self->erd_poll_failures[self->erd_index] >= max_profile_erd_failures) {
+    RemoveErdFromPollingList(self, self->erd_index);
+    self->batch_count = 0;
+  }
+}
+
+static void PollBatchFinished(self_t* self, uint8_t erd_count, uint8_t erds_read)
+{
+  VerifyProfileErd(self, erd_count, erds_read);
+
+  if(erd_count > 1) {
+    if(erds_read == erd_count) {
+      self->batch_failures = 0;
+    }
+    else {
+      self->batch_fallback_count = erd_count;
+      self->batch_count = 0;
+
+      if(++self->batch_failures >= max_batch_failures) {
+        self->batching_supported = false;
+        Serial.println("Batched reads not supported, falling back to single reads");
+      }
+    }
   }
-  self->request_id++;
-  tiny_gea2_erd_client_read(self->erd_client, &self->request_id, self->erd_host_address, self->erd_polling_list[self->erd_index]);
-  arm_timer(self, retry_delay);
-  Serial.print(".");
 }
 
 static tiny_hsm_result_t State_PollErdsFromList(tiny_hsm_t* hsm, tiny_hsm_signal_t signal, const void* data)
 {
   self_t* self = container_of(self_t, hsm, hsm);
-  auto args = reinterpret_cast<const tiny_gea2_erd_client_on_activity_args_t*>(data);
+  auto args = reinterpret_cast<const gea2_erd_batch_reader_on_activity_args_t*>(data);
 
   switch(signal) {
     case tiny_hsm_signal_entry:
       DisarmLostApplianceTimer(self);
       ResetLostApplianceTimer(self);
       SavePollingListToNVStore(self);
+      RepublishErdValues(self);
+      PublishPollingProfile(self);
       Serial.println("Polling " + String(self->pollingListCount) + " erds");
-      __attribute__((fallthrough));
-
-    case signal_timer_expired: {
-      Serial.print("X");
+      memset(self->erd_heard, 0, sizeof(self->erd_heard));
+      memset(self->erd_subscribed, 0, sizeof(self->erd_subscribed));
+      memset(self->erd_push_rejected, 0, sizeof(self->erd_push_rejected));
+      self->subscribeIndex = 0;
+      self->subscribeAfter = 0;
+      RebuildPollNodes(self);
+      self->batch_fallback_count = 0;
+      self->batch_failures = 0;
+      self->batching_supported = true;
+      self->erdSizesLearned = false;
+      self->erdSizesUnsaved = false;
+      self->refreshRequested = false;
+      self->pollCycle = 0;
+      self->pollPauseOwed = 0;
+      self->pollThrottled = false;
+      self->pollPausedThisCycle = false;
+      self->detectedPollRate = poll_rate_active;
+      self->pollCycleHeld = false;
+      self->pollCycleStartedAt = self->uptime;
+      PublishPollRate(self);
+      ErdRangeIteratorInit(&self->probeIterator, GetApplianceErdList(self->appliance_type));
+      self->probesThisCycle = 0;
+      LoadAbsentErds(self);
       SendNextPollReadRequest(self);
-    } break;
+      ProbePushSupport(self);
+      SubscribeNextErds(self);
+      break;
 
-    case signal_read_completed:
-      DisarmRetryTimer(self);
+    case signal_batch_read_completed:
       DisarmLostApplianceTimer(self);
       ResetLostApplianceTimer(self);
-      mqtt_client_update_erd(
-        self->mqtt_client,
-        args->read_completed.erd,
-        args->read_completed.data,
-        args->read_completed.data_size);
+      StorePolledErdValue(self, args);
+      break;
 
-      self->lastErdPolledSuccessfully = args->read_completed.erd;
-      SendNextPollReadRequest(self);
+    case signal_batch_completed:
+      PollBatchFinished(self, args->batch_completed.erd_count, args->batch_completed.erds_read);
+      SendNextPollReadRequestWhenDue(self);
       break;
 
-    case signal_mqtt_disconnected:
-      if(ValidPollingListLoaded(self)) {
-        Serial.println("Start HSM with previously discovered appliance");
-        tiny_hsm_transition(&self->hsm, State_PollErdsFromList);
+    case signal_batch_failed:
+      Serial.print("X");
+      PollBatchFinished(self, args->batch_failed.erd_count, 0);
+      SendNextPollReadRequestWhenDue(self);
+      break;
+
+    case signal_poll_pause_ended:
+      if(!self->pollCycleHeld) {
+        SendNextPollReadRequest(self);
+      }
+      else if(PollCycleDue(self)) {
+        ReleasePollCycle(self);
       }
       else {
-        Serial.println("Start HSM and identify new appliance");
-        tiny_hsm_transition(&self->hsm, State_IdentifyAppliance);
+        HoldPollCycle(self);
+      }
+      break;
+
+    case signal_mqtt_disconnected:
+      Serial.println("Republishing " + String(self->pollingListCount) + " cached erds");
+      RepublishErdValues(self);
+      PublishPollingProfile(self);
+      PublishPollRate(self);
+      break;
+
+    case signal_profile_imported:
+      InstallImportedProfile(self);
+      mqtt_client_update_erd_write_result(
+        self->mqtt_client, reinterpret_cast<const mqtt_client_on_write_request_args_t*>(data)->erd, true, 0);
+      tiny_hsm_transition(hsm, State_PollErdsFromList);
+      break;
+
+    case signal_erd_heard:
+      DisarmLostApplianceTimer(self);
+      ResetLostApplianceTimer(self);
+      return tiny_hsm_result_signal_deferred;
+
+    case signal_subscriber_activity: {
+      auto activity = reinterpret_cast<const gea2_erd_subscriber_on_activity_args_t*>(data);
+      SubscriberActivity(self, activity);
+      if((activity->type == gea2_erd_subscriber_activity_type_request_completed) ||
+        (activity->type == gea2_erd_subscriber_activity_type_request_failed)) {
+        SubscribeNextErds(self);
       }
+    } break;
+
+    case signal_read_completed:
+      StoreApplianceStateRead(self, reinterpret_cast<const tiny_gea2_erd_client_on_activity_args_t*>(data));
+      break;
+
+    case signal_probe_answered: {
+      auto probe = reinterpret_cast<const gea2_erd_batch_reader_on_activity_args_t*>(data);
+      if(probe->read_completed.erd != self->probeErd) {
+        break;
+      }
+      if(!PollingListContains(self, self->probeErd) && (self->pollingListCount < POLLING_LIST_MAX_SIZE)) {
+        AddErdToPollingList(self, probe->read_completed.erd, self->erd_host_address, probe->read_completed.data, probe->read_completed.data_size);
+        mqtt_client_update_erd(
+          self->mqtt_client,
+          probe->read_completed.erd,
+          probe->read_completed.data,
+          probe->read_completed.data_size);
+        self->pollingListChanged = true;
+      }
+      BackgroundProbeFinished(self, true);
+    } break;
+
+    case signal_probe_unanswered:
+      BackgroundProbeFinished(self, false);
       break;
 
     case tiny_hsm_signal_exit:
-      DisarmRetryTimer(self);
+      gea2_erd_batch_reader_cancel(self->batch_reader);
+      gea2_erd_batch_reader_cancel(self->probe_reader);
+      tiny_timer_stop(self->timer_group, &self->pollPauseTimer);
+      self->pollCycleHeld = false;
       break;
 
     default:
@@ -471,8 +2189,9 @@ static tiny_hsm_result_t State_PollErdsFromList(tiny_hsm_t* hsm, tiny_hsm_signal
 static const tiny_hsm_state_descriptor_t hsm_state_descriptors[] = {
   { .state = State_Top, .parent = nullptr },
   { .state = State_IdentifyAppliance, .parent = State_Top },
-  { .state = State_AddCommonErds, .parent = State_Top },
-  { .state = State_AddEnergyErds, .parent = State_Top },
+  { .state = State_IdentifyModel, .parent = State_Top },
+  { .state = State_RecoverAppliance, .parent = State_Top },
+  { .state = State_ScanNodes, .parent = State_Top },
   { .state = State_AddApplianceErds, .parent = State_Top },
   { .state = State_PollErdsFromList, .parent = State_Top }
 };
@@ -485,13 +2204,54 @@ void gea2_mqtt_bridge_init(
   self_t* self,
   tiny_timer_group_t* timer_group,
   i_tiny_gea2_erd_client_t* erd_client,
-  i_mqtt_client_t* mqtt_client)
+  Gea2ErdBatchReader_t* batch_reader,
+  Gea2ErdBatchReader_t* probe_reader,
+  Gea2NodeScanner_t* node_scanner,
+  Gea2BusSniffer_t* bus_sniffer,
+  Gea2ErdSubscriber_t* erd_subscriber,
+  i_mqtt_client_t* mqtt_client,
+  const char* storage_namespace)
 {
   Serial.println("Bridge init start");
   self->timer_group = timer_group;
   self->erd_client = erd_client;
+  self->batch_reader = batch_reader;
+  self->probe_reader = probe_reader;
+  self->node_scanner = node_scanner;
+  self->erd_subscriber = erd_subscriber;
+  self->pushSupport = push_support_unknown;
+  self->subscribeIndex = 0;
+  self->subscribeAfter = 0;
+  self->nodeCount = 1;
+  self->node_addresses[0] = tiny_gea_broadcast_address;
+  self->appliance_type = appliance_type_unknown;
+  self->model_key = 0;
+  self->profileVerifyCycles = 0;
+  self->pollingListChanged = false;
+  self->profileImportSize = 0;
+  self->probesThisCycle = 0;
+  self->discoveryCheckpoint = 0;
+  self->discoveryPollShare = GEA2_MQTT_BRIDGE_DISCOVERY_POLL_SHARE;
+  self->busDutyCycle = GEA2_MQTT_BRIDGE_BUS_DUTY_CYCLE;
+  self->pollCycle = 0;
+  self->deferLowPriority = true;
+  self->pollThrottled = false;
+  self->pollPausedThisCycle = false;
+  self->republishIndex = 0;
+  self->pollPauseOwed = 0;
+  self->busTimeUsed = 0;
+  self->detectedPollRate = poll_rate_active;
+  self->pollRateOverride = poll_rate_automatic;
+  self->poll_cycle_period[poll_rate_active] = poll_cycle_period_family_default;
+  self->poll_cycle_period[poll_rate_idle] = poll_cycle_period_family_default;
+  self->pollCycleHeld = false;
+  self->pollCycleStartedAt = 0;
   self->mqtt_client = mqtt_client;
-  self->erd_set = reinterpret_cast<void*>(new set<tiny_erd_t>());
+  self->storage_namespace = storage_namespace;
+  memset(self->erd_registered, 0, sizeof(self->erd_registered));
+  memset(self->erd_heard, 0, sizeof(self->erd_heard));
+  memset(self->erd_subscribed, 0, sizeof(self->erd_subscribed));
+  memset(self->erd_push_rejected, 0, sizeof(self->erd_push_rejected));
   startMqttInfoTimer(self);
 
   tiny_event_subscription_init(
@@ -499,26 +2259,108 @@ void gea2_mqtt_bridge_init(
       auto self = reinterpret_cast<self_t*>(context);
       auto args = reinterpret_cast<const tiny_gea2_erd_client_on_activity_args_t*>(_args);
 
+      // The client does not report its retries, so only the final attempt is charged
       switch(args->type) {
         case tiny_gea2_erd_client_activity_type_read_completed:
+          ChargeBusBytes(self, ExchangeBusBytes(erd_client_request_size, erd_client_value_header_size + args->read_completed.data_size));
           tiny_hsm_send_signal(&self->hsm, signal_read_completed, args);
           break;
 
         case tiny_gea2_erd_client_activity_type_read_failed:
+          ChargeBusBytes(self, erd_client_request_size + GEA2_ROUND_TRIP_ESTIMATOR_FRAME_OVERHEAD);
           tiny_hsm_send_signal(&self->hsm, signal_read_failed, args);
           break;
 
         case tiny_gea2_erd_client_activity_type_write_completed:
+          ChargeBusBytes(self, ExchangeBusBytes(erd_client_value_header_size + args->write_completed.data_size, erd_client_request_size));
           mqtt_client_update_erd_write_result(self->mqtt_client, args->write_completed.erd, true, 0);
           break;
 
         case tiny_gea2_erd_client_activity_type_write_failed:
+          ChargeBusBytes(self, erd_client_value_header_size + args->write_failed.data_size + GEA2_ROUND_TRIP_ESTIMATOR_FRAME_OVERHEAD);
           mqtt_client_update_erd_write_result(self->mqtt_client, args->write_failed.erd, false, args->write_failed.reason);
           break;
       }
     });
   tiny_event_subscribe(tiny_gea2_erd_client_on_activity(erd_client), &self->erd_client_activity_subscription);
 
+  tiny_event_subscription_init(
+    &self->batch_reader_activity_subscription, self, +[](void* context, const void* _args) {
+      auto self = reinterpret_cast<self_t*>(context);
+      auto args = reinterpret_cast<const gea2_erd_batch_reader_on_activity_args_t*>(_args);
+
+      switch(args->type) {
+        case gea2_erd_batch_reader_activity_type_read_completed:
+          tiny_hsm_send_signal(&self->hsm, signal_batch_read_completed, args);
+          break;
+
+        case gea2_erd_batch_reader_activity_type_batch_completed:
+          ChargeBusBytes(self, args->batch_completed.bus_bytes);
+          tiny_hsm_send_signal(&self->hsm, signal_batch_completed, args);
+          break;
+
+        case gea2_erd_batch_reader_activity_type_batch_failed:
+          ChargeBusBytes(self, args->batch_failed.bus_bytes);
+          tiny_hsm_send_signal(&self->hsm, signal_batch_failed, args);
+          break;
+      }
+    });
+  tiny_event_subscribe(gea2_erd_batch_reader_on_activity(batch_reader), &self->batch_reader_activity_subscription);
+
+  tiny_event_subscription_init(
+    &self->probe_reader_activity_subscription, self, +[](void* context, const void* _args) {
+      auto self = reinterpret_cast<self_t*>(context);
+      auto args = reinterpret_cast<const gea2_erd_batch_reader_on_activity_args_t*>(_args);
+
+      switch(args->type) {
+        case gea2_erd_batch_reader_activity_type_read_completed:
+          tiny_hsm_send_signal(&self->hsm, signal_probe_answered, args);
+          break;
+
+        case gea2_erd_batch_reader_activity_type_batch_completed:
+          ChargeBusBytes(self, args->batch_completed.bus_bytes);
+          break;
+
+        case gea2_erd_batch_reader_activity_type_batch_failed:
+          ChargeBusBytes(self, args->batch_failed.bus_bytes);
+          tiny_hsm_send_signal(&self->hsm, signal_probe_unanswered, args);
+          break;
+      }
+    });
+  tiny_event_subscribe(gea2_erd_batch_reader_on_activity(probe_reader), &self->probe_reader_activity_subscription);
+
+  tiny_event_subscription_init(
+    &self->node_scanner_activity_subscription, self, +[](void* context, const void* _args) {
+      auto self = reinterpret_cast<self_t*>(context);
+      auto args = reinterpret_cast<const gea2_node_scanner_on_activity_args_t*>(_args);
+
+      if(args->type == gea2_node_scanner_activity_type_scan_completed) {
+        tiny_hsm_send_signal(&self->hsm, signal_nodes_scanned, args);
+      }
+    });
+  tiny_event_subscribe(gea2_node_scanner_on_activity(node_scanner), &self->node_scanner_activity_subscription);
+
+  tiny_event_subscription_init(
+    &self->bus_sniffer_erd_subscription, self, +[](void* context, const void* args) {
+      auto self = reinterpret_cast<self_t*>(context);
+      tiny_hsm_send_signal(&self->hsm, signal_erd_heard, args);
+    });
+  tiny_event_subscribe(gea2_bus_sniffer_on_erd(bus_sniffer), &self->bus_sniffer_erd_subscription);
+
+  tiny_event_subscription_init(
+    &self->erd_subscriber_activity_subscription, self, +[](void* context, const void* _args) {
+      auto self = reinterpret_cast<self_t*>(context);
+      auto args = reinterpret_cast<const gea2_erd_subscriber_on_activity_args_t*>(_args);
+      if(args->type == gea2_erd_subscriber_activity_type_request_completed) {
+        ChargeBusBytes(self, args->request_completed.bus_bytes);
+      }
+      else if(args->type == gea2_erd_subscriber_activity_type_request_failed) {
+        ChargeBusBytes(self, args->request_failed.bus_bytes);
+      }
+      tiny_hsm_send_signal(&self->hsm, signal_subscriber_activity, args);
+    });
+  tiny_event_subscribe(gea2_erd_subscriber_on_activity(erd_subscriber), &self->erd_subscriber_activity_subscription);
+
   tiny_event_subscription_init(
     &self->mqtt_write_request_subscription, self, +[](void* context, const void* _args) {
       auto self = reinterpret_cast<self_t*>(context);
@@ -530,7 +2372,8 @@ void gea2_mqtt_bridge_init(
   tiny_event_subscription_init(
     &self->mqtt_disconnect_subscription, self, +[](void* context, const void*) {
       auto self = reinterpret_cast<self_t*>(context);
-      reinterpret_cast<set<tiny_erd_t>*>(self->erd_set)->clear();
+      memset(self->erd_registered, 0, sizeof(self->erd_registered));
+      RegisterCommandErds(self);
       tiny_hsm_send_signal(&self->hsm, signal_mqtt_disconnected, nullptr);
     });
   tiny_event_subscribe(mqtt_client_on_mqtt_disconnect(mqtt_client), &self->mqtt_disconnect_subscription);
@@ -539,6 +2382,10 @@ void gea2_mqtt_bridge_init(
     Serial.println("Start HSM with previously discovered appliance");
     tiny_hsm_init(&self->hsm, &hsm_configuration, State_PollErdsFromList);
   }
+  else if(DiscoveryCheckpointLoaded(self)) {
+    Serial.println("Start HSM and resume discovery");
+    tiny_hsm_init(&self->hsm, &hsm_configuration, State_AddApplianceErds);
+  }
   else {
     Serial.println("Start HSM and identify new appliance");
     tiny_hsm_init(&self->hsm, &hsm_configuration, State_IdentifyAppliance);
@@ -547,10 +2394,19 @@ void gea2_mqtt_bridge_init(
   Serial.println("Bridge init done");
 }
 
+void gea2_mqtt_bridge_erd_update_dropped(self_t* self, tiny_erd_t erd)
+{
+  for(uint16_t i = 0; i < self->pollingListCount; i++) {
+    if(self->erd_polling_list[i] == erd) {
+      ClearBit(self->erd_value_cached, i);
+    }
+  }
+}
+
 void gea2_mqtt_bridge_destroy(self_t* self)
 {
   Serial.println("Bridge destroy start");
   stopMqttInfoTimer(self);
-  delete reinterpret_cast<set<tiny_erd_t>*>(self->erd_set);
+  tiny_timer_stop(self->timer_group, &self->republishTimer);
   Serial.println("Bridge destroy done");
 }
@@ -6,44 +6,184 @@
 #ifndef Gea2MqttBridge_h
 #define Gea2MqttBridge_h
 
+#include "ApplianceErds.h"
+#include "Gea2BusSniffer.h"
+#include "Gea2ErdBatchReader.h"
+#include "Gea2ErdSubscriber.h"
+#include "Gea2NodeScanner.h"
+#include "PollingProfiles.h"
 #include "i_mqtt_client.h"
 #include "i_tiny_gea2_erd_client.h"
 #include "tiny_hsm.h"
 #include "tiny_timer.h"
 
 #define POLLING_LIST_MAX_SIZE 256
+
+// Percentage of requests during discovery spent re-polling ERDs already found, at most 90
+#ifndef GEA2_MQTT_BRIDGE_DISCOVERY_POLL_SHARE
+#define GEA2_MQTT_BRIDGE_DISCOVERY_POLL_SHARE 50
+#endif
+
+// Seconds an ERD value heard in traffic between other nodes stays fresh, during which the ERD
+// is left out of polling
+#ifndef GEA2_MQTT_BRIDGE_PASSIVE_FRESHNESS
+#define GEA2_MQTT_BRIDGE_PASSIVE_FRESHNESS 30
+#endif
+
+// Seconds between verification polls of an ERD the appliance publishes changes to
+#ifndef GEA2_MQTT_BRIDGE_SUBSCRIBED_VERIFY_PERIOD
+#define GEA2_MQTT_BRIDGE_SUBSCRIBED_VERIFY_PERIOD 300
+#endif
+
+// Percentage of bus time that poll requests and their responses may take, from 10 to 100
+#ifndef GEA2_MQTT_BRIDGE_BUS_DUTY_CYCLE
+#define GEA2_MQTT_BRIDGE_BUS_DUTY_CYCLE 50
+#endif
+
+// While the duty cycle is below 100, ERDs outside the scored blocks are polled only once
+// every this many poll cycles
+#ifndef GEA2_MQTT_BRIDGE_LOW_PRIORITY_POLL_DIVISOR
+#define GEA2_MQTT_BRIDGE_LOW_PRIORITY_POLL_DIVISOR 4
+#endif
+#define ERD_VALUE_ARENA_SIZE 4096
+#define ERD_VALUE_NO_SLOT 0xFFFF
+
+// Writes to ERDs from BRIDGE_COMMAND_ERD_FIRST upwards are commands to the bridge and are
+// never forwarded to the appliance.
+#define BRIDGE_COMMAND_ERD_FIRST 0xFF00
+#define BRIDGE_COMMAND_ERD_SNAPSHOT 0xFF00
+#define BRIDGE_COMMAND_SNAPSHOT_REFRESH 0x01
+#define BRIDGE_COMMAND_ERD_IMPORT_PROFILE 0xFF01
+#define BRIDGE_COMMAND_ERD_DISCOVERY_POLL_SHARE 0xFF02
+#define BRIDGE_COMMAND_ERD_BUS_DUTY_CYCLE 0xFF03
+#define BRIDGE_COMMAND_ERD_POLL_RATE 0xFF04
+
 typedef struct {
   uint32_t uptime;
   tiny_erd_t lastErdPolledSuccessfully;
   tiny_erd_t erd_polling_list[POLLING_LIST_MAX_SIZE];
+  uint8_t erd_size_list[POLLING_LIST_MAX_SIZE];
+  uint8_t erd_size_candidate[POLLING_LIST_MAX_SIZE];
+  uint8_t erd_size_votes[POLLING_LIST_MAX_SIZE];
+  uint8_t erd_address_list[POLLING_LIST_MAX_SIZE];
+  uint8_t erd_poll_failures[POLLING_LIST_MAX_SIZE];
   uint16_t pollingListCount;
+  bool erdSizesLearned;
+  bool erdSizesUnsaved;
+  uint8_t erd_value_arena[ERD_VALUE_ARENA_SIZE];
+  uint16_t erd_value_offset[POLLING_LIST_MAX_SIZE];
+  uint8_t erd_value_slot_size[POLLING_LIST_MAX_SIZE];
+  uint16_t erdValueArenaUsed;
+  uint8_t erd_value_cached[POLLING_LIST_MAX_SIZE / 8];
+  uint8_t erd_registered[POLLING_LIST_MAX_SIZE / 8];
+  uint16_t republishIndex;
+  uint8_t erd_heard[POLLING_LIST_MAX_SIZE / 8];
+  uint16_t erd_heard_at[POLLING_LIST_MAX_SIZE];
+  uint8_t erd_subscribed[POLLING_LIST_MAX_SIZE / 8];
+  uint8_t erd_push_rejected[POLLING_LIST_MAX_SIZE / 8];
   tiny_timer_group_t* timer_group;
   i_tiny_gea2_erd_client_t* erd_client;
   i_mqtt_client_t* mqtt_client;
+  const char* storage_namespace;
+  Gea2ErdBatchReader_t* batch_reader;
+  Gea2ErdBatchReader_t* probe_reader;
+  Gea2NodeScanner_t* node_scanner;
+  Gea2ErdSubscriber_t* erd_subscriber;
   tiny_timer_t timer;
   tiny_timer_t applianceLostTimer;
   tiny_timer_t mqttInformationTimer;
+  tiny_timer_t snapshotHoldoffTimer;
+  tiny_timer_t pollPauseTimer;
+  tiny_timer_t republishTimer;
   tiny_event_subscription_t mqtt_write_request_subscription;
   tiny_event_subscription_t mqtt_disconnect_subscription;
   tiny_event_subscription_t erd_client_activity_subscription;
+  tiny_event_subscription_t batch_reader_activity_subscription;
+  tiny_event_subscription_t probe_reader_activity_subscription;
+  tiny_event_subscription_t node_scanner_activity_subscription;
+  tiny_event_subscription_t bus_sniffer_erd_subscription;
+  tiny_event_subscription_t erd_subscriber_activity_subscription;
   tiny_hsm_t hsm;
-  void* erd_set;
   tiny_gea2_erd_client_request_id_t request_id;
   uint8_t erd_host_address;
+  uint8_t node_addresses[GEA2_NODE_SCANNER_MAX_NODES];
+  uint16_t node_poll_index[GEA2_NODE_SCANNER_MAX_NODES];
+  uint8_t nodeCount;
+  uint8_t pollNode;
+  uint8_t discoveryNode;
   uint8_t appliance_type;
-  const tiny_erd_t* applianceErdList;
-  uint16_t applianceErdListCount;
+  uint32_t model_key;
+  uint8_t profileVerifyCycles;
+  bool pollingListChanged;
+  uint8_t profile_import_buffer[POLLING_PROFILE_SIZE(POLLING_LIST_MAX_SIZE)];
+  uint16_t profileImportSize;
+  polling_profile_t imported_profile;
+  tiny_erd_t imported_erds[POLLING_LIST_MAX_SIZE];
+  uint8_t imported_sizes[POLLING_LIST_MAX_SIZE];
+  uint8_t imported_addresses[POLLING_LIST_MAX_SIZE];
+  erd_range_iterator_t candidateIterator;
+  uint16_t discoveryCheckpoint;
+  uint16_t discoveryCheckpointErds;
+  uint8_t discoveryPollShare;
+  uint8_t discoveryPollCredit;
+  erd_range_iterator_t probeIterator;
+  uint8_t absent_erds[APPLIANCE_ERD_CANDIDATES_MAX / 8];
+  uint8_t missed_erds[APPLIANCE_ERD_CANDIDATES_MAX / 8];
+  uint8_t absentErdsAge;
+  uint32_t absentErdsAgedAt;
+  bool absentErdsChanged;
+  tiny_erd_t probeErd;
+  uint8_t probesThisCycle;
+  uint8_t recoveryAttempts;
+  tiny_erd_t candidateErd;
   uint16_t erd_index;
+  uint8_t batch_count;
+  uint8_t batch_fallback_count;
+  uint8_t batch_failures;
+  bool batching_supported;
+  bool refreshRequested;
+  uint8_t pushSupport;
+  uint16_t subscribeIndex;
+  uint32_t subscribeAfter;
+  uint8_t busDutyCycle;
+  uint8_t pollCycle;
+  bool deferLowPriority;
+  bool pollThrottled;
+  bool pollPausedThisCycle;
+  uint32_t pollPauseOwed;
+  uint32_t busTimeUsed;
+  poll_rate_t detectedPollRate;
+  uint8_t pollRateOverride;
+  uint16_t poll_cycle_period[poll_rate_count];
+  uint32_t pollCycleStartedAt;
+  bool pollCycleHeld;
 } Gea2MqttBridge_t;
 
 /*!
- * Initialize the MQTT bridge.
+ * Initialize the MQTT bridge. The poll list and discovery checkpoint are kept in the NVS
+ * namespace storage_namespace, which must be unique to the bridge; polling profiles are
+ * stored per model and shared by all bridges. Candidate ERDs are probed through probe_reader,
+ * which should give up sooner than the batch_reader used for polling.
  */
 void gea2_mqtt_bridge_init(
   Gea2MqttBridge_t* self,
   tiny_timer_group_t* timer_group,
   i_tiny_gea2_erd_client_t* erd_client,
-  i_mqtt_client_t* mqtt_client);
+  Gea2ErdBatchReader_t* batch_reader,
+  Gea2ErdBatchReader_t* probe_reader,
+  Gea2NodeScanner_t* node_scanner,
+  Gea2BusSniffer_t* bus_sniffer,
+  Gea2ErdSubscriber_t* erd_subscriber,
+  i_mqtt_client_t* mqtt_client,
+  const char* storage_namespace);
+
+/*!
+ * Tell the bridge that an update of erd never reached the broker, so its value is published
+ * again the next time it is read.
+ */
+void gea2_mqtt_bridge_erd_update_dropped(
+  Gea2MqttBridge_t* self,
+  tiny_erd_t erd);
 
 /*!
  * Destroy the MQTT bridge.
@@ -0,0 +1,109 @@
+/*!
+ * @file
+ * @brief
+ */
+
+extern "C" {
+#include "Gea2NodeScanner.h"
+#include "tiny_gea_constants.h"
+}
+
+typedef Gea2NodeScanner_t self_t;
+
+enum {
+  gea2_version_command = 0x01,
+  gea2_version_response_size = 5 // Command and four version bytes
+};
+
+static bool NodeKnown(self_t* self, uint8_t address)
+{
+  for(uint8_t i = 0; i < self->node_count; i++) {
+    if(self->addresses[i] == address) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void PacketReceived(void* context, const void* _args)
+{
+  auto self = reinterpret_cast<self_t*>(context);
+  auto packet = reinterpret_cast<const tiny_gea_interface_on_receive_args_t*>(_args)->packet;
+
+  // Version requests from other clients, and their answers, are not answers to this scan
+  if(!self->busy ||
+    (packet->destination != self->client_address) ||
+    (packet->payload_length != gea2_version_response_size) ||
+    (packet->payload[0] != gea2_version_command) ||
+    NodeKnown(self, packet->source) ||
+    (self->node_count >= GEA2_NODE_SCANNER_MAX_NODES)) {
+    return;
+  }
+
+  self->addresses[self->node_count++] = packet->source;
+
+  gea2_node_scanner_on_activity_args_t args;
+  args.type = gea2_node_scanner_activity_type_node_found;
+  args.node_found.address = packet->source;
+  tiny_event_publish(&self->on_activity, &args);
+}
+
+void gea2_node_scanner_init(
+  self_t* self,
+  tiny_timer_group_t* timer_group,
+  i_tiny_gea_interface_t* gea2_interface,
+  uint8_t client_address)
+{
+  self->timer_group = timer_group;
+  self->gea2_interface = gea2_interface;
+  self->client_address = client_address;
+  self->node_count = 0;
+  self->busy = false;
+
+  tiny_event_init(&self->on_activity);
+  tiny_event_subscription_init(&self->on_receive_subscription, self, PacketReceived);
+  tiny_event_subscribe(tiny_gea_interface_on_receive(gea2_interface), &self->on_receive_subscription);
+}
+
+bool gea2_node_scanner_scan(self_t* self, uint16_t listen_time)
+{
+  if(self->busy) {
+    return false;
+  }
+
+  self->busy = true;
+  self->node_count = 0;
+
+  tiny_gea_interface_send(
+    self->gea2_interface,
+    tiny_gea_broadcast_address,
+    1,
+    self,
+    +[](void*, tiny_gea_packet_t* packet) {
+      packet->payload[0] = gea2_version_command;
+    });
+
+  tiny_timer_start(
+    self->timer_group, &self->timer, listen_time, self, +[](void* context) {
+      auto self = reinterpret_cast<self_t*>(context);
+      self->busy = false;
+
+      gea2_node_scanner_on_activity_args_t args;
+      args.type = gea2_node_scanner_activity_type_scan_completed;
+      args.scan_completed.node_count = self->node_count;
+      args.scan_completed.addresses = self->addresses;
+      tiny_event_publish(&self->on_activity, &args);
+    });
+  return true;
+}
+
+void gea2_node_scanner_cancel(self_t* self)
+{
+  tiny_timer_stop(self->timer_group, &self->timer);
+  self->busy = false;
+}
+
+i_tiny_event_t* gea2_node_scanner_on_activity(self_t* self)
+{
+  return &self->on_activity.interface;
+}
@@ -0,0 +1,80 @@
+/*!
+ * @file
+ * @brief Finds the GEA2 nodes on the bus.
+ *
+ * Every GEA2 node answers the version request, so broadcasting one and listening for a while
+ * enumerates the boards that can be read. Nodes are reported in the order they answer; only
+ * version responses addressed to the client count as answers.
+ */
+
+#ifndef Gea2NodeScanner_h
+#define Gea2NodeScanner_h
+
+#include "i_tiny_gea_interface.h"
+#include "tiny_event.h"
+#include "tiny_timer.h"
+
+#define GEA2_NODE_SCANNER_MAX_NODES 4
+
+enum {
+  gea2_node_scanner_activity_type_node_found,
+  gea2_node_scanner_activity_type_scan_completed
+};
+typedef uint8_t gea2_node_scanner_activity_type_t;
+
+typedef struct {
+  gea2_node_scanner_activity_type_t type;
+  union {
+    struct {
+      uint8_t address;
+    } node_found;
+
+    struct {
+      uint8_t node_count;
+      const uint8_t* addresses;
+    } scan_completed;
+  };
+} gea2_node_scanner_on_activity_args_t;
+
+typedef struct {
+  tiny_timer_group_t* timer_group;
+  i_tiny_gea_interface_t* gea2_interface;
+  tiny_event_subscription_t on_receive_subscription;
+  tiny_event_t on_activity;
+  tiny_timer_t timer;
+  uint8_t addresses[GEA2_NODE_SCANNER_MAX_NODES];
+  uint8_t node_count;
+  uint8_t client_address;
+  bool busy;
+} Gea2NodeScanner_t;
+
+/*!
+ * Initialize the node scanner for the client at client_address.
+ */
+void gea2_node_scanner_init(
+  Gea2NodeScanner_t* self,
+  tiny_timer_group_t* timer_group,
+  i_tiny_gea_interface_t* gea2_interface,
+  uint8_t client_address);
+
+/*!
+ * Broadcast a version request and collect the nodes that answer within listen_time. Returns
+ * false if a scan is already running.
+ */
+bool gea2_node_scanner_scan(
+  Gea2NodeScanner_t* self,
+  uint16_t listen_time);
+
+/*!
+ * Stop a running scan without reporting it.
+ */
+void gea2_node_scanner_cancel(
+  Gea2NodeScanner_t* self);
+
+/*!
+ * Raised for each node found and when the scan completes.
+ */
+i_tiny_event_t* gea2_node_scanner_on_activity(
+  Gea2NodeScanner_t* self);
+
+#endif
@@ -0,0 +1,126 @@
+/*!
+ * @file
+ * @brief
+ */
+
+extern "C" {
+#include "Gea2RoundTripEstimator.h"
+}
+
+typedef Gea2RoundTripEstimator_t self_t;
+
+enum {
+  scale = 16,
+  mean_gain_shift = 3,
+  variance_gain_shift = 2,
+  min_samples = 4,
+  min_deviation = 2,
+  timer_margin = 2
+};
+
+static uint16_t SquareRoot(uint32_t value)
+{
+  uint32_t root = 0;
+  uint32_t bit = 1UL << 30;
+  while(bit > value) {
+    bit >>= 2;
+  }
+  while(bit != 0) {
+    if(value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+static uint16_t Deviation(const gea2_round_trip_node_t* node)
+{
+  return SquareRoot(node->variance / scale);
+}
+
+static gea2_round_trip_node_t* NodeFor(self_t* self, uint8_t address)
+{
+  for(uint8_t i = 0; i < self->nodeCount; i++) {
+    if(self->nodes[i].address == address) {
+      return &self->nodes[i];
+    }
+  }
+  return nullptr;
+}
+
+void gea2_round_trip_estimator_init(self_t* self, uint16_t initial_timeout, uint16_t max_timeout, uint8_t deviations)
+{
+  self->nodeCount = 0;
+  self->initial_timeout = initial_timeout;
+  self->max_timeout = max_timeout;
+  self->deviations = deviations;
+}
+
+uint16_t gea2_round_trip_estimator_wire_time(uint16_t bytes)
+{
+  return ((uint32_t)bytes * GEA2_ROUND_TRIP_ESTIMATOR_BYTE_TIME + 999) / 1000;
+}
+
+void gea2_round_trip_estimator_add_sample(self_t* self, uint8_t address, uint16_t turnaround)
+{
+  gea2_round_trip_node_t* node = NodeFor(self, address);
+  if(node == nullptr) {
+    if(self->nodeCount >= GEA2_ROUND_TRIP_ESTIMATOR_MAX_NODES) {
+      return;
+    }
+    node = &self->nodes[self->nodeCount++];
+    node->address = address;
+    node->samples = 0;
+  }
+
+  int32_t sample = ((turnaround < self->max_timeout) ? turnaround : self->max_timeout) * scale;
+  if(node->samples == 0) {
+    node->mean = sample;
+    node->variance = 0;
+  }
+  else {
+    int32_t difference = sample - (int32_t)node->mean;
+    node->mean += difference / (1 << mean_gain_shift);
+    uint32_t squared = (uint32_t)(difference * difference) / scale;
+    node->variance = node->variance - (node->variance >> variance_gain_shift) + (squared >> variance_gain_shift);
+  }
+
+  if(node->samples < UINT8_MAX) {
+    node->samples++;
+  }
+}
+
+uint16_t gea2_round_trip_estimator_timeout(self_t* self, uint8_t address, uint16_t wire_time)
+{
+  gea2_round_trip_node_t* node = NodeFor(self, address);
+  uint32_t timeout;
+  if((node == nullptr) || (node->samples < min_samples)) {
+    timeout = wire_time + self->initial_timeout;
+  }
+  else {
+    uint16_t deviation = Deviation(node);
+    if(deviation < min_deviation) {
+      deviation = min_deviation;
+    }
+    timeout = wire_time + node->mean / scale + self->deviations * deviation + timer_margin;
+  }
+  return (timeout < self->max_timeout) ? timeout : self->max_timeout;
+}
+
+bool gea2_round_trip_estimator_node(self_t* self, uint8_t index, uint8_t* address, uint16_t* mean, uint16_t* deviation)
+{
+  if(index >= self->nodeCount) {
+    return false;
+  }
+
+  const gea2_round_trip_node_t* node = &self->nodes[index];
+  *address = node->address;
+  *mean = node->mean / scale;
+  *deviation = Deviation(node);
+  return true;
+}
@@ -0,0 +1,87 @@
+/*!
+ * @file
+ * @brief Running estimate of how long each GEA2 node takes to answer a request.
+ *
+ * Only the node's turnaround is estimated; the time the request and response spend on the
+ * wire depends on their size and is added back when a timeout is asked for. Each node keeps an
+ * exponentially weighted mean and variance, and a timeout is the wire time plus the mean plus
+ * a number of standard deviations. Until a node has answered a few times the initial timeout
+ * stands in for the turnaround.
+ */
+
+#ifndef Gea2RoundTripEstimator_h
+#define Gea2RoundTripEstimator_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define GEA2_ROUND_TRIP_ESTIMATOR_MAX_NODES 8
+
+// Microseconds one byte, with its start and stop bits, takes on the bus at 19200 baud
+#define GEA2_ROUND_TRIP_ESTIMATOR_BYTE_TIME 521
+
+// Bytes a packet takes on the bus beyond its payload: addresses, length, CRC, STX, ETX and the
+// receiver's ACK
+#define GEA2_ROUND_TRIP_ESTIMATOR_FRAME_OVERHEAD 8
+
+typedef struct {
+  uint8_t address;
+  uint8_t samples;
+  uint32_t mean; // Milliseconds, scaled by 16
+  uint32_t variance; // Square milliseconds, scaled by 16
+} gea2_round_trip_node_t;
+
+typedef struct {
+  gea2_round_trip_node_t nodes[GEA2_ROUND_TRIP_ESTIMATOR_MAX_NODES];
+  uint8_t nodeCount;
+  uint16_t initial_timeout;
+  uint16_t max_timeout;
+  uint8_t deviations;
+} Gea2RoundTripEstimator_t;
+
+/*!
+ * Initialize the estimator. Timeouts are the wire time plus initial_timeout until a node has
+ * been measured, and never more than max_timeout.
+ */
+void gea2_round_trip_estimator_init(
+  Gea2RoundTripEstimator_t* self,
+  uint16_t initial_timeout,
+  uint16_t max_timeout,
+  uint8_t deviations);
+
+/*!
+ * Milliseconds that bytes take on the wire, rounded up.
+ */
+uint16_t gea2_round_trip_estimator_wire_time(
+  uint16_t bytes);
+
+/*!
+ * Record the turnaround of a request answered on its first attempt. Answers to retries are
+ * ambiguous and must not be recorded.
+ */
+void gea2_round_trip_estimator_add_sample(
+  Gea2RoundTripEstimator_t* self,
+  uint8_t address,
+  uint16_t turnaround);
+
+/*!
+ * Milliseconds to wait for an answer from address to a request and response that together
+ * take wire_time on the bus.
+ */
+uint16_t gea2_round_trip_estimator_timeout(
+  Gea2RoundTripEstimator_t* self,
+  uint8_t address,
+  uint16_t wire_time);
+
+/*!
+ * Get the turnaround mean and standard deviation of the index-th node measured, in
+ * milliseconds. Returns false when there is no such node.
+ */
+bool gea2_round_trip_estimator_node(
+  Gea2RoundTripEstimator_t* self,
+  uint8_t index,
+  uint8_t* address,
+  uint16_t* mean,
+  uint16_t* deviation);
+
+#endif
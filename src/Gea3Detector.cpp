@@ -0,0 +1,99 @@
+/*!
+ * @file
+ * @brief
+ */
+
+#include "Gea3Detector.h"
+
+extern "C" {
+#include "tiny_gea_constants.h"
+#include "tiny_time_source.h"
+}
+
+enum {
+  version_request_command = 0x01,
+  probe_attempts = 4,
+  probe_window = 250
+};
+
+void Gea3Detector::begin(Stream& uart, uint8_t clientAddress)
+{
+  attempts = 0;
+  probing = true;
+  replied = false;
+
+  tiny_timer_group_init(&timer_group, tiny_time_source_init());
+  tiny_uart_adapter_init(&uart_adapter, &timer_group, uart);
+  tiny_gea3_interface_init(
+    &gea3_interface,
+    &uart_adapter.interface,
+    clientAddress,
+    send_queue_buffer,
+    sizeof(send_queue_buffer),
+    receive_buffer,
+    sizeof(receive_buffer),
+    false);
+
+  tiny_event_subscription_init(
+    &receive_subscription, this, +[](void* context, const void*) {
+      reinterpret_cast<Gea3Detector*>(context)->replied = true;
+    });
+  tiny_event_subscribe(tiny_gea_interface_on_receive(&gea3_interface.interface), &receive_subscription);
+
+  sendProbe();
+}
+
+void Gea3Detector::run()
+{
+  if(probing) {
+    tiny_timer_group_run(&timer_group);
+  }
+
+  if(probing) {
+    tiny_gea3_interface_run(&gea3_interface);
+
+    if(replied) {
+      finish();
+    }
+  }
+}
+
+bool Gea3Detector::done() const
+{
+  return !probing;
+}
+
+bool Gea3Detector::found() const
+{
+  return replied;
+}
+
+void Gea3Detector::sendProbe()
+{
+  if(attempts++ == probe_attempts) {
+    finish();
+    return;
+  }
+
+  tiny_gea_interface_send(
+    &gea3_interface.interface,
+    tiny_gea_broadcast_address,
+    1,
+    nullptr,
+    +[](void*, tiny_gea_packet_t* packet) {
+      packet->payload[0] = version_request_command;
+    });
+
+  tiny_timer_start(
+    &timer_group, &probeTimer, probe_window, this, +[](void* context) {
+      reinterpret_cast<Gea3Detector*>(context)->sendProbe();
+    });
+}
+
+// The timer group and interface are not run again, which leaves the UART to the bridge
+void Gea3Detector::finish()
+{
+  probing = false;
+  tiny_timer_stop(&timer_group, &probeTimer);
+  tiny_event_unsubscribe(tiny_gea_interface_on_receive(&gea3_interface.interface), &receive_subscription);
+}
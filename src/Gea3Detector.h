@@ -0,0 +1,52 @@
+/*!
+ * @file
+ * @brief Finds out whether the appliance on a UART speaks GEA3.
+ *
+ * A version request is broadcast with GEA3 framing at HomeAssistantBridge::baud, and any valid
+ * GEA3 packet received in reply means the appliance supports GEA3. GEA2 nodes discard the
+ * request as a bad frame.
+ *
+ * The probe runs from a timer group of its own, so that once it is done nothing is left reading
+ * the UART: the UART adapter and GEA3 interface are only run from run() while probing.
+ */
+
+#ifndef Gea3Detector_h
+#define Gea3Detector_h
+
+#include <Arduino.h>
+#include <cstdint>
+#include "tiny_uart_adapter.hpp"
+
+extern "C" {
+#include "tiny_gea3_interface.h"
+#include "tiny_timer.h"
+}
+
+class Gea3Detector {
+ public:
+  // The UART must already be running at HomeAssistantBridge::baud
+  void begin(Stream& uart, uint8_t clientAddress = 0xE4);
+  // Call from loop() until done(); probing takes up to a second
+  void run();
+  bool done() const;
+  bool found() const;
+
+ private:
+  void sendProbe();
+  void finish();
+
+  tiny_timer_group_t timer_group;
+  tiny_timer_t probeTimer;
+  tiny_uart_adapter_t uart_adapter;
+
+  tiny_gea3_interface_t gea3_interface;
+  uint8_t receive_buffer[64];
+  uint8_t send_queue_buffer[64];
+
+  tiny_event_subscription_t receive_subscription;
+  uint8_t attempts;
+  bool probing;
+  bool replied;
+};
+
+#endif
@@ -6,22 +6,83 @@
 #include <Arduino.h>
 #include "HomeAssistantGea2Bridge.h"
 
+#if defined(ESP_PLATFORM)
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#endif
+
 extern "C" {
 #include "tiny_time_source.h"
 }
 
+// Receive every packet on the bus so ERD traffic between the appliance boards can be harvested
+#ifndef GEA2_BRIDGE_PASSIVE_LISTENING
+#define GEA2_BRIDGE_PASSIVE_LISTENING true
+#endif
+
+// Run the GEA2 stack, timers and bridge in a task of their own above the Arduino loop task, so
+// network stalls cannot hold up the bus
+#ifndef GEA2_BRIDGE_BUS_TASK
+#if defined(ESP_PLATFORM)
+#define GEA2_BRIDGE_BUS_TASK true
+#else
+#define GEA2_BRIDGE_BUS_TASK false
+#endif
+#endif
+
+enum {
+  publish_stats_period = 60000,
+  subscribe_retries = 2,
+  bus_task_stack_size = 8192,
+  bus_task_priority = 2,
+  initial_request_timeout = 250,
+  max_request_timeout = 500,
+  request_timeout_deviations = 4,
+  poll_request_retries = 4,
+  probe_request_retries = 1,
+  mqtt_topic_allowance = 128,
+  // Room to publish the largest polling profile as hex, with its topic and the packet header
+  mqtt_buffer_size = POLLING_PROFILE_SIZE(POLLING_LIST_MAX_SIZE) * 2 + mqtt_topic_allowance
+};
+
+// Only used for identification, recovery and writes; polls and probes use the batch readers,
+// whose timeouts follow the measured round trip of each node
 static const tiny_gea2_erd_client_configuration_t client_configuration = {
   .request_timeout = 250,
   .request_retries = 10
 };
 
-void HomeAssistantGea2Bridge::begin(PubSubClient& pubSubClient, Stream& uart, const char* deviceId, uint8_t clientAddress)
+tiny_timer_group_t HomeAssistantGea2Bridge::timer_group;
+HomeAssistantGea2Bridge* HomeAssistantGea2Bridge::firstBridge;
+
+#if GEA2_BRIDGE_BUS_TASK
+// Held by the bus task while it runs the buses, and by begin() while it adds a bridge to them
+static SemaphoreHandle_t busLock;
+#endif
+
+void HomeAssistantGea2Bridge::begin(
+  PubSubClient& pubSubClient,
+  Stream& uart,
+  const char* deviceId,
+  uint8_t clientAddress,
+  const char* storageNamespace)
 {
   Serial.println("GEA2 bridge startup");
   this->pubSubClient = &pubSubClient;
+  pubSubClient.setBufferSize(mqtt_buffer_size);
+
+#if GEA2_BRIDGE_BUS_TASK
+  if(busLock == nullptr) {
+    busLock = xSemaphoreCreateMutex();
+  }
+  xSemaphoreTake(busLock, portMAX_DELAY);
+#endif
 
-  Serial.println("Timer group startup");
-  tiny_timer_group_init(&timer_group, tiny_time_source_init());
+  if(firstBridge == nullptr) {
+    Serial.println("Timer group startup");
+    tiny_timer_group_init(&timer_group, tiny_time_source_init());
+  }
 
   Serial.println("UART startup");
   tiny_uart_adapter_init(&uart_adapter, &timer_group, uart);
@@ -29,6 +90,18 @@ void HomeAssistantGea2Bridge::begin(PubSubClient& pubSubClient, Stream& uart, co
   Serial.println("MQTT client adapter init");
   mqtt_client_adapter_init(&client_adapter, &pubSubClient, deviceId);
 
+  // The counter sits behind the queue, so it counts what reaches the broker and not what the
+  // queue drops. It is updated from the network task and only read from the bus task.
+  Serial.println("MQTT publish counter init");
+  mqtt_publish_counter_init(&publish_counter, &client_adapter.interface);
+
+  Serial.println("MQTT queue init");
+  queued_mqtt_client_init(&queued_client, &publish_counter.interface);
+  tiny_timer_start_periodic(
+    &timer_group, &publishStatsTimer, publish_stats_period, this, +[](void* context) {
+      reinterpret_cast<HomeAssistantGea2Bridge*>(context)->publishStats();
+    });
+
   Serial.println("Fake msec interrupt init");
   tiny_event_init(&fakeMsecInterrupt);
   tiny_timer_start_periodic(
@@ -48,7 +121,7 @@ void HomeAssistantGea2Bridge::begin(PubSubClient& pubSubClient, Stream& uart, co
     sizeof(send_queue_buffer),
     receive_buffer,
     sizeof(receive_buffer),
-    false,
+    GEA2_BRIDGE_PASSIVE_LISTENING,
     1);
 
   Serial.println("GEA2 erd client startup");
@@ -60,22 +133,142 @@ void HomeAssistantGea2Bridge::begin(PubSubClient& pubSubClient, Stream& uart, co
     sizeof(client_queue_buffer),
     &client_configuration);
 
+  Serial.println("GEA2 batch reader startup");
+  gea2_round_trip_estimator_init(&round_trip_estimator, initial_request_timeout, max_request_timeout, request_timeout_deviations);
+  gea2_erd_batch_reader_init(
+    &batch_reader,
+    &timer_group,
+    &gea2_interface.interface,
+    clientAddress,
+    sizeof(receive_buffer),
+    &round_trip_estimator,
+    poll_request_retries);
+  gea2_erd_batch_reader_init(
+    &probe_reader,
+    &timer_group,
+    &gea2_interface.interface,
+    clientAddress,
+    sizeof(receive_buffer),
+    &round_trip_estimator,
+    probe_request_retries);
+
+  Serial.println("GEA2 node scanner startup");
+  gea2_node_scanner_init(&node_scanner, &timer_group, &gea2_interface.interface, clientAddress);
+
+  Serial.println("GEA2 bus sniffer startup");
+  gea2_bus_sniffer_init(&bus_sniffer, &gea2_interface.interface, clientAddress);
+
+  Serial.println("GEA2 erd subscriber startup");
+  gea2_erd_subscriber_init(
+    &erd_subscriber,
+    &timer_group,
+    &gea2_interface.interface,
+    clientAddress,
+    client_configuration.request_timeout,
+    subscribe_retries);
+
   Serial.println("MQTT bridge init");
   gea2_mqtt_bridge_init(
     &gea2_mqtt_bridge,
     &timer_group,
     &erd_client.interface,
-    &client_adapter.interface);
+    &batch_reader,
+    &probe_reader,
+    &node_scanner,
+    &bus_sniffer,
+    &erd_subscriber,
+    &queued_client.interface,
+    storageNamespace);
+
+  // Values the MQTT queue had no room for are published again when next read
+  tiny_event_subscription_init(
+    &update_dropped, &gea2_mqtt_bridge, +[](void* context, const void* _args) {
+      auto args = reinterpret_cast<const queued_mqtt_client_on_update_dropped_args_t*>(_args);
+      gea2_mqtt_bridge_erd_update_dropped(reinterpret_cast<Gea2MqttBridge_t*>(context), args->erd);
+    });
+  tiny_event_subscribe(queued_mqtt_client_on_update_dropped(&queued_client), &update_dropped);
+
+  nextBridge = firstBridge;
+  firstBridge = this;
+
+#if GEA2_BRIDGE_BUS_TASK
+  // Started with the first bridge, and then runs them all
+  if(nextBridge == nullptr) {
+    Serial.println("GEA2 bus task startup");
+    xTaskCreate(
+      +[](void*) {
+        while(true) {
+          xSemaphoreTake(busLock, portMAX_DELAY);
+          runBuses();
+          xSemaphoreGive(busLock);
+          vTaskDelay(1);
+        }
+      },
+      "gea2_bus",
+      bus_task_stack_size,
+      nullptr,
+      bus_task_priority,
+      nullptr);
+  }
+  xSemaphoreGive(busLock);
+#endif
   Serial.println("GEA2 bridge started");
 }
 
-void HomeAssistantGea2Bridge::loop()
+void HomeAssistantGea2Bridge::publishStats()
 {
-  pubSubClient->loop();
+  auto mqttClient = &queued_client.interface;
+  auto counts = *mqtt_publish_counter_counts(&publish_counter);
+  mqtt_client_publish_sub_topic(mqttClient, "erdMessages", String(counts.erd_values.messages).c_str());
+  mqtt_client_publish_sub_topic(mqttClient, "erdBytes", String(counts.erd_values.bytes).c_str());
+  mqtt_client_publish_sub_topic(mqttClient, "writeResultMessages", String(counts.write_results.messages).c_str());
+  mqtt_client_publish_sub_topic(mqttClient, "writeResultBytes", String(counts.write_results.bytes).c_str());
+  mqtt_client_publish_sub_topic(mqttClient, "telemetryMessages", String(counts.telemetry.messages).c_str());
+  mqtt_client_publish_sub_topic(mqttClient, "telemetryBytes", String(counts.telemetry.bytes).c_str());
+  mqtt_client_publish_sub_topic(mqttClient, "mqttQueueDrops", String(queued_mqtt_client_dropped(&queued_client)).c_str());
+
+  mqtt_client_publish_sub_topic(mqttClient, "pollRetryLimit", String((unsigned)poll_request_retries).c_str());
+  mqtt_client_publish_sub_topic(mqttClient, "pollRetries", String(gea2_erd_batch_reader_retries_sent(&batch_reader)).c_str());
+  mqtt_client_publish_sub_topic(mqttClient, "probeRetryLimit", String((unsigned)probe_request_retries).c_str());
+  mqtt_client_publish_sub_topic(mqttClient, "probeRetries", String(gea2_erd_batch_reader_retries_sent(&probe_reader)).c_str());
+
+  uint8_t address;
+  uint16_t mean;
+  uint16_t deviation;
+  for(uint8_t i = 0; gea2_round_trip_estimator_node(&round_trip_estimator, i, &address, &mean, &deviation); i++) {
+    auto node = String(address, HEX);
+    auto timeout = gea2_round_trip_estimator_timeout(&round_trip_estimator, address, 0);
+    mqtt_client_publish_sub_topic(mqttClient, ("roundTripMean/" + node).c_str(), String(mean).c_str());
+    mqtt_client_publish_sub_topic(mqttClient, ("roundTripDeviation/" + node).c_str(), String(deviation).c_str());
+    mqtt_client_publish_sub_topic(mqttClient, ("roundTripTimeout/" + node).c_str(), String(timeout).c_str());
+  }
+}
+
+void HomeAssistantGea2Bridge::runBuses()
+{
+  for(auto bridge = firstBridge; bridge != nullptr; bridge = bridge->nextBridge) {
+    bridge->runBus();
+  }
   tiny_timer_group_run(&timer_group);
+}
+
+void HomeAssistantGea2Bridge::runBus()
+{
+  queued_mqtt_client_run_bus(&queued_client);
   tiny_gea2_interface_run(&gea2_interface);
 }
 
+void HomeAssistantGea2Bridge::loop()
+{
+#if !GEA2_BRIDGE_BUS_TASK
+  // Running the shared timer group once for every bridge does no harm
+  runBus();
+  tiny_timer_group_run(&timer_group);
+#endif
+  pubSubClient->loop();
+  queued_mqtt_client_run_network(&queued_client);
+}
+
 void HomeAssistantGea2Bridge::notifyMqttDisconnected()
 {
   mqtt_client_adapter_notify_mqtt_disconnected(&client_adapter);
@@ -12,7 +12,14 @@
 #include "tiny_uart_adapter.hpp"
 
 extern "C" {
+#include "Gea2BusSniffer.h"
+#include "Gea2ErdBatchReader.h"
+#include "Gea2ErdSubscriber.h"
 #include "Gea2MqttBridge.h"
+#include "Gea2NodeScanner.h"
+#include "Gea2RoundTripEstimator.h"
+#include "MqttPublishCounter.h"
+#include "QueuedMqttClient.h"
 #include "tiny_gea2_erd_client.h"
 #include "tiny_gea2_interface.h"
 #include "tiny_timer.h"
@@ -22,20 +29,37 @@ class HomeAssistantGea2Bridge {
  public:
   static constexpr unsigned long baud = 19200;
 
-  void begin(PubSubClient& client, Stream& uart, const char* deviceId, uint8_t clientAddress = 0xE4);
+  // Every bridge needs its own PubSubClient, device ID and storage namespace. All the bridges
+  // share one timer group and, where GEA2_BRIDGE_BUS_TASK is set, one bus task.
+  void begin(
+    PubSubClient& client,
+    Stream& uart,
+    const char* deviceId,
+    uint8_t clientAddress = 0xE4,
+    const char* storageNamespace = "storage");
+  // Runs the network side; the bus side runs in its own task where GEA2_BRIDGE_BUS_TASK is set
   void loop();
   void notifyMqttDisconnected();
 
  private:
-  PubSubClient* pubSubClient;
+  static void runBuses();
+  void runBus();
+  void publishStats();
+
+  static tiny_timer_group_t timer_group;
+  static HomeAssistantGea2Bridge* firstBridge;
+  HomeAssistantGea2Bridge* nextBridge;
 
-  tiny_timer_group_t timer_group;
+  PubSubClient* pubSubClient;
 
   tiny_event_t fakeMsecInterrupt;
   tiny_timer_t fakeMsecTimer;
 
   tiny_uart_adapter_t uart_adapter;
   mqtt_client_adapter_t client_adapter;
+  QueuedMqttClient_t queued_client;
+  MqttPublishCounter_t publish_counter;
+  tiny_timer_t publishStatsTimer;
 
   tiny_gea2_interface_t gea2_interface;
   uint8_t receive_buffer[255];
@@ -45,7 +69,15 @@ class HomeAssistantGea2Bridge {
   uint8_t client_queue_buffer[8096];
   tiny_gea2_erd_client_request_id_t requestId;
 
+  Gea2RoundTripEstimator_t round_trip_estimator;
+  Gea2ErdBatchReader_t batch_reader;
+  Gea2ErdBatchReader_t probe_reader;
+  Gea2NodeScanner_t node_scanner;
+  Gea2BusSniffer_t bus_sniffer;
+  Gea2ErdSubscriber_t erd_subscriber;
+
   tiny_event_subscription_t activity;
+  tiny_event_subscription_t update_dropped;
 
   Gea2MqttBridge_t gea2_mqtt_bridge;
 };
@@ -0,0 +1,115 @@
+/*!
+ * @file
+ * @brief
+ */
+
+#include <string.h>
+
+extern "C" {
+#include "MqttPublishCounter.h"
+#include "tiny_utils.h"
+}
+
+typedef MqttPublishCounter_t self_t;
+
+enum {
+  hex_chars_per_byte = 2,
+  write_result_size = sizeof(bool) + sizeof(uint8_t)
+};
+
+static void Count(mqtt_publish_count_t* count, uint32_t bytes)
+{
+  count->messages++;
+  count->bytes += bytes;
+}
+
+static void RegisterErd(i_mqtt_client_t* _self, tiny_erd_t erd)
+{
+  self_t* self = container_of(self_t, interface, _self);
+  if(self->mqtt_client) {
+    mqtt_client_register_erd(self->mqtt_client, erd);
+  }
+}
+
+static void UpdateErd(i_mqtt_client_t* _self, tiny_erd_t erd, const void* value, uint8_t size)
+{
+  self_t* self = container_of(self_t, interface, _self);
+  Count(&self->counts.erd_values, size * hex_chars_per_byte);
+  if(self->mqtt_client) {
+    mqtt_client_update_erd(self->mqtt_client, erd, value, size);
+  }
+}
+
+static void UpdateErdWriteResult(i_mqtt_client_t* _self, tiny_erd_t erd, bool success, uint8_t failure_reason)
+{
+  self_t* self = container_of(self_t, interface, _self);
+  Count(&self->counts.write_results, write_result_size * hex_chars_per_byte);
+  if(self->mqtt_client) {
+    mqtt_client_update_erd_write_result(self->mqtt_client, erd, success, failure_reason);
+  }
+}
+
+static void PublishSubTopic(i_mqtt_client_t* _self, const char* sub_topic, const char* payload)
+{
+  self_t* self = container_of(self_t, interface, _self);
+  Count(&self->counts.telemetry, strlen(payload));
+  if(self->mqtt_client) {
+    mqtt_client_publish_sub_topic(self->mqtt_client, sub_topic, payload);
+  }
+}
+
+static i_tiny_event_t* OnWriteRequest(i_mqtt_client_t* _self)
+{
+  self_t* self = container_of(self_t, interface, _self);
+  if(self->mqtt_client) {
+    return mqtt_client_on_write_request(self->mqtt_client);
+  }
+  return &self->on_write_request.interface;
+}
+
+static i_tiny_event_t* OnMqttDisconnect(i_mqtt_client_t* _self)
+{
+  self_t* self = container_of(self_t, interface, _self);
+  if(self->mqtt_client) {
+    return mqtt_client_on_mqtt_disconnect(self->mqtt_client);
+  }
+  return &self->on_mqtt_disconnect.interface;
+}
+
+static const i_mqtt_client_api_t api = {
+  RegisterErd,
+  UpdateErd,
+  UpdateErdWriteResult,
+  PublishSubTopic,
+  OnWriteRequest,
+  OnMqttDisconnect
+};
+
+void mqtt_publish_counter_init(self_t* self, i_mqtt_client_t* mqtt_client)
+{
+  self->interface.api = &api;
+  self->mqtt_client = mqtt_client;
+  tiny_event_init(&self->on_write_request);
+  tiny_event_init(&self->on_mqtt_disconnect);
+  mqtt_publish_counter_reset(self);
+}
+
+const mqtt_publish_counts_t* mqtt_publish_counter_counts(self_t* self)
+{
+  return &self->counts;
+}
+
+void mqtt_publish_counter_reset(self_t* self)
+{
+  memset(&self->counts, 0, sizeof(self->counts));
+}
+
+void mqtt_publish_counter_inject_write_request(self_t* self, const mqtt_client_on_write_request_args_t* args)
+{
+  tiny_event_publish(&self->on_write_request, args);
+}
+
+void mqtt_publish_counter_inject_disconnect(self_t* self)
+{
+  tiny_event_publish(&self->on_mqtt_disconnect, nullptr);
+}
@@ -0,0 +1,71 @@
+/*!
+ * @file
+ * @brief Wraps an MQTT client and counts the messages and payload bytes published through it.
+ *
+ * Publishes are split into ERD values, write results and telemetry (sub topics). Byte counts
+ * are payload sizes as they go out on the wire, so ERD values and write results are counted
+ * hex encoded.
+ *
+ * If no client is wrapped the counter acts as a recording client on its own: everything is
+ * counted and dropped, and write requests and disconnects can be injected to drive a bridge
+ * without a broker.
+ */
+
+#ifndef MqttPublishCounter_h
+#define MqttPublishCounter_h
+
+#include "i_mqtt_client.h"
+#include "tiny_event.h"
+
+typedef struct {
+  uint32_t messages;
+  uint32_t bytes;
+} mqtt_publish_count_t;
+
+typedef struct {
+  mqtt_publish_count_t erd_values;
+  mqtt_publish_count_t write_results;
+  mqtt_publish_count_t telemetry;
+} mqtt_publish_counts_t;
+
+typedef struct {
+  i_mqtt_client_t interface;
+  i_mqtt_client_t* mqtt_client;
+  mqtt_publish_counts_t counts;
+  tiny_event_t on_write_request;
+  tiny_event_t on_mqtt_disconnect;
+} MqttPublishCounter_t;
+
+/*!
+ * Initialize the counter. mqtt_client may be NULL to record without publishing.
+ */
+void mqtt_publish_counter_init(
+  MqttPublishCounter_t* self,
+  i_mqtt_client_t* mqtt_client);
+
+/*!
+ * Counts accumulated since init or the last reset.
+ */
+const mqtt_publish_counts_t* mqtt_publish_counter_counts(
+  MqttPublishCounter_t* self);
+
+/*!
+ * Zero all counts.
+ */
+void mqtt_publish_counter_reset(
+  MqttPublishCounter_t* self);
+
+/*!
+ * Raise a write request as if it came from the broker. Only used when recording.
+ */
+void mqtt_publish_counter_inject_write_request(
+  MqttPublishCounter_t* self,
+  const mqtt_client_on_write_request_args_t* args);
+
+/*!
+ * Raise a disconnect as if the broker connection was re-established. Only used when recording.
+ */
+void mqtt_publish_counter_inject_disconnect(
+  MqttPublishCounter_t* self);
+
+#endif
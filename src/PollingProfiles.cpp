@@ -0,0 +1,206 @@
+/*!
+ * @file
+ * @brief
+ */
+
+#include <Arduino.h>
+
+extern "C" {
+#include "PollingProfiles.h"
+}
+
+#include <Preferences.h>
+
+#define PROFILE_NAMESPACE "profiles"
+#define RW_MODE false
+#define RO_MODE true
+
+static const uint32_t fnv_offset_basis = 2166136261u;
+static const uint32_t fnv_prime = 16777619u;
+
+enum {
+  max_profile_size = POLLING_PROFILE_SIZE(256),
+  version_1_entry_size = 3
+};
+
+static void KeyName(uint32_t key, char* name, char prefix = 'p')
+{
+  sprintf(name, "%c%08lx", prefix, (unsigned long)key);
+}
+
+uint32_t polling_profile_key(uint8_t applianceType, const void* modelNumber, uint8_t modelNumberSize)
+{
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(modelNumber);
+  uint32_t hash = fnv_offset_basis;
+
+  hash = (hash ^ applianceType) * fnv_prime;
+  for(uint8_t i = 0; i < modelNumberSize; i++) {
+    hash = (hash ^ bytes[i]) * fnv_prime;
+  }
+
+  return (hash != 0) ? hash : 1;
+}
+
+size_t polling_profile_encode(const polling_profile_t* profile, uint8_t* buffer, size_t bufferSize)
+{
+  size_t size = POLLING_PROFILE_SIZE(profile->erdCount);
+  if(size > bufferSize) {
+    return 0;
+  }
+
+  buffer[0] = POLLING_PROFILE_VERSION;
+  buffer[1] = profile->applianceType;
+  buffer[2] = profile->address;
+  buffer[3] = 0;
+  buffer[4] = profile->erdCount >> 8;
+  buffer[5] = profile->erdCount & 0xFF;
+
+  uint8_t* entry = &buffer[POLLING_PROFILE_HEADER_SIZE];
+  for(uint16_t i = 0; i < profile->erdCount; i++) {
+    entry[0] = profile->erds[i] >> 8;
+    entry[1] = profile->erds[i] & 0xFF;
+    entry[2] = profile->sizes[i];
+    entry[3] = profile->addresses[i];
+    entry += POLLING_PROFILE_ENTRY_SIZE;
+  }
+
+  return size;
+}
+
+size_t polling_profile_encoded_size(const uint8_t* header)
+{
+  if((header[0] == 0) || (header[0] > POLLING_PROFILE_VERSION)) {
+    return 0;
+  }
+
+  uint8_t entrySize = (header[0] == 1) ? version_1_entry_size : POLLING_PROFILE_ENTRY_SIZE;
+  uint16_t erdCount = (header[4] << 8) | header[5];
+  return POLLING_PROFILE_HEADER_SIZE + (size_t)erdCount * entrySize;
+}
+
+bool polling_profile_decode(polling_profile_t* profile, uint16_t maxErds, const uint8_t* buffer, size_t size)
+{
+  if((size < POLLING_PROFILE_HEADER_SIZE) || (size != polling_profile_encoded_size(buffer))) {
+    return false;
+  }
+
+  uint8_t entrySize = (buffer[0] == 1) ? version_1_entry_size : POLLING_PROFILE_ENTRY_SIZE;
+  uint16_t erdCount = (buffer[4] << 8) | buffer[5];
+  if(erdCount > maxErds) {
+    return false;
+  }
+
+  profile->applianceType = buffer[1];
+  profile->address = buffer[2];
+  profile->erdCount = erdCount;
+
+  const uint8_t* entry = &buffer[POLLING_PROFILE_HEADER_SIZE];
+  for(uint16_t i = 0; i < erdCount; i++) {
+    profile->erds[i] = (entry[0] << 8) | entry[1];
+    profile->sizes[i] = entry[2];
+    profile->addresses[i] = (entrySize > version_1_entry_size) ? entry[3] : profile->address;
+    entry += entrySize;
+  }
+
+  return true;
+}
+
+bool polling_profile_load(uint32_t key, polling_profile_t* profile, uint16_t maxErds)
+{
+  Preferences nvStorage;
+  char name[16];
+  uint8_t buffer[max_profile_size];
+  size_t size = 0;
+
+  KeyName(key, name);
+  if(nvStorage.begin(PROFILE_NAMESPACE, RO_MODE)) {
+    if(nvStorage.isKey(name)) {
+      size = nvStorage.getBytes(name, buffer, sizeof(buffer));
+    }
+    nvStorage.end();
+  }
+
+  return (size > 0) && polling_profile_decode(profile, maxErds, buffer, size);
+}
+
+bool polling_profile_save(uint32_t key, const polling_profile_t* profile)
+{
+  Preferences nvStorage;
+  char name[16];
+  uint8_t buffer[max_profile_size];
+  size_t size = polling_profile_encode(profile, buffer, sizeof(buffer));
+  size_t bytesWritten = 0;
+
+  KeyName(key, name);
+  if((size > 0) && nvStorage.begin(PROFILE_NAMESPACE, RW_MODE)) {
+    bytesWritten = nvStorage.putBytes(name, buffer, size);
+    nvStorage.end();
+  }
+
+  Serial.print("Saved " + String(bytesWritten) + " byte polling profile " + String(name) + "\n");
+  return bytesWritten == size;
+}
+
+void polling_profile_load_absent_erds(
+  uint32_t key,
+  uint32_t listHash,
+  uint8_t* absent,
+  uint8_t* missed,
+  size_t bitmapSize,
+  uint8_t* age)
+{
+  Preferences nvStorage;
+  char absentName[16];
+  char missedName[16];
+  char ageName[16];
+  char hashName[16];
+
+  memset(absent, 0, bitmapSize);
+  memset(missed, 0, bitmapSize);
+  *age = 0;
+
+  KeyName(key, absentName, 'a');
+  KeyName(key, missedName, 'm');
+  KeyName(key, ageName, 'g');
+  KeyName(key, hashName, 'h');
+  if(nvStorage.begin(PROFILE_NAMESPACE, RO_MODE)) {
+    if(nvStorage.isKey(hashName) && (nvStorage.getUInt(hashName, 0) == listHash) &&
+      (nvStorage.getBytesLength(absentName) == bitmapSize) &&
+      (nvStorage.getBytesLength(missedName) == bitmapSize)) {
+      nvStorage.getBytes(absentName, absent, bitmapSize);
+      nvStorage.getBytes(missedName, missed, bitmapSize);
+      *age = nvStorage.getUChar(ageName, 0);
+    }
+    nvStorage.end();
+  }
+}
+
+bool polling_profile_save_absent_erds(
+  uint32_t key,
+  uint32_t listHash,
+  const uint8_t* absent,
+  const uint8_t* missed,
+  size_t bitmapSize,
+  uint8_t age)
+{
+  Preferences nvStorage;
+  char absentName[16];
+  char missedName[16];
+  char ageName[16];
+  char hashName[16];
+  size_t bytesWritten = 0;
+
+  KeyName(key, absentName, 'a');
+  KeyName(key, missedName, 'm');
+  KeyName(key, ageName, 'g');
+  KeyName(key, hashName, 'h');
+  if(nvStorage.begin(PROFILE_NAMESPACE, RW_MODE)) {
+    bytesWritten = nvStorage.putBytes(absentName, absent, bitmapSize);
+    bytesWritten += nvStorage.putBytes(missedName, missed, bitmapSize);
+    nvStorage.putUChar(ageName, age);
+    nvStorage.putUInt(hashName, listHash);
+    nvStorage.end();
+  }
+
+  return bytesWritten == 2 * bitmapSize;
+}
@@ -0,0 +1,90 @@
+/*!
+ * @file
+ * @brief Known polling profiles: the discovered polling list for an appliance model, keyed by
+ * appliance type and model number and kept in non-volatile storage.
+ *
+ * Profiles are stored in a compact binary form that is also used to move them between
+ * adapters: a header followed by four bytes per ERD (big endian ERD number, data size, GEA2
+ * address of the board it is read from). Version 1 profiles without the address are still read.
+ */
+
+#ifndef PollingProfiles_h
+#define PollingProfiles_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "tiny_erd.h"
+
+#define POLLING_PROFILE_VERSION 2
+#define POLLING_PROFILE_HEADER_SIZE 6
+#define POLLING_PROFILE_ENTRY_SIZE 4
+#define POLLING_PROFILE_SIZE(erdCount) (POLLING_PROFILE_HEADER_SIZE + (erdCount) * POLLING_PROFILE_ENTRY_SIZE)
+
+typedef struct {
+  uint8_t applianceType;
+  uint8_t address;
+  uint16_t erdCount;
+  tiny_erd_t* erds;
+  uint8_t* sizes;
+  uint8_t* addresses;
+} polling_profile_t;
+
+/*!
+ * Key identifying an appliance model. Never 0, so 0 can be used for "no model known".
+ */
+uint32_t polling_profile_key(uint8_t applianceType, const void* modelNumber, uint8_t modelNumberSize);
+
+/*!
+ * Encode a profile into buffer. Returns the number of bytes written, or 0 if it does not fit.
+ */
+size_t polling_profile_encode(const polling_profile_t* profile, uint8_t* buffer, size_t bufferSize);
+
+/*!
+ * Total encoded size of the profile whose header is given, or 0 if the header is not valid.
+ */
+size_t polling_profile_encoded_size(const uint8_t* header);
+
+/*!
+ * Decode a profile into the erds, sizes and addresses arrays it points to, which hold maxErds entries.
+ * Returns false if the data is malformed or too long.
+ */
+bool polling_profile_decode(polling_profile_t* profile, uint16_t maxErds, const uint8_t* buffer, size_t size);
+
+/*!
+ * Load the stored profile for key. Returns false if there is none.
+ */
+bool polling_profile_load(uint32_t key, polling_profile_t* profile, uint16_t maxErds);
+
+/*!
+ * Store the profile for key, replacing any existing one.
+ */
+bool polling_profile_save(uint32_t key, const polling_profile_t* profile);
+
+/*!
+ * Load the bitmaps of candidates that did not answer for key, one bit per candidate index: absent
+ * holds those that missed twice, missed those that have missed once. Also loads their age.
+ * Clears the bitmaps and age if none are stored or they were made against a candidate list with
+ * a different hash.
+ */
+void polling_profile_load_absent_erds(
+  uint32_t key,
+  uint32_t listHash,
+  uint8_t* absent,
+  uint8_t* missed,
+  size_t bitmapSize,
+  uint8_t* age);
+
+/*!
+ * Store the bitmaps of candidates that did not answer for key, with the hash of the candidate
+ * list they index and their age.
+ */
+bool polling_profile_save_absent_erds(
+  uint32_t key,
+  uint32_t listHash,
+  const uint8_t* absent,
+  const uint8_t* missed,
+  size_t bitmapSize,
+  uint8_t age);
+
+#endif
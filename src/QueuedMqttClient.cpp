@@ -0,0 +1,216 @@
+/*!
+ * @file
+ * @brief
+ */
+
+#include <string.h>
+
+extern "C" {
+#include "QueuedMqttClient.h"
+#include "tiny_utils.h"
+}
+
+typedef QueuedMqttClient_t self_t;
+
+enum {
+  record_register_erd,
+  record_update_erd,
+  record_write_result,
+  record_sub_topic,
+  record_write_request,
+  record_disconnect
+};
+
+// Every record starts with its kind; ERD records follow it with the big endian ERD number
+enum {
+  kind_offset = 0,
+  erd_offset = 1,
+  erd_data_offset = 3,
+  sub_topic_length_offset = 1,
+  sub_topic_offset = 2
+};
+
+static bool PushOutbound(self_t* self, uint16_t size)
+{
+  if(!spsc_byte_queue_push(&self->outbound, self->outbound_record, size)) {
+    self->outbound_dropped++;
+    return false;
+  }
+  return true;
+}
+
+static void PushInbound(self_t* self, uint16_t size)
+{
+  if(!spsc_byte_queue_push(&self->inbound, self->inbound_record, size)) {
+    self->inbound_dropped++;
+  }
+}
+
+static void PutErd(uint8_t* record, uint8_t kind, tiny_erd_t erd)
+{
+  record[kind_offset] = kind;
+  record[erd_offset] = erd >> 8;
+  record[erd_offset + 1] = erd & 0xFF;
+}
+
+static tiny_erd_t GetErd(const uint8_t* record)
+{
+  return (record[erd_offset] << 8) | record[erd_offset + 1];
+}
+
+static void RegisterErd(i_mqtt_client_t* _self, tiny_erd_t erd)
+{
+  self_t* self = container_of(self_t, interface, _self);
+  PutErd(self->outbound_record, record_register_erd, erd);
+  PushOutbound(self, erd_data_offset);
+}
+
+static void UpdateErd(i_mqtt_client_t* _self, tiny_erd_t erd, const void* value, uint8_t size)
+{
+  self_t* self = container_of(self_t, interface, _self);
+  PutErd(self->outbound_record, record_update_erd, erd);
+  memcpy(&self->outbound_record[erd_data_offset], value, size);
+  if(!PushOutbound(self, erd_data_offset + size)) {
+    queued_mqtt_client_on_update_dropped_args_t args = { erd };
+    tiny_event_publish(&self->on_update_dropped, &args);
+  }
+}
+
+static void UpdateErdWriteResult(i_mqtt_client_t* _self, tiny_erd_t erd, bool success, uint8_t failure_reason)
+{
+  self_t* self = container_of(self_t, interface, _self);
+  PutErd(self->outbound_record, record_write_result, erd);
+  self->outbound_record[erd_data_offset] = success;
+  self->outbound_record[erd_data_offset + 1] = failure_reason;
+  PushOutbound(self, erd_data_offset + 2);
+}
+
+// Stored as the topic length, the topic and the payload, both NUL terminated
+static void PublishSubTopic(i_mqtt_client_t* _self, const char* sub_topic, const char* payload)
+{
+  self_t* self = container_of(self_t, interface, _self);
+  size_t topicSize = strlen(sub_topic) + 1;
+  size_t payloadSize = strlen(payload) + 1;
+  if((topicSize > UINT8_MAX) || (sub_topic_offset + topicSize + payloadSize > sizeof(self->outbound_record))) {
+    self->outbound_dropped++;
+    return;
+  }
+
+  self->outbound_record[kind_offset] = record_sub_topic;
+  self->outbound_record[sub_topic_length_offset] = topicSize;
+  memcpy(&self->outbound_record[sub_topic_offset], sub_topic, topicSize);
+  memcpy(&self->outbound_record[sub_topic_offset + topicSize], payload, payloadSize);
+  PushOutbound(self, sub_topic_offset + topicSize + payloadSize);
+}
+
+static i_tiny_event_t* OnWriteRequest(i_mqtt_client_t* _self)
+{
+  self_t* self = container_of(self_t, interface, _self);
+  return &self->on_write_request.interface;
+}
+
+static i_tiny_event_t* OnMqttDisconnect(i_mqtt_client_t* _self)
+{
+  self_t* self = container_of(self_t, interface, _self);
+  return &self->on_mqtt_disconnect.interface;
+}
+
+static const i_mqtt_client_api_t api = {
+  RegisterErd,
+  UpdateErd,
+  UpdateErdWriteResult,
+  PublishSubTopic,
+  OnWriteRequest,
+  OnMqttDisconnect
+};
+
+void queued_mqtt_client_init(self_t* self, i_mqtt_client_t* mqtt_client)
+{
+  self->interface.api = &api;
+  self->mqtt_client = mqtt_client;
+  self->outbound_dropped = 0;
+  self->inbound_dropped = 0;
+  spsc_byte_queue_init(&self->outbound, self->outbound_buffer, sizeof(self->outbound_buffer));
+  spsc_byte_queue_init(&self->inbound, self->inbound_buffer, sizeof(self->inbound_buffer));
+  tiny_event_init(&self->on_write_request);
+  tiny_event_init(&self->on_mqtt_disconnect);
+  tiny_event_init(&self->on_update_dropped);
+
+  tiny_event_subscription_init(
+    &self->write_request_subscription, self, +[](void* context, const void* _args) {
+      auto self = reinterpret_cast<self_t*>(context);
+      auto args = reinterpret_cast<const mqtt_client_on_write_request_args_t*>(_args);
+      PutErd(self->inbound_record, record_write_request, args->erd);
+      memcpy(&self->inbound_record[erd_data_offset], args->value, args->size);
+      PushInbound(self, erd_data_offset + args->size);
+    });
+  tiny_event_subscribe(mqtt_client_on_write_request(mqtt_client), &self->write_request_subscription);
+
+  tiny_event_subscription_init(
+    &self->disconnect_subscription, self, +[](void* context, const void*) {
+      auto self = reinterpret_cast<self_t*>(context);
+      self->inbound_record[kind_offset] = record_disconnect;
+      PushInbound(self, 1);
+    });
+  tiny_event_subscribe(mqtt_client_on_mqtt_disconnect(mqtt_client), &self->disconnect_subscription);
+}
+
+void queued_mqtt_client_run_bus(self_t* self)
+{
+  uint16_t size;
+  while((size = spsc_byte_queue_pop(&self->inbound, self->inbound_delivery, sizeof(self->inbound_delivery))) > 0) {
+    const uint8_t* record = self->inbound_delivery;
+
+    if(record[kind_offset] == record_write_request) {
+      mqtt_client_on_write_request_args_t args;
+      args.erd = GetErd(record);
+      args.size = size - erd_data_offset;
+      args.value = &record[erd_data_offset];
+      tiny_event_publish(&self->on_write_request, &args);
+    }
+    else if(record[kind_offset] == record_disconnect) {
+      tiny_event_publish(&self->on_mqtt_disconnect, nullptr);
+    }
+  }
+}
+
+void queued_mqtt_client_run_network(self_t* self)
+{
+  uint16_t size;
+  while((size = spsc_byte_queue_pop(&self->outbound, self->outbound_delivery, sizeof(self->outbound_delivery))) > 0) {
+    const uint8_t* record = self->outbound_delivery;
+
+    switch(record[kind_offset]) {
+      case record_register_erd:
+        mqtt_client_register_erd(self->mqtt_client, GetErd(record));
+        break;
+
+      case record_update_erd:
+        mqtt_client_update_erd(self->mqtt_client, GetErd(record), &record[erd_data_offset], size - erd_data_offset);
+        break;
+
+      case record_write_result:
+        mqtt_client_update_erd_write_result(
+          self->mqtt_client,
+          GetErd(record),
+          record[erd_data_offset],
+          record[erd_data_offset + 1]);
+        break;
+
+      case record_sub_topic: {
+        auto topic = reinterpret_cast<const char*>(&record[sub_topic_offset]);
+        mqtt_client_publish_sub_topic(self->mqtt_client, topic, topic + record[sub_topic_length_offset]);
+      } break;
+    }
+  }
+}
+
+i_tiny_event_t* queued_mqtt_client_on_update_dropped(self_t* self)
+{
+  return &self->on_update_dropped.interface;
+}
+
+uint32_t queued_mqtt_client_dropped(self_t* self)
+{
+  return self->outbound_dropped + self->inbound_dropped;
+}
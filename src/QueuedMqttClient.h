@@ -0,0 +1,80 @@
+/*!
+ * @file
+ * @brief Wraps an MQTT client so that the bridge and the network can run in different tasks.
+ *
+ * Calls made through the interface are queued and replayed on the wrapped client by
+ * queued_mqtt_client_run_network, from the task that owns the network. Write requests and
+ * disconnects raised by the wrapped client are queued the other way and raised again by
+ * queued_mqtt_client_run_bus, from the task that owns the bridge. Both queues are lock-free;
+ * records that do not fit are dropped and counted, and a dropped ERD update is raised so the
+ * caller can publish the value again later.
+ */
+
+#ifndef QueuedMqttClient_h
+#define QueuedMqttClient_h
+
+#include "SpscByteQueue.h"
+#include "i_mqtt_client.h"
+#include "tiny_event.h"
+
+#define QUEUED_MQTT_CLIENT_OUTBOUND_SIZE 8192
+#define QUEUED_MQTT_CLIENT_INBOUND_SIZE 1024
+#define QUEUED_MQTT_CLIENT_MAX_RECORD 2304
+#define QUEUED_MQTT_CLIENT_MAX_INBOUND_RECORD (3 + UINT8_MAX)
+
+typedef struct {
+  tiny_erd_t erd;
+} queued_mqtt_client_on_update_dropped_args_t;
+
+typedef struct {
+  i_mqtt_client_t interface;
+  i_mqtt_client_t* mqtt_client;
+  spsc_byte_queue_t outbound;
+  spsc_byte_queue_t inbound;
+  uint8_t outbound_buffer[QUEUED_MQTT_CLIENT_OUTBOUND_SIZE];
+  uint8_t inbound_buffer[QUEUED_MQTT_CLIENT_INBOUND_SIZE];
+  uint8_t outbound_record[QUEUED_MQTT_CLIENT_MAX_RECORD];
+  uint8_t outbound_delivery[QUEUED_MQTT_CLIENT_MAX_RECORD];
+  uint8_t inbound_record[QUEUED_MQTT_CLIENT_MAX_INBOUND_RECORD];
+  uint8_t inbound_delivery[QUEUED_MQTT_CLIENT_MAX_INBOUND_RECORD];
+  tiny_event_t on_write_request;
+  tiny_event_t on_mqtt_disconnect;
+  tiny_event_t on_update_dropped;
+  tiny_event_subscription_t write_request_subscription;
+  tiny_event_subscription_t disconnect_subscription;
+  uint32_t outbound_dropped;
+  uint32_t inbound_dropped;
+} QueuedMqttClient_t;
+
+/*!
+ * Initialize the queued client in front of mqtt_client.
+ */
+void queued_mqtt_client_init(
+  QueuedMqttClient_t* self,
+  i_mqtt_client_t* mqtt_client);
+
+/*!
+ * Raise the queued write requests and disconnects. Call from the bridge task.
+ */
+void queued_mqtt_client_run_bus(
+  QueuedMqttClient_t* self);
+
+/*!
+ * Pass the queued calls on to the wrapped client. Call from the network task.
+ */
+void queued_mqtt_client_run_network(
+  QueuedMqttClient_t* self);
+
+/*!
+ * Raised from the bridge task when an ERD update is dropped because the outbound queue is full.
+ */
+i_tiny_event_t* queued_mqtt_client_on_update_dropped(
+  QueuedMqttClient_t* self);
+
+/*!
+ * Records dropped in either direction because a queue was full.
+ */
+uint32_t queued_mqtt_client_dropped(
+  QueuedMqttClient_t* self);
+
+#endif
@@ -0,0 +1,77 @@
+/*!
+ * @file
+ * @brief
+ */
+
+extern "C" {
+#include "SpscByteQueue.h"
+}
+
+typedef spsc_byte_queue_t self_t;
+
+enum {
+  length_prefix_size = sizeof(uint16_t)
+};
+
+static uint16_t Advance(self_t* self, uint16_t index, uint16_t count)
+{
+  return (uint16_t)(((uint32_t)index + count) % self->size);
+}
+
+static void WriteBytes(self_t* self, uint16_t index, const uint8_t* data, uint16_t count)
+{
+  for(uint16_t i = 0; i < count; i++) {
+    self->buffer[Advance(self, index, i)] = data[i];
+  }
+}
+
+static void ReadBytes(self_t* self, uint16_t index, uint8_t* data, uint16_t count)
+{
+  for(uint16_t i = 0; i < count; i++) {
+    data[i] = self->buffer[Advance(self, index, i)];
+  }
+}
+
+void spsc_byte_queue_init(self_t* self, uint8_t* buffer, uint16_t size)
+{
+  self->buffer = buffer;
+  self->size = size;
+  self->head = 0;
+  self->tail = 0;
+}
+
+bool spsc_byte_queue_push(self_t* self, const void* record, uint16_t record_size)
+{
+  uint16_t head = self->head;
+  uint16_t tail = __atomic_load_n(&self->tail, __ATOMIC_ACQUIRE);
+  uint16_t used = (uint16_t)(((uint32_t)head + self->size - tail) % self->size);
+  uint16_t free = self->size - 1 - used;
+
+  if((uint32_t)length_prefix_size + record_size > free) {
+    return false;
+  }
+
+  uint8_t length[length_prefix_size] = { (uint8_t)(record_size >> 8), (uint8_t)(record_size & 0xFF) };
+  WriteBytes(self, head, length, length_prefix_size);
+  WriteBytes(self, Advance(self, head, length_prefix_size), (const uint8_t*)record, record_size);
+  __atomic_store_n(&self->head, Advance(self, head, length_prefix_size + record_size), __ATOMIC_RELEASE);
+  return true;
+}
+
+uint16_t spsc_byte_queue_pop(self_t* self, void* record, uint16_t record_size)
+{
+  uint16_t tail = self->tail;
+  uint16_t head = __atomic_load_n(&self->head, __ATOMIC_ACQUIRE);
+
+  if(head == tail) {
+    return 0;
+  }
+
+  uint8_t length[length_prefix_size];
+  ReadBytes(self, tail, length, length_prefix_size);
+  uint16_t stored = (length[0] << 8) | length[1];
+  uint16_t copied = (stored < record_size) ? stored : record_size;
+  ReadBytes(self, Advance(self, tail, length_prefix_size), (uint8_t*)record, copied);
+  __atomic_store_n(&self->tail, Advance(self, tail, length_prefix_size + stored), __ATOMIC_RELEASE);
+  return copied;
+}
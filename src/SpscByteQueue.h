@@ -0,0 +1,48 @@
+/*!
+ * @file
+ * @brief Lock-free queue of variable length records for one producer and one consumer.
+ *
+ * The producer only writes head and the consumer only writes tail, each published with release
+ * ordering, so the two sides may run in different tasks without a lock. Each record is stored
+ * with a two byte length prefix; one byte of the buffer is always left free.
+ */
+
+#ifndef SpscByteQueue_h
+#define SpscByteQueue_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+  uint8_t* buffer;
+  uint16_t size;
+  uint16_t head;
+  uint16_t tail;
+} spsc_byte_queue_t;
+
+/*!
+ * Initialize an empty queue in buffer.
+ */
+void spsc_byte_queue_init(
+  spsc_byte_queue_t* self,
+  uint8_t* buffer,
+  uint16_t size);
+
+/*!
+ * Append a record. Producer only. Returns false, leaving the queue unchanged, if it does not fit.
+ */
+bool spsc_byte_queue_push(
+  spsc_byte_queue_t* self,
+  const void* record,
+  uint16_t record_size);
+
+/*!
+ * Remove the oldest record and copy up to record_size bytes of it. Consumer only. Returns the
+ * number of bytes copied, or 0 if the queue is empty.
+ */
+uint16_t spsc_byte_queue_pop(
+  spsc_byte_queue_t* self,
+  void* record,
+  uint16_t record_size);
+
+#endif
@@ -2,15 +2,53 @@
 #include <PubSubClient.h>
 #include <WiFi.h>
 #include "Config.h"
+#include "Gea3Detector.h"
+#include "HomeAssistantBridge.h"
 #include "HomeAssistantGea2Bridge.h"
 
 #ifdef MQTT_TLS
-static WiFiClientSecure wifiClient;
+typedef WiFiClientSecure NetworkClient;
 #else
-static WiFiClient wifiClient;
+typedef WiFiClient NetworkClient;
+#endif
+
+// One appliance bus: its UART, its own MQTT connection (the MQTT client adapter owns the
+// PubSubClient callback) and whichever bridge suits the appliance. With MQTT_TLS a second bus
+// costs a second TLS session, mostly the mbedTLS record buffers, which the C3 has heap for.
+class ApplianceBus {
+ public:
+  ApplianceBus(HardwareSerial& uart, int8_t rxPin, int8_t txPin, const char* deviceId, const char* storageNamespace)
+    : uart(uart), rxPin(rxPin), txPin(txPin), deviceId(deviceId), storageNamespace(storageNamespace), mqttClient(wifiClient)
+  {
+  }
+
+  void begin();
+  void connectToMqtt();
+  void loop();
+
+ private:
+  void beginBridge();
+
+  HardwareSerial& uart;
+  int8_t rxPin;
+  int8_t txPin;
+  const char* deviceId;
+  const char* storageNamespace;
+
+  NetworkClient wifiClient;
+  PubSubClient mqttClient;
+
+  Gea3Detector gea3Detector;
+  HomeAssistantBridge gea3Bridge;
+  HomeAssistantGea2Bridge gea2Bridge;
+  bool bridgeStarted;
+  bool useGea3;
+};
+
+static ApplianceBus applianceBus(Serial1, D10, D9, deviceId, "storage");
+#ifdef SECOND_APPLIANCE
+static ApplianceBus secondApplianceBus(Serial0, D7, D6, secondDeviceId, "storage2");
 #endif
-static PubSubClient mqttClient(wifiClient);
-static HomeAssistantGea2Bridge bridge;
 
 static void connectToWifi()
 {
@@ -41,6 +79,11 @@ static void configureWifi()
 
   connectToWifi();
 
+  Serial.println("WiFi connected");
+}
+
+void ApplianceBus::begin()
+{
 #ifdef MQTT_TLS
 #ifdef MQTT_TLS_VERIFY
   X509List* cert = new X509List(CERT);
@@ -50,19 +93,34 @@ static void configureWifi()
 #endif
 #endif
 
-  Serial.println("WiFi connected");
+  mqttClient.setServer(mqtt_server, mqtt_server_port);
+
+  Serial.println("Appliance " + String(deviceId) + " startup");
+  uart.begin(HomeAssistantBridge::baud, SERIAL_8N1, rxPin, txPin);
+  bridgeStarted = false;
+  gea3Detector.begin(uart);
 }
 
-static void configureMqtt()
+// Called from loop() once GEA3 detection is done, so detecting on one bus does not hold up the others
+void ApplianceBus::beginBridge()
 {
-  mqttClient.setServer(mqtt_server, mqtt_server_port);
+  bridgeStarted = true;
+  useGea3 = gea3Detector.found();
+
+  if(useGea3) {
+    Serial.println("GEA3 appliance found, subscribing to all ERDs");
+    gea3Bridge.begin(mqttClient, uart, deviceId);
+  }
+  else {
+    Serial.println("No GEA3 reply, using GEA2 polling");
+    uart.end();
+    uart.begin(HomeAssistantGea2Bridge::baud, SERIAL_8N1, rxPin, txPin);
+    gea2Bridge.begin(mqttClient, uart, deviceId, 0xE4, storageNamespace);
+  }
 }
 
-static void connectToMqtt()
+void ApplianceBus::connectToMqtt()
 {
-  connectToWifi();
-  digitalWrite(LED_WIFI, HIGH);
-
   if(!mqttClient.connected()) {
     digitalWrite(LED_MQTT, LOW);
 
@@ -85,30 +143,71 @@ static void connectToMqtt()
       }
     }
 
-    bridge.notifyMqttDisconnected();
+    if(!bridgeStarted) {
+      return;
+    }
+
+    if(useGea3) {
+      gea3Bridge.notifyMqttDisconnected();
+    }
+    else {
+      gea2Bridge.notifyMqttDisconnected();
+    }
   }
 }
 
+void ApplianceBus::loop()
+{
+  if(!bridgeStarted) {
+    gea3Detector.run();
+
+    if(gea3Detector.done()) {
+      beginBridge();
+    }
+  }
+  else if(useGea3) {
+    gea3Bridge.loop();
+  }
+  else {
+    gea2Bridge.loop();
+  }
+}
+
+static void connectToMqtt()
+{
+  connectToWifi();
+  digitalWrite(LED_WIFI, HIGH);
+
+  applianceBus.connectToMqtt();
+#ifdef SECOND_APPLIANCE
+  secondApplianceBus.connectToMqtt();
+#endif
+}
+
 void setup()
 {
   Serial.begin(115200);
   Serial.println();
-  Serial.println("GEA2 adapter startup");
+  Serial.println("GEA adapter startup");
 
   pinMode(LED_HEARTBEAT, OUTPUT);
   pinMode(LED_WIFI, OUTPUT);
   pinMode(LED_MQTT, OUTPUT);
 
   configureWifi();
-  configureMqtt();
 
-  Serial1.begin(HomeAssistantGea2Bridge::baud, SERIAL_8N1, D10, D9);
-  bridge.begin(mqttClient, Serial1, deviceId);
+  applianceBus.begin();
+#ifdef SECOND_APPLIANCE
+  secondApplianceBus.begin();
+#endif
 }
 
 void loop()
 {
   connectToMqtt();
-  bridge.loop();
+  applianceBus.loop();
+#ifdef SECOND_APPLIANCE
+  secondApplianceBus.loop();
+#endif
   digitalWrite(LED_HEARTBEAT, millis() % 1000 < 500);
 }
@@ -0,0 +1,253 @@
+/*!
+ * @file
+ * @brief Candidate ERD tables: how the lists are merged per appliance type, looked up, scored and
+ * iterated, and the poll rates of each type.
+ */
+
+#include <cstring>
+#include <unity.h>
+
+extern "C" {
+#include "ApplianceErds.h"
+}
+
+enum {
+  appliance_type_water_heater = 0x00,
+  appliance_type_clothes_washer = 0x01,
+  appliance_type_clothes_dryer = 0x02,
+  appliance_type_refrigerator = 0x03,
+  appliance_type_dishwasher = 0x06,
+  appliance_type_delivery_box = 0x12,
+  appliance_type_ble_mesh_gateway = 0x25,
+  appliance_type_combination_washer_dryer = 0x17,
+  appliance_type_dish_drawer = 0x20,
+  appliance_type_smart_plug = 0x2A,
+  appliance_type_last = 0x36,
+  appliance_type_unknown = 0xFF
+};
+
+// Unscored ERDs, so the iterator returns them in list order
+static const erd_range_t ranges[] = {
+  { 0x2100, 3 },
+  { 0x2110, 1 },
+  { 0x2200, 2 }
+};
+
+static const erd_range_list_t sample = { ranges, 3, 6, nullptr, 0 };
+
+static bool ListHasErdIn(const erd_range_list_t* list, tiny_erd_t first, uint16_t count)
+{
+  for(uint32_t erd = first; erd < (uint32_t)first + count; erd++) {
+    if(ErdRangeListContains(list, erd)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void should_store_every_list_as_sorted_runs_of_consecutive_erds()
+{
+  for(uint16_t type = 0; type <= appliance_type_last; type++) {
+    const erd_range_list_t* list = GetApplianceErdList(type);
+    uint16_t erdCount = 0;
+
+    TEST_ASSERT_GREATER_THAN_UINT16(0, list->rangeCount);
+    for(uint16_t range = 0; range < list->rangeCount; range++) {
+      TEST_ASSERT_GREATER_THAN_UINT16(0, list->ranges[range].count);
+      if(range > 0) {
+        // Strictly after the end of the previous run, and not adjacent to it
+        const erd_range_t* previous = &list->ranges[range - 1];
+        TEST_ASSERT_GREATER_THAN_UINT32(previous->first + previous->count, list->ranges[range].first);
+      }
+      erdCount += list->ranges[range].count;
+    }
+    TEST_ASSERT_EQUAL_UINT16(erdCount, list->erdCount);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT16(APPLIANCE_ERD_CANDIDATES_MAX, list->erdCount);
+  }
+}
+
+static void should_include_the_common_and_energy_erds_in_every_family()
+{
+  for(uint16_t type = 0; type <= appliance_type_last; type++) {
+    TEST_ASSERT_TRUE(IsApplianceErdCandidate(type, 0x0001));
+    TEST_ASSERT_TRUE(IsApplianceErdCandidate(type, 0x0052));
+    if(type != appliance_type_ble_mesh_gateway) {
+      TEST_ASSERT_TRUE(IsApplianceErdCandidate(type, 0xD001));
+    }
+  }
+}
+
+static void should_include_the_family_erds()
+{
+  TEST_ASSERT_TRUE(IsApplianceErdCandidate(appliance_type_water_heater, 0x4008));
+  TEST_ASSERT_FALSE(IsApplianceErdCandidate(appliance_type_water_heater, 0x1000));
+  TEST_ASSERT_TRUE(IsApplianceErdCandidate(appliance_type_refrigerator, 0x1000));
+  TEST_ASSERT_FALSE(IsApplianceErdCandidate(appliance_type_refrigerator, 0x4008));
+}
+
+static void should_leave_out_the_excluded_blocks()
+{
+  const erd_range_list_t* refrigerator = GetApplianceErdList(appliance_type_refrigerator);
+  const erd_range_list_t* deliveryBox = GetApplianceErdList(appliance_type_delivery_box);
+  TEST_ASSERT_TRUE(ListHasErdIn(refrigerator, 0x1100, 0x0400));
+  TEST_ASSERT_FALSE(ListHasErdIn(deliveryBox, 0x1100, 0x0400));
+  TEST_ASSERT_TRUE(IsApplianceErdCandidate(appliance_type_delivery_box, 0x1000));
+
+  const erd_range_list_t* smartPlug = GetApplianceErdList(appliance_type_smart_plug);
+  TEST_ASSERT_FALSE(ListHasErdIn(smartPlug, 0x9000, 0x0600));
+  TEST_ASSERT_TRUE(IsApplianceErdCandidate(appliance_type_smart_plug, 0xD001));
+
+  const erd_range_list_t* gateway = GetApplianceErdList(appliance_type_ble_mesh_gateway);
+  TEST_ASSERT_FALSE(ListHasErdIn(gateway, 0x9000, 0x0600));
+  TEST_ASSERT_FALSE(ListHasErdIn(gateway, 0xD000, 0x0300));
+  TEST_ASSERT_TRUE(IsApplianceErdCandidate(appliance_type_ble_mesh_gateway, 0x0001));
+}
+
+static void should_use_the_first_family_for_unknown_appliance_types()
+{
+  TEST_ASSERT_EQUAL_PTR(GetApplianceErdList(appliance_type_water_heater), GetApplianceErdList(appliance_type_last + 1));
+  TEST_ASSERT_EQUAL_PTR(GetApplianceErdList(appliance_type_water_heater), GetApplianceErdList(appliance_type_unknown));
+}
+
+static void should_find_only_the_erds_in_the_ranges()
+{
+  TEST_ASSERT_TRUE(ErdRangeListContains(&sample, 0x2100));
+  TEST_ASSERT_TRUE(ErdRangeListContains(&sample, 0x2102));
+  TEST_ASSERT_TRUE(ErdRangeListContains(&sample, 0x2110));
+  TEST_ASSERT_TRUE(ErdRangeListContains(&sample, 0x2201));
+
+  TEST_ASSERT_FALSE(ErdRangeListContains(&sample, 0x0000));
+  TEST_ASSERT_FALSE(ErdRangeListContains(&sample, 0x20FF));
+  TEST_ASSERT_FALSE(ErdRangeListContains(&sample, 0x2103));
+  TEST_ASSERT_FALSE(ErdRangeListContains(&sample, 0x210F));
+  TEST_ASSERT_FALSE(ErdRangeListContains(&sample, 0x2111));
+  TEST_ASSERT_FALSE(ErdRangeListContains(&sample, 0x2202));
+  TEST_ASSERT_FALSE(ErdRangeListContains(&sample, 0xFFFF));
+}
+
+static void should_find_nothing_in_an_empty_list()
+{
+  const erd_range_list_t empty = { ranges, 0, 0, nullptr, 0 };
+  TEST_ASSERT_FALSE(ErdRangeListContains(&empty, 0x2100));
+}
+
+static void should_iterate_over_every_erd_in_order()
+{
+  const tiny_erd_t expected[] = { 0x2100, 0x2101, 0x2102, 0x2110, 0x2200, 0x2201 };
+  erd_range_iterator_t iterator;
+  tiny_erd_t erd;
+
+  ErdRangeIteratorInit(&iterator, &sample);
+  for(uint16_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+    TEST_ASSERT_TRUE(ErdRangeIteratorNext(&iterator, &erd));
+    TEST_ASSERT_EQUAL_HEX16(expected[i], erd);
+    TEST_ASSERT_EQUAL_UINT16(i, iterator.index);
+    TEST_ASSERT_EQUAL_UINT16(i + 1, iterator.position);
+  }
+  TEST_ASSERT_FALSE(ErdRangeIteratorNext(&iterator, &erd));
+  TEST_ASSERT_FALSE(ErdRangeIteratorNext(&iterator, &erd));
+}
+
+static void should_score_the_blocks_at_the_start_of_the_lists()
+{
+  TEST_ASSERT_EQUAL_UINT8(250, GetErdScore(0x0001));
+  TEST_ASSERT_EQUAL_UINT8(250, GetErdScore(0x0008));
+  TEST_ASSERT_EQUAL_UINT8(100, GetErdScore(0x0030));
+  TEST_ASSERT_EQUAL_UINT8(100, GetErdScore(0x0052));
+  TEST_ASSERT_EQUAL_UINT8(0, GetErdScore(0x0053));
+
+  TEST_ASSERT_EQUAL_UINT8(0, GetErdScore(0x4000));
+  TEST_ASSERT_EQUAL_UINT8(200, GetErdScore(0x4008));
+  TEST_ASSERT_EQUAL_UINT8(200, GetErdScore(0x4041));
+  TEST_ASSERT_EQUAL_UINT8(0, GetErdScore(0x4047));
+
+  TEST_ASSERT_EQUAL_UINT8(200, GetErdScore(0x1000));
+  TEST_ASSERT_EQUAL_UINT8(0, GetErdScore(0x2100));
+  TEST_ASSERT_EQUAL_UINT8(150, GetErdScore(0xD001));
+  TEST_ASSERT_EQUAL_UINT8(0, GetErdScore(0xD100));
+}
+
+static void should_probe_scored_erds_first_and_every_erd_once()
+{
+  for(uint16_t type = 0; type <= appliance_type_last; type++) {
+    const erd_range_list_t* list = GetApplianceErdList(type);
+    static uint8_t seen[APPLIANCE_ERD_CANDIDATES_MAX];
+    erd_range_iterator_t iterator;
+    tiny_erd_t erd;
+    tiny_erd_t previous = 0;
+    uint8_t previousScore = UINT8_MAX;
+    uint16_t count = 0;
+
+    memset(seen, 0, sizeof(seen));
+    ErdRangeIteratorInit(&iterator, list);
+    while(ErdRangeIteratorNext(&iterator, &erd)) {
+      uint8_t score = GetErdScore(erd);
+      TEST_ASSERT_TRUE(ErdRangeListContains(list, erd));
+      TEST_ASSERT_LESS_THAN_UINT32(list->erdCount, iterator.index);
+      TEST_ASSERT_EQUAL_UINT8(0, seen[iterator.index]);
+      seen[iterator.index] = 1;
+
+      if(count < list->priorityCount) {
+        // By descending score, and ascending ERD within a score
+        TEST_ASSERT_GREATER_THAN_UINT8(0, score);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT8(previousScore, score);
+        if(score == previousScore) {
+          TEST_ASSERT_GREATER_THAN_UINT32(previous, erd);
+        }
+      }
+      else {
+        TEST_ASSERT_EQUAL_UINT8(0, score);
+        if(count > list->priorityCount) {
+          TEST_ASSERT_GREATER_THAN_UINT32(previous, erd);
+        }
+      }
+      previous = erd;
+      previousScore = score;
+      count++;
+      TEST_ASSERT_EQUAL_UINT16(count, iterator.position);
+    }
+    TEST_ASSERT_EQUAL_UINT16(list->erdCount, count);
+  }
+}
+
+static void should_watch_the_state_of_laundry_and_dishwashers_only()
+{
+  const uint8_t laundry[] = { appliance_type_clothes_washer, appliance_type_clothes_dryer, appliance_type_combination_washer_dryer };
+  for(auto type : laundry) {
+    TEST_ASSERT_EQUAL_HEX16(0x2000, GetAppliancePollRates(type)->stateErd);
+    TEST_ASSERT_EQUAL_UINT16(30, GetAppliancePollRates(type)->cyclePeriod[poll_rate_idle]);
+  }
+
+  TEST_ASSERT_EQUAL_HEX16(0x3001, GetAppliancePollRates(appliance_type_dishwasher)->stateErd);
+  TEST_ASSERT_EQUAL_HEX16(0x3001, GetAppliancePollRates(appliance_type_dish_drawer)->stateErd);
+
+  TEST_ASSERT_EQUAL_HEX16(0x0000, GetAppliancePollRates(appliance_type_water_heater)->stateErd);
+  TEST_ASSERT_EQUAL_HEX16(0x0000, GetAppliancePollRates(appliance_type_refrigerator)->stateErd);
+  TEST_ASSERT_EQUAL_HEX16(0x0000, GetAppliancePollRates(appliance_type_smart_plug)->stateErd);
+  TEST_ASSERT_EQUAL_PTR(GetAppliancePollRates(appliance_type_water_heater), GetAppliancePollRates(appliance_type_unknown));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(should_store_every_list_as_sorted_runs_of_consecutive_erds);
+  RUN_TEST(should_include_the_common_and_energy_erds_in_every_family);
+  RUN_TEST(should_include_the_family_erds);
+  RUN_TEST(should_leave_out_the_excluded_blocks);
+  RUN_TEST(should_use_the_first_family_for_unknown_appliance_types);
+  RUN_TEST(should_find_only_the_erds_in_the_ranges);
+  RUN_TEST(should_find_nothing_in_an_empty_list);
+  RUN_TEST(should_iterate_over_every_erd_in_order);
+  RUN_TEST(should_score_the_blocks_at_the_start_of_the_lists);
+  RUN_TEST(should_probe_scored_erds_first_and_every_erd_once);
+  RUN_TEST(should_watch_the_state_of_laundry_and_dishwashers_only);
+  return UNITY_END();
+}
@@ -0,0 +1,206 @@
+/*!
+ * @file
+ * @brief Bus sniffer: which packets are decoded and the ERD values reported from them.
+ */
+
+#include <cstring>
+#include <unity.h>
+
+extern "C" {
+#include "Gea2BusSniffer.h"
+#include "tiny_gea_constants.h"
+}
+
+enum {
+  client_address = 0xE4,
+  machine_control = 0xC0,
+  user_interface = 0xC8,
+  read_command = 0xF0,
+  write_command = 0xF1,
+  publication_command = 0xF5,
+  max_erds = 8
+};
+
+typedef union {
+  tiny_gea_packet_t packet;
+  uint8_t buffer[sizeof(tiny_gea_packet_t) + UINT8_MAX];
+} packet_buffer_t;
+
+static struct {
+  i_tiny_gea_interface_t interface;
+  tiny_event_t on_receive;
+} bus;
+
+static struct {
+  uint8_t address;
+  tiny_erd_t erd;
+  uint8_t data_size;
+  uint8_t data[UINT8_MAX];
+} erds[max_erds];
+static uint8_t erdCount;
+
+static Gea2BusSniffer_t sniffer;
+static tiny_event_subscription_t erd_subscription;
+
+static bool Send(i_tiny_gea_interface_t*, uint8_t, uint8_t, void*, tiny_gea_interface_send_callback_t)
+{
+  return false;
+}
+
+static bool Forward(i_tiny_gea_interface_t*, uint8_t, uint8_t, void*, tiny_gea_interface_send_callback_t)
+{
+  return false;
+}
+
+static i_tiny_event_t* OnReceive(i_tiny_gea_interface_t*)
+{
+  return &bus.on_receive.interface;
+}
+
+static const i_tiny_gea_interface_api_t bus_api = { Send, Forward, OnReceive };
+
+static void ErdHeard(void*, const void* _args)
+{
+  auto args = reinterpret_cast<const gea2_bus_sniffer_on_erd_args_t*>(_args);
+  if(erdCount < max_erds) {
+    erds[erdCount].address = args->address;
+    erds[erdCount].erd = args->erd;
+    erds[erdCount].data_size = args->data_size;
+    memcpy(erds[erdCount].data, args->data, args->data_size);
+    erdCount++;
+  }
+}
+
+static void Receive(uint8_t source, uint8_t destination, const uint8_t* payload, uint8_t payloadLength)
+{
+  packet_buffer_t packet;
+  packet.packet.source = source;
+  packet.packet.destination = destination;
+  packet.packet.payload_length = payloadLength;
+  memcpy(packet.packet.payload, payload, payloadLength);
+  tiny_gea_interface_on_receive_args_t args = { &packet.packet };
+  tiny_event_publish(&bus.on_receive, &args);
+}
+
+static void AssertErdHeard(uint8_t index, uint8_t address, tiny_erd_t erd, const uint8_t* data, uint8_t size)
+{
+  TEST_ASSERT_GREATER_THAN_UINT32(index, erdCount);
+  TEST_ASSERT_EQUAL_HEX8(address, erds[index].address);
+  TEST_ASSERT_EQUAL_HEX16(erd, erds[index].erd);
+  TEST_ASSERT_EQUAL_UINT8(size, erds[index].data_size);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(data, erds[index].data, size);
+}
+
+void setUp()
+{
+  bus.interface.api = &bus_api;
+  tiny_event_init(&bus.on_receive);
+  erdCount = 0;
+
+  gea2_bus_sniffer_init(&sniffer, &bus.interface, client_address);
+  tiny_event_subscription_init(&erd_subscription, nullptr, ErdHeard);
+  tiny_event_subscribe(gea2_bus_sniffer_on_erd(&sniffer), &erd_subscription);
+}
+
+void tearDown()
+{
+}
+
+static void should_report_every_erd_of_a_read_response_between_other_nodes()
+{
+  const uint8_t response[] = { read_command, 2, 0x40, 0x24, 2, 0x12, 0x34, 0x40, 0x09, 1, 0x01 };
+  const uint8_t first[] = { 0x12, 0x34 };
+  const uint8_t second[] = { 0x01 };
+
+  Receive(machine_control, user_interface, response, sizeof(response));
+
+  TEST_ASSERT_EQUAL_UINT8(2, erdCount);
+  AssertErdHeard(0, machine_control, 0x4024, first, sizeof(first));
+  AssertErdHeard(1, machine_control, 0x4009, second, sizeof(second));
+}
+
+static void should_report_a_write_request_as_a_value_of_the_node_written_to()
+{
+  const uint8_t request[] = { write_command, 1, 0x40, 0x09, 1, 0x02 };
+  const uint8_t value[] = { 0x02 };
+
+  Receive(user_interface, machine_control, request, sizeof(request));
+
+  TEST_ASSERT_EQUAL_UINT8(1, erdCount);
+  AssertErdHeard(0, machine_control, 0x4009, value, sizeof(value));
+}
+
+static void should_ignore_broadcast_writes()
+{
+  const uint8_t request[] = { write_command, 1, 0x40, 0x09, 1, 0x02 };
+
+  Receive(user_interface, tiny_gea_broadcast_address, request, sizeof(request));
+
+  TEST_ASSERT_EQUAL_UINT8(0, erdCount);
+}
+
+static void should_report_publications_to_anyone()
+{
+  const uint8_t publication[] = { publication_command, 1, 0x40, 0x24, 2, 0x00, 0x78 };
+  const uint8_t value[] = { 0x00, 0x78 };
+
+  Receive(machine_control, tiny_gea_broadcast_address, publication, sizeof(publication));
+  Receive(machine_control, client_address, publication, sizeof(publication));
+
+  TEST_ASSERT_EQUAL_UINT8(2, erdCount);
+  AssertErdHeard(0, machine_control, 0x4024, value, sizeof(value));
+  AssertErdHeard(1, machine_control, 0x4024, value, sizeof(value));
+}
+
+static void should_leave_traffic_of_the_client_to_the_client()
+{
+  const uint8_t response[] = { read_command, 1, 0x40, 0x24, 2, 0x12, 0x34 };
+  const uint8_t request[] = { write_command, 1, 0x40, 0x09, 1, 0x02 };
+
+  Receive(machine_control, client_address, response, sizeof(response));
+  Receive(client_address, machine_control, request, sizeof(request));
+
+  TEST_ASSERT_EQUAL_UINT8(0, erdCount);
+}
+
+static void should_ignore_packets_whose_erds_do_not_fill_the_payload()
+{
+  const uint8_t readRequest[] = { read_command, 1, 0x40, 0x24 };
+  const uint8_t noErds[] = { read_command, 0 };
+  const uint8_t truncated[] = { read_command, 2, 0x40, 0x24, 2, 0x12, 0x34, 0x40, 0x09, 1 };
+  const uint8_t trailing[] = { read_command, 1, 0x40, 0x24, 2, 0x12, 0x34, 0x00 };
+  const uint8_t headerOnly[] = { read_command };
+
+  Receive(user_interface, machine_control, readRequest, sizeof(readRequest));
+  Receive(machine_control, user_interface, noErds, sizeof(noErds));
+  Receive(machine_control, user_interface, truncated, sizeof(truncated));
+  Receive(machine_control, user_interface, trailing, sizeof(trailing));
+  Receive(machine_control, user_interface, headerOnly, sizeof(headerOnly));
+  Receive(machine_control, user_interface, headerOnly, 0);
+
+  TEST_ASSERT_EQUAL_UINT8(0, erdCount);
+}
+
+static void should_ignore_other_commands()
+{
+  const uint8_t version[] = { 0x01, 0x00, 0x03, 0x00, 0x01 };
+  const uint8_t subscribe[] = { 0xF4, 1, 0x40, 0x24, 2, 0x12, 0x34 };
+
+  Receive(machine_control, user_interface, version, sizeof(version));
+  Receive(machine_control, user_interface, subscribe, sizeof(subscribe));
+
+  TEST_ASSERT_EQUAL_UINT8(0, erdCount);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(should_report_every_erd_of_a_read_response_between_other_nodes);
+  RUN_TEST(should_report_a_write_request_as_a_value_of_the_node_written_to);
+  RUN_TEST(should_ignore_broadcast_writes);
+  RUN_TEST(should_report_publications_to_anyone);
+  RUN_TEST(should_leave_traffic_of_the_client_to_the_client);
+  RUN_TEST(should_ignore_packets_whose_erds_do_not_fill_the_payload);
+  RUN_TEST(should_ignore_other_commands);
+  return UNITY_END();
+}
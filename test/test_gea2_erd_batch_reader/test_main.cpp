@@ -0,0 +1,403 @@
+/*!
+ * @file
+ * @brief Batched ERD reads: the request sent, which responses are accepted, and retries.
+ */
+
+#include <cstring>
+#include <unity.h>
+
+extern "C" {
+#include "Gea2ErdBatchReader.h"
+#include "Gea2RoundTripEstimator.h"
+#include "tiny_timer.h"
+#include "tiny_utils.h"
+}
+
+enum {
+  client_address = 0xE4,
+  node_address = 0xC0,
+  other_address = 0xC8,
+  read_command = 0xF0,
+  receive_buffer_size = 255,
+  request_retries = 2,
+  initial_timeout = 250,
+  max_timeout = 500,
+  deviations = 4,
+  max_activities = 16
+};
+
+typedef union {
+  tiny_gea_packet_t packet;
+  uint8_t buffer[sizeof(tiny_gea_packet_t) + UINT8_MAX];
+} packet_buffer_t;
+
+static struct {
+  i_tiny_time_source_t interface;
+  tiny_time_source_ticks_t ticks;
+} time_source;
+
+static struct {
+  i_tiny_gea_interface_t interface;
+  tiny_event_t on_receive;
+  packet_buffer_t sent;
+  uint8_t sendCount;
+} bus;
+
+static struct {
+  gea2_erd_batch_reader_on_activity_args_t args;
+  tiny_erd_t erd;
+  uint8_t data[UINT8_MAX];
+} activities[max_activities];
+static uint8_t activityCount;
+
+static tiny_timer_group_t timer_group;
+static Gea2RoundTripEstimator_t round_trip_estimator;
+static Gea2ErdBatchReader_t reader;
+static tiny_event_subscription_t activity_subscription;
+
+static tiny_time_source_ticks_t Ticks(i_tiny_time_source_t*)
+{
+  return time_source.ticks;
+}
+
+static const i_tiny_time_source_api_t time_source_api = { Ticks };
+
+static bool Send(
+  i_tiny_gea_interface_t*,
+  uint8_t destination,
+  uint8_t payload_length,
+  void* context,
+  tiny_gea_interface_send_callback_t callback)
+{
+  bus.sent.packet.destination = destination;
+  bus.sent.packet.payload_length = payload_length;
+  bus.sent.packet.source = client_address;
+  callback(context, &bus.sent.packet);
+  bus.sendCount++;
+  return true;
+}
+
+static bool Forward(i_tiny_gea_interface_t*, uint8_t, uint8_t, void*, tiny_gea_interface_send_callback_t)
+{
+  return false;
+}
+
+static i_tiny_event_t* OnReceive(i_tiny_gea_interface_t*)
+{
+  return &bus.on_receive.interface;
+}
+
+static const i_tiny_gea_interface_api_t bus_api = { Send, Forward, OnReceive };
+
+static void ActivityRaised(void*, const void* _args)
+{
+  auto args = reinterpret_cast<const gea2_erd_batch_reader_on_activity_args_t*>(_args);
+  if(activityCount < max_activities) {
+    activities[activityCount].args = *args;
+    if(args->type == gea2_erd_batch_reader_activity_type_read_completed) {
+      memcpy(activities[activityCount].data, args->read_completed.data, args->read_completed.data_size);
+    }
+    activityCount++;
+  }
+}
+
+static void After(tiny_time_source_ticks_t ticks)
+{
+  while(ticks-- > 0) {
+    time_source.ticks++;
+    tiny_timer_group_run(&timer_group);
+  }
+}
+
+// Runs until the outstanding attempt times out: the request is sent again or the batch fails
+static void AfterTimeout()
+{
+  uint8_t sendCount = bus.sendCount;
+  uint8_t raised = activityCount;
+  tiny_time_source_ticks_t longest = max_timeout + gea2_round_trip_estimator_wire_time(receive_buffer_size * 2);
+  for(tiny_time_source_ticks_t waited = 0; (bus.sendCount == sendCount) && (activityCount == raised); waited++) {
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(longest, waited);
+    After(1);
+  }
+}
+
+static void Receive(uint8_t source, uint8_t destination, const uint8_t* payload, uint8_t payloadLength)
+{
+  packet_buffer_t packet;
+  packet.packet.source = source;
+  packet.packet.destination = destination;
+  packet.packet.payload_length = payloadLength;
+  memcpy(packet.packet.payload, payload, payloadLength);
+  tiny_gea_interface_on_receive_args_t args = { &packet.packet };
+  tiny_event_publish(&bus.on_receive, &args);
+}
+
+static void Read(const tiny_erd_t* erds, uint8_t count)
+{
+  TEST_ASSERT_TRUE(gea2_erd_batch_reader_read(&reader, node_address, erds, nullptr, count));
+}
+
+void setUp()
+{
+  time_source.interface.api = &time_source_api;
+  time_source.ticks = 0;
+  bus.interface.api = &bus_api;
+  bus.sendCount = 0;
+  tiny_event_init(&bus.on_receive);
+  activityCount = 0;
+
+  tiny_timer_group_init(&timer_group, &time_source.interface);
+  gea2_round_trip_estimator_init(&round_trip_estimator, initial_timeout, max_timeout, deviations);
+  gea2_erd_batch_reader_init(
+    &reader,
+    &timer_group,
+    &bus.interface,
+    client_address,
+    receive_buffer_size,
+    &round_trip_estimator,
+    request_retries);
+  tiny_event_subscription_init(&activity_subscription, nullptr, ActivityRaised);
+  tiny_event_subscribe(gea2_erd_batch_reader_on_activity(&reader), &activity_subscription);
+}
+
+void tearDown()
+{
+}
+
+static void should_send_one_request_with_every_erd()
+{
+  const tiny_erd_t erds[] = { 0x0001, 0x4024, 0x4025 };
+  Read(erds, element_count(erds));
+
+  const uint8_t expected[] = { read_command, 3, 0x00, 0x01, 0x40, 0x24, 0x40, 0x25 };
+  TEST_ASSERT_EQUAL_UINT8(1, bus.sendCount);
+  TEST_ASSERT_EQUAL_HEX8(node_address, bus.sent.packet.destination);
+  TEST_ASSERT_EQUAL_UINT8(sizeof(expected), bus.sent.packet.payload_length);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, bus.sent.packet.payload, sizeof(expected));
+  TEST_ASSERT_TRUE(gea2_erd_batch_reader_busy(&reader));
+}
+
+static void should_reject_a_second_batch_while_one_is_outstanding()
+{
+  const tiny_erd_t erds[] = { 0x4024 };
+  Read(erds, element_count(erds));
+  TEST_ASSERT_FALSE(gea2_erd_batch_reader_read(&reader, node_address, erds, nullptr, element_count(erds)));
+  TEST_ASSERT_EQUAL_UINT8(1, bus.sendCount);
+}
+
+static void should_reject_empty_and_oversized_batches()
+{
+  tiny_erd_t erds[GEA2_ERD_BATCH_READER_MAX_ERDS + 1] = {};
+  TEST_ASSERT_FALSE(gea2_erd_batch_reader_read(&reader, node_address, erds, nullptr, 0));
+  TEST_ASSERT_FALSE(gea2_erd_batch_reader_read(&reader, node_address, erds, nullptr, element_count(erds)));
+  TEST_ASSERT_EQUAL_UINT8(0, bus.sendCount);
+}
+
+static void should_raise_each_erd_read_and_then_the_batch()
+{
+  const tiny_erd_t erds[] = { 0x4024, 0x4025 };
+  Read(erds, element_count(erds));
+
+  const uint8_t response[] = { read_command, 2, 0x40, 0x24, 2, 0x12, 0x34, 0x40, 0x25, 1, 0x56 };
+  Receive(node_address, client_address, response, sizeof(response));
+
+  TEST_ASSERT_EQUAL_UINT8(3, activityCount);
+  TEST_ASSERT_EQUAL_UINT8(gea2_erd_batch_reader_activity_type_read_completed, activities[0].args.type);
+  TEST_ASSERT_EQUAL_HEX16(0x4024, activities[0].args.read_completed.erd);
+  TEST_ASSERT_EQUAL_UINT8(2, activities[0].args.read_completed.data_size);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(&response[5], activities[0].data, 2);
+  TEST_ASSERT_EQUAL_HEX16(0x4025, activities[1].args.read_completed.erd);
+  TEST_ASSERT_EQUAL_UINT8(1, activities[1].args.read_completed.data_size);
+  TEST_ASSERT_EQUAL_HEX8(0x56, activities[1].data[0]);
+
+  TEST_ASSERT_EQUAL_UINT8(gea2_erd_batch_reader_activity_type_batch_completed, activities[2].args.type);
+  TEST_ASSERT_EQUAL_HEX8(node_address, activities[2].args.address);
+  TEST_ASSERT_EQUAL_UINT8(2, activities[2].args.batch_completed.erd_count);
+  TEST_ASSERT_EQUAL_UINT8(2, activities[2].args.batch_completed.erds_read);
+  TEST_ASSERT_FALSE(gea2_erd_batch_reader_busy(&reader));
+}
+
+static void should_accept_a_response_with_only_some_of_the_erds()
+{
+  const tiny_erd_t erds[] = { 0x4024, 0x4025, 0x4026 };
+  Read(erds, element_count(erds));
+
+  const uint8_t response[] = { read_command, 1, 0x40, 0x25, 1, 0x56 };
+  Receive(node_address, client_address, response, sizeof(response));
+
+  TEST_ASSERT_EQUAL_UINT8(2, activityCount);
+  TEST_ASSERT_EQUAL_HEX16(0x4025, activities[0].args.read_completed.erd);
+  TEST_ASSERT_EQUAL_UINT8(3, activities[1].args.batch_completed.erd_count);
+  TEST_ASSERT_EQUAL_UINT8(1, activities[1].args.batch_completed.erds_read);
+}
+
+static void should_ignore_responses_from_other_nodes_or_to_other_clients()
+{
+  const tiny_erd_t erds[] = { 0x4024 };
+  Read(erds, element_count(erds));
+
+  const uint8_t response[] = { read_command, 1, 0x40, 0x24, 1, 0x01 };
+  Receive(other_address, client_address, response, sizeof(response));
+  Receive(node_address, other_address, response, sizeof(response));
+
+  TEST_ASSERT_EQUAL_UINT8(0, activityCount);
+  TEST_ASSERT_TRUE(gea2_erd_batch_reader_busy(&reader));
+}
+
+static void should_ignore_malformed_responses()
+{
+  const tiny_erd_t erds[] = { 0x4024, 0x4025 };
+  Read(erds, element_count(erds));
+
+  const uint8_t wrongCommand[] = { 0xF1, 1, 0x40, 0x24, 1, 0x01 };
+  const uint8_t noErds[] = { read_command, 0 };
+  const uint8_t tooManyErds[] = { read_command, 3, 0x40, 0x24, 1, 0x01, 0x40, 0x25, 1, 0x02, 0x40, 0x24, 1, 0x03 };
+  const uint8_t unrequestedErd[] = { read_command, 1, 0x40, 0x26, 1, 0x01 };
+  const uint8_t truncatedHeader[] = { read_command, 1, 0x40, 0x24 };
+  const uint8_t truncatedData[] = { read_command, 1, 0x40, 0x24, 2, 0x01 };
+  const uint8_t trailingBytes[] = { read_command, 1, 0x40, 0x24, 1, 0x01, 0x00 };
+  const uint8_t headerOnly[] = { read_command };
+
+  Receive(node_address, client_address, wrongCommand, sizeof(wrongCommand));
+  Receive(node_address, client_address, noErds, sizeof(noErds));
+  Receive(node_address, client_address, tooManyErds, sizeof(tooManyErds));
+  Receive(node_address, client_address, unrequestedErd, sizeof(unrequestedErd));
+  Receive(node_address, client_address, truncatedHeader, sizeof(truncatedHeader));
+  Receive(node_address, client_address, truncatedData, sizeof(truncatedData));
+  Receive(node_address, client_address, trailingBytes, sizeof(trailingBytes));
+  Receive(node_address, client_address, headerOnly, sizeof(headerOnly));
+
+  TEST_ASSERT_EQUAL_UINT8(0, activityCount);
+  TEST_ASSERT_TRUE(gea2_erd_batch_reader_busy(&reader));
+}
+
+static void should_ignore_responses_when_no_batch_is_outstanding()
+{
+  const uint8_t response[] = { read_command, 1, 0x40, 0x24, 1, 0x01 };
+  Receive(node_address, client_address, response, sizeof(response));
+  TEST_ASSERT_EQUAL_UINT8(0, activityCount);
+}
+
+static void should_retry_on_timeout_and_then_fail_the_batch()
+{
+  const tiny_erd_t erds[] = { 0x4024, 0x4025 };
+  Read(erds, element_count(erds));
+
+  for(uint8_t attempt = 1; attempt <= request_retries; attempt++) {
+    AfterTimeout();
+    TEST_ASSERT_EQUAL_UINT8(1 + attempt, bus.sendCount);
+    TEST_ASSERT_EQUAL_UINT8(0, activityCount);
+  }
+
+  AfterTimeout();
+  TEST_ASSERT_EQUAL_UINT8(1, activityCount);
+  TEST_ASSERT_EQUAL_UINT8(gea2_erd_batch_reader_activity_type_batch_failed, activities[0].args.type);
+  TEST_ASSERT_EQUAL_UINT8(2, activities[0].args.batch_failed.erd_count);
+  TEST_ASSERT_EQUAL_UINT32(request_retries, gea2_erd_batch_reader_retries_sent(&reader));
+  TEST_ASSERT_FALSE(gea2_erd_batch_reader_busy(&reader));
+}
+
+static void should_count_every_attempt_in_the_bus_bytes()
+{
+  const tiny_erd_t erds[] = { 0x4024 };
+  Read(erds, element_count(erds));
+  AfterTimeout();
+
+  const uint8_t response[] = { read_command, 1, 0x40, 0x24, 1, 0x01 };
+  Receive(node_address, client_address, response, sizeof(response));
+
+  uint16_t request = 4 + GEA2_ROUND_TRIP_ESTIMATOR_FRAME_OVERHEAD;
+  uint16_t reply = sizeof(response) + GEA2_ROUND_TRIP_ESTIMATOR_FRAME_OVERHEAD;
+  TEST_ASSERT_EQUAL_UINT16(2 * request + reply, activities[1].args.batch_completed.bus_bytes);
+}
+
+static void ReadNextBatch(void*, const void* _args)
+{
+  auto args = reinterpret_cast<const gea2_erd_batch_reader_on_activity_args_t*>(_args);
+  if(args->type == gea2_erd_batch_reader_activity_type_read_completed) {
+    const tiny_erd_t next[] = { 0x4030 };
+    gea2_erd_batch_reader_read(&reader, other_address, next, nullptr, element_count(next));
+  }
+}
+
+static void should_report_the_batch_read_even_if_the_next_one_is_started_from_a_read()
+{
+  tiny_event_subscription_t nextBatch;
+  tiny_event_subscription_init(&nextBatch, nullptr, ReadNextBatch);
+  tiny_event_subscribe(gea2_erd_batch_reader_on_activity(&reader), &nextBatch);
+
+  const tiny_erd_t erds[] = { 0x4024, 0x4025 };
+  Read(erds, element_count(erds));
+  const uint8_t response[] = { read_command, 1, 0x40, 0x24, 1, 0x01 };
+  Receive(node_address, client_address, response, sizeof(response));
+  tiny_event_unsubscribe(gea2_erd_batch_reader_on_activity(&reader), &nextBatch);
+
+  uint16_t request = 6 + GEA2_ROUND_TRIP_ESTIMATOR_FRAME_OVERHEAD;
+  uint16_t reply = sizeof(response) + GEA2_ROUND_TRIP_ESTIMATOR_FRAME_OVERHEAD;
+  TEST_ASSERT_EQUAL_UINT8(2, activityCount);
+  TEST_ASSERT_EQUAL_UINT8(gea2_erd_batch_reader_activity_type_batch_completed, activities[1].args.type);
+  TEST_ASSERT_EQUAL_HEX8(node_address, activities[1].args.address);
+  TEST_ASSERT_EQUAL_UINT8(2, activities[1].args.batch_completed.erd_count);
+  TEST_ASSERT_EQUAL_UINT16(request + reply, activities[1].args.batch_completed.bus_bytes);
+  TEST_ASSERT_EQUAL_UINT8(2, bus.sendCount);
+  TEST_ASSERT_TRUE(gea2_erd_batch_reader_busy(&reader));
+}
+
+static tiny_time_source_ticks_t TicksUntilRetry()
+{
+  tiny_time_source_ticks_t start = time_source.ticks;
+  AfterTimeout();
+  return time_source.ticks - start;
+}
+
+static void should_wait_for_the_response_expected_from_the_erd_sizes()
+{
+  const tiny_erd_t erds[] = { 0x4024, 0x4025 };
+  const uint8_t sizes[] = { 2, 1 };
+  const uint8_t unknownSize[] = { 2, 0 };
+  uint16_t request = 6 + GEA2_ROUND_TRIP_ESTIMATOR_FRAME_OVERHEAD;
+  uint16_t response = 2 + (3 + 2) + (3 + 1) + GEA2_ROUND_TRIP_ESTIMATOR_FRAME_OVERHEAD;
+  uint16_t largestResponse = receive_buffer_size - 5 + GEA2_ROUND_TRIP_ESTIMATOR_FRAME_OVERHEAD;
+
+  TEST_ASSERT_TRUE(gea2_erd_batch_reader_read(&reader, node_address, erds, sizes, element_count(erds)));
+  TEST_ASSERT_EQUAL_UINT32(initial_timeout + gea2_round_trip_estimator_wire_time(request + response), TicksUntilRetry());
+  gea2_erd_batch_reader_cancel(&reader);
+
+  TEST_ASSERT_TRUE(gea2_erd_batch_reader_read(&reader, node_address, erds, unknownSize, element_count(erds)));
+  TEST_ASSERT_EQUAL_UINT32(initial_timeout + gea2_round_trip_estimator_wire_time(request + largestResponse), TicksUntilRetry());
+  gea2_erd_batch_reader_cancel(&reader);
+
+  Read(erds, element_count(erds));
+  TEST_ASSERT_EQUAL_UINT32(initial_timeout + gea2_round_trip_estimator_wire_time(request + largestResponse), TicksUntilRetry());
+}
+
+static void should_drop_a_cancelled_batch_without_reporting_it()
+{
+  const tiny_erd_t erds[] = { 0x4024 };
+  Read(erds, element_count(erds));
+  gea2_erd_batch_reader_cancel(&reader);
+  After(max_timeout * (request_retries + 1));
+
+  TEST_ASSERT_FALSE(gea2_erd_batch_reader_busy(&reader));
+  TEST_ASSERT_EQUAL_UINT8(1, bus.sendCount);
+  TEST_ASSERT_EQUAL_UINT8(0, activityCount);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(should_send_one_request_with_every_erd);
+  RUN_TEST(should_reject_a_second_batch_while_one_is_outstanding);
+  RUN_TEST(should_reject_empty_and_oversized_batches);
+  RUN_TEST(should_raise_each_erd_read_and_then_the_batch);
+  RUN_TEST(should_accept_a_response_with_only_some_of_the_erds);
+  RUN_TEST(should_ignore_responses_from_other_nodes_or_to_other_clients);
+  RUN_TEST(should_ignore_malformed_responses);
+  RUN_TEST(should_ignore_responses_when_no_batch_is_outstanding);
+  RUN_TEST(should_retry_on_timeout_and_then_fail_the_batch);
+  RUN_TEST(should_count_every_attempt_in_the_bus_bytes);
+  RUN_TEST(should_report_the_batch_read_even_if_the_next_one_is_started_from_a_read);
+  RUN_TEST(should_wait_for_the_response_expected_from_the_erd_sizes);
+  RUN_TEST(should_drop_a_cancelled_batch_without_reporting_it);
+  return UNITY_END();
+}
@@ -0,0 +1,220 @@
+/*!
+ * @file
+ * @brief Node scan: the version request broadcast and which answers count as nodes.
+ */
+
+#include <cstring>
+#include <unity.h>
+
+extern "C" {
+#include "Gea2NodeScanner.h"
+#include "tiny_gea_constants.h"
+#include "tiny_timer.h"
+}
+
+enum {
+  client_address = 0xE4,
+  other_client_address = 0xBE,
+  machine_control = 0xC0,
+  other_node = 0xC8,
+  version_command = 0x01,
+  listen_time = 500,
+  max_activities = 8
+};
+
+typedef union {
+  tiny_gea_packet_t packet;
+  uint8_t buffer[sizeof(tiny_gea_packet_t) + UINT8_MAX];
+} packet_buffer_t;
+
+static struct {
+  i_tiny_time_source_t interface;
+  tiny_time_source_ticks_t ticks;
+} time_source;
+
+static struct {
+  i_tiny_gea_interface_t interface;
+  tiny_event_t on_receive;
+  packet_buffer_t sent;
+  uint8_t sendCount;
+} bus;
+
+static gea2_node_scanner_on_activity_args_t activities[max_activities];
+static uint8_t scanned_addresses[GEA2_NODE_SCANNER_MAX_NODES];
+static uint8_t activityCount;
+
+static tiny_timer_group_t timer_group;
+static Gea2NodeScanner_t scanner;
+static tiny_event_subscription_t activity_subscription;
+
+static const uint8_t version[] = { version_command, 0x00, 0x03, 0x00, 0x01 };
+
+static tiny_time_source_ticks_t Ticks(i_tiny_time_source_t*)
+{
+  return time_source.ticks;
+}
+
+static const i_tiny_time_source_api_t time_source_api = { Ticks };
+
+static bool Send(
+  i_tiny_gea_interface_t*,
+  uint8_t destination,
+  uint8_t payload_length,
+  void* context,
+  tiny_gea_interface_send_callback_t callback)
+{
+  bus.sent.packet.destination = destination;
+  bus.sent.packet.payload_length = payload_length;
+  bus.sent.packet.source = client_address;
+  callback(context, &bus.sent.packet);
+  bus.sendCount++;
+  return true;
+}
+
+static bool Forward(i_tiny_gea_interface_t*, uint8_t, uint8_t, void*, tiny_gea_interface_send_callback_t)
+{
+  return false;
+}
+
+static i_tiny_event_t* OnReceive(i_tiny_gea_interface_t*)
+{
+  return &bus.on_receive.interface;
+}
+
+static const i_tiny_gea_interface_api_t bus_api = { Send, Forward, OnReceive };
+
+static void ActivityRaised(void*, const void* _args)
+{
+  auto args = reinterpret_cast<const gea2_node_scanner_on_activity_args_t*>(_args);
+  if(activityCount < max_activities) {
+    activities[activityCount] = *args;
+    if(args->type == gea2_node_scanner_activity_type_scan_completed) {
+      memcpy(scanned_addresses, args->scan_completed.addresses, args->scan_completed.node_count);
+    }
+    activityCount++;
+  }
+}
+
+static void After(tiny_time_source_ticks_t ticks)
+{
+  while(ticks-- > 0) {
+    time_source.ticks++;
+    tiny_timer_group_run(&timer_group);
+  }
+}
+
+static void Receive(uint8_t source, uint8_t destination, const uint8_t* payload, uint8_t payloadLength)
+{
+  packet_buffer_t packet;
+  packet.packet.source = source;
+  packet.packet.destination = destination;
+  packet.packet.payload_length = payloadLength;
+  memcpy(packet.packet.payload, payload, payloadLength);
+  tiny_gea_interface_on_receive_args_t args = { &packet.packet };
+  tiny_event_publish(&bus.on_receive, &args);
+}
+
+static void AssertScanCompletedWith(uint8_t nodeCount)
+{
+  TEST_ASSERT_GREATER_THAN_UINT32(0, activityCount);
+  const gea2_node_scanner_on_activity_args_t* completed = &activities[activityCount - 1];
+  TEST_ASSERT_EQUAL_UINT8(gea2_node_scanner_activity_type_scan_completed, completed->type);
+  TEST_ASSERT_EQUAL_UINT8(nodeCount, completed->scan_completed.node_count);
+}
+
+void setUp()
+{
+  time_source.interface.api = &time_source_api;
+  time_source.ticks = 0;
+  bus.interface.api = &bus_api;
+  bus.sendCount = 0;
+  tiny_event_init(&bus.on_receive);
+  activityCount = 0;
+
+  tiny_timer_group_init(&timer_group, &time_source.interface);
+  gea2_node_scanner_init(&scanner, &timer_group, &bus.interface, client_address);
+  tiny_event_subscription_init(&activity_subscription, nullptr, ActivityRaised);
+  tiny_event_subscribe(gea2_node_scanner_on_activity(&scanner), &activity_subscription);
+}
+
+void tearDown()
+{
+}
+
+static void should_broadcast_a_version_request()
+{
+  TEST_ASSERT_TRUE(gea2_node_scanner_scan(&scanner, listen_time));
+
+  TEST_ASSERT_EQUAL_UINT8(1, bus.sendCount);
+  TEST_ASSERT_EQUAL_HEX8(tiny_gea_broadcast_address, bus.sent.packet.destination);
+  TEST_ASSERT_EQUAL_UINT8(1, bus.sent.packet.payload_length);
+  TEST_ASSERT_EQUAL_HEX8(version_command, bus.sent.packet.payload[0]);
+  TEST_ASSERT_FALSE(gea2_node_scanner_scan(&scanner, listen_time));
+}
+
+static void should_report_each_node_that_answers_once()
+{
+  gea2_node_scanner_scan(&scanner, listen_time);
+  Receive(machine_control, client_address, version, sizeof(version));
+  Receive(other_node, client_address, version, sizeof(version));
+  Receive(machine_control, client_address, version, sizeof(version));
+  After(listen_time);
+
+  TEST_ASSERT_EQUAL_UINT8(3, activityCount);
+  TEST_ASSERT_EQUAL_UINT8(gea2_node_scanner_activity_type_node_found, activities[0].type);
+  TEST_ASSERT_EQUAL_HEX8(machine_control, activities[0].node_found.address);
+  TEST_ASSERT_EQUAL_HEX8(other_node, activities[1].node_found.address);
+  AssertScanCompletedWith(2);
+  TEST_ASSERT_EQUAL_HEX8(machine_control, scanned_addresses[0]);
+  TEST_ASSERT_EQUAL_HEX8(other_node, scanned_addresses[1]);
+}
+
+static void should_only_count_version_responses_addressed_to_the_client()
+{
+  const uint8_t request[] = { version_command };
+  const uint8_t erdRead[] = { version_command, 0x00, 0x01, 0x00 };
+
+  gea2_node_scanner_scan(&scanner, listen_time);
+  Receive(other_client_address, tiny_gea_broadcast_address, request, sizeof(request));
+  Receive(machine_control, other_client_address, version, sizeof(version));
+  Receive(machine_control, tiny_gea_broadcast_address, version, sizeof(version));
+  Receive(other_node, client_address, erdRead, sizeof(erdRead));
+  Receive(other_node, client_address, request, sizeof(request));
+  After(listen_time);
+
+  TEST_ASSERT_EQUAL_UINT8(1, activityCount);
+  AssertScanCompletedWith(0);
+}
+
+static void should_ignore_answers_outside_a_scan()
+{
+  Receive(machine_control, client_address, version, sizeof(version));
+  gea2_node_scanner_scan(&scanner, listen_time);
+  gea2_node_scanner_cancel(&scanner);
+  Receive(other_node, client_address, version, sizeof(version));
+  After(listen_time);
+
+  TEST_ASSERT_EQUAL_UINT8(0, activityCount);
+}
+
+static void should_stop_counting_at_the_node_limit()
+{
+  gea2_node_scanner_scan(&scanner, listen_time);
+  for(uint8_t i = 0; i < GEA2_NODE_SCANNER_MAX_NODES + 2; i++) {
+    Receive(machine_control + i, client_address, version, sizeof(version));
+  }
+  After(listen_time);
+
+  AssertScanCompletedWith(GEA2_NODE_SCANNER_MAX_NODES);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(should_broadcast_a_version_request);
+  RUN_TEST(should_report_each_node_that_answers_once);
+  RUN_TEST(should_only_count_version_responses_addressed_to_the_client);
+  RUN_TEST(should_ignore_answers_outside_a_scan);
+  RUN_TEST(should_stop_counting_at_the_node_limit);
+  return UNITY_END();
+}
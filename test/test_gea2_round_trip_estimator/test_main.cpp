@@ -0,0 +1,143 @@
+/*!
+ * @file
+ * @brief Round trip estimates: wire time, the initial timeout and timeouts from measured nodes.
+ */
+
+#include <unity.h>
+
+extern "C" {
+#include "Gea2RoundTripEstimator.h"
+}
+
+enum {
+  machine_control = 0xC0,
+  other_node = 0xC8,
+  initial_timeout = 250,
+  max_timeout = 500,
+  deviations = 4,
+  min_samples = 4,
+  // Deviation never taken as less than 2 ms, and 2 ms more for the timer
+  min_spread = deviations * 2 + 2,
+  wire_time = 20
+};
+
+static Gea2RoundTripEstimator_t estimator;
+
+static void GivenSamples(uint8_t address, uint16_t turnaround, uint8_t count)
+{
+  while(count-- > 0) {
+    gea2_round_trip_estimator_add_sample(&estimator, address, turnaround);
+  }
+}
+
+void setUp()
+{
+  gea2_round_trip_estimator_init(&estimator, initial_timeout, max_timeout, deviations);
+}
+
+void tearDown()
+{
+}
+
+static void should_round_wire_time_up_to_the_millisecond()
+{
+  TEST_ASSERT_EQUAL_UINT16(0, gea2_round_trip_estimator_wire_time(0));
+  TEST_ASSERT_EQUAL_UINT16(1, gea2_round_trip_estimator_wire_time(1));
+  TEST_ASSERT_EQUAL_UINT16(2, gea2_round_trip_estimator_wire_time(2));
+  TEST_ASSERT_EQUAL_UINT16(521, gea2_round_trip_estimator_wire_time(1000));
+}
+
+static void should_add_the_wire_time_to_the_initial_timeout_until_a_node_is_measured()
+{
+  TEST_ASSERT_EQUAL_UINT16(initial_timeout + wire_time, gea2_round_trip_estimator_timeout(&estimator, machine_control, wire_time));
+
+  GivenSamples(machine_control, 10, min_samples - 1);
+  TEST_ASSERT_EQUAL_UINT16(initial_timeout + wire_time, gea2_round_trip_estimator_timeout(&estimator, machine_control, wire_time));
+  TEST_ASSERT_EQUAL_UINT16(initial_timeout, gea2_round_trip_estimator_timeout(&estimator, machine_control, 0));
+}
+
+static void should_time_out_after_the_wire_time_the_mean_and_the_deviations()
+{
+  GivenSamples(machine_control, 10, min_samples);
+
+  TEST_ASSERT_EQUAL_UINT16(wire_time + 10 + min_spread, gea2_round_trip_estimator_timeout(&estimator, machine_control, wire_time));
+  TEST_ASSERT_EQUAL_UINT16(initial_timeout + wire_time, gea2_round_trip_estimator_timeout(&estimator, other_node, wire_time));
+}
+
+static void should_allow_more_time_for_a_node_that_varies()
+{
+  GivenSamples(machine_control, 10, min_samples);
+  uint16_t steady = gea2_round_trip_estimator_timeout(&estimator, machine_control, wire_time);
+
+  for(uint8_t i = 0; i < 16; i++) {
+    gea2_round_trip_estimator_add_sample(&estimator, machine_control, (i % 2) ? 30 : 10);
+  }
+
+  uint8_t address;
+  uint16_t mean;
+  uint16_t deviation;
+  TEST_ASSERT_TRUE(gea2_round_trip_estimator_node(&estimator, 0, &address, &mean, &deviation));
+  TEST_ASSERT_GREATER_THAN_UINT16(2, deviation);
+  TEST_ASSERT_GREATER_THAN_UINT16(steady, gea2_round_trip_estimator_timeout(&estimator, machine_control, wire_time));
+}
+
+static void should_never_wait_longer_than_the_max_timeout()
+{
+  TEST_ASSERT_EQUAL_UINT16(max_timeout, gea2_round_trip_estimator_timeout(&estimator, machine_control, max_timeout - initial_timeout + 1));
+
+  GivenSamples(machine_control, 1000, min_samples);
+  TEST_ASSERT_EQUAL_UINT16(max_timeout, gea2_round_trip_estimator_timeout(&estimator, machine_control, 0));
+
+  uint8_t address;
+  uint16_t mean;
+  uint16_t deviation;
+  TEST_ASSERT_TRUE(gea2_round_trip_estimator_node(&estimator, 0, &address, &mean, &deviation));
+  TEST_ASSERT_EQUAL_UINT16(max_timeout, mean);
+}
+
+static void should_report_each_node_measured()
+{
+  GivenSamples(machine_control, 10, 1);
+  GivenSamples(other_node, 40, 1);
+
+  uint8_t address;
+  uint16_t mean;
+  uint16_t deviation;
+  TEST_ASSERT_TRUE(gea2_round_trip_estimator_node(&estimator, 0, &address, &mean, &deviation));
+  TEST_ASSERT_EQUAL_HEX8(machine_control, address);
+  TEST_ASSERT_EQUAL_UINT16(10, mean);
+  TEST_ASSERT_EQUAL_UINT16(0, deviation);
+  TEST_ASSERT_TRUE(gea2_round_trip_estimator_node(&estimator, 1, &address, &mean, &deviation));
+  TEST_ASSERT_EQUAL_HEX8(other_node, address);
+  TEST_ASSERT_EQUAL_UINT16(40, mean);
+  TEST_ASSERT_FALSE(gea2_round_trip_estimator_node(&estimator, 2, &address, &mean, &deviation));
+}
+
+static void should_stop_measuring_new_nodes_at_the_node_limit()
+{
+  for(uint8_t i = 0; i <= GEA2_ROUND_TRIP_ESTIMATOR_MAX_NODES; i++) {
+    GivenSamples(machine_control + i, 10, min_samples);
+  }
+
+  uint8_t address;
+  uint16_t mean;
+  uint16_t deviation;
+  TEST_ASSERT_TRUE(gea2_round_trip_estimator_node(&estimator, GEA2_ROUND_TRIP_ESTIMATOR_MAX_NODES - 1, &address, &mean, &deviation));
+  TEST_ASSERT_FALSE(gea2_round_trip_estimator_node(&estimator, GEA2_ROUND_TRIP_ESTIMATOR_MAX_NODES, &address, &mean, &deviation));
+  TEST_ASSERT_EQUAL_UINT16(
+    initial_timeout + wire_time,
+    gea2_round_trip_estimator_timeout(&estimator, machine_control + GEA2_ROUND_TRIP_ESTIMATOR_MAX_NODES, wire_time));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(should_round_wire_time_up_to_the_millisecond);
+  RUN_TEST(should_add_the_wire_time_to_the_initial_timeout_until_a_node_is_measured);
+  RUN_TEST(should_time_out_after_the_wire_time_the_mean_and_the_deviations);
+  RUN_TEST(should_allow_more_time_for_a_node_that_varies);
+  RUN_TEST(should_never_wait_longer_than_the_max_timeout);
+  RUN_TEST(should_report_each_node_measured);
+  RUN_TEST(should_stop_measuring_new_nodes_at_the_node_limit);
+  return UNITY_END();
+}
@@ -0,0 +1,246 @@
+/*!
+ * @file
+ * @brief Known polling profiles: model keys, the encoded form and storage.
+ */
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <cstdlib>
+#include <cstring>
+#include <unity.h>
+
+extern "C" {
+#include "PollingProfiles.h"
+}
+
+enum {
+  max_erds = 8,
+  water_heater = 0x00,
+  refrigerator = 0x03,
+  machine_control = 0xC0,
+  other_board = 0xC8
+};
+
+static tiny_erd_t erds[max_erds];
+static uint8_t sizes[max_erds];
+static uint8_t addresses[max_erds];
+static polling_profile_t profile;
+
+static const char modelNumber[] = "GE-1234";
+
+void setUp()
+{
+  memset(erds, 0, sizeof(erds));
+  memset(sizes, 0, sizeof(sizes));
+  memset(addresses, 0, sizeof(addresses));
+  profile.applianceType = 0xFF;
+  profile.address = 0;
+  profile.erdCount = 0;
+  profile.erds = erds;
+  profile.sizes = sizes;
+  profile.addresses = addresses;
+}
+
+void tearDown()
+{
+}
+
+static void should_key_models_by_appliance_type_and_model_number()
+{
+  uint32_t key = polling_profile_key(water_heater, modelNumber, sizeof(modelNumber) - 1);
+
+  TEST_ASSERT_NOT_EQUAL(0, key);
+  TEST_ASSERT_EQUAL_HEX32(key, polling_profile_key(water_heater, modelNumber, sizeof(modelNumber) - 1));
+  TEST_ASSERT_NOT_EQUAL(key, polling_profile_key(refrigerator, modelNumber, sizeof(modelNumber) - 1));
+  TEST_ASSERT_NOT_EQUAL(key, polling_profile_key(water_heater, "GE-1235", 7));
+  TEST_ASSERT_NOT_EQUAL(key, polling_profile_key(water_heater, modelNumber, sizeof(modelNumber) - 2));
+}
+
+static void should_decode_a_version_1_profile()
+{
+  const uint8_t encoded[] = {
+    0x01, water_heater, machine_control, 0x00, 0x00, 0x02,
+    0x00, 0x01, 0x20,
+    0x40, 0x24, 0x02
+  };
+
+  TEST_ASSERT_EQUAL_UINT(sizeof(encoded), polling_profile_encoded_size(encoded));
+  TEST_ASSERT_TRUE(polling_profile_decode(&profile, max_erds, encoded, sizeof(encoded)));
+  TEST_ASSERT_EQUAL_HEX8(water_heater, profile.applianceType);
+  TEST_ASSERT_EQUAL_HEX8(machine_control, profile.address);
+  TEST_ASSERT_EQUAL_UINT16(2, profile.erdCount);
+  TEST_ASSERT_EQUAL_HEX16(0x0001, erds[0]);
+  TEST_ASSERT_EQUAL_UINT8(0x20, sizes[0]);
+  TEST_ASSERT_EQUAL_HEX16(0x4024, erds[1]);
+  TEST_ASSERT_EQUAL_UINT8(2, sizes[1]);
+}
+
+static void should_read_every_erd_of_a_version_1_profile_from_the_machine_control()
+{
+  const uint8_t encoded[] = {
+    0x01, water_heater, machine_control, 0x00, 0x00, 0x02,
+    0x00, 0x01, 0x20,
+    0x40, 0x24, 0x02
+  };
+
+  TEST_ASSERT_TRUE(polling_profile_decode(&profile, max_erds, encoded, sizeof(encoded)));
+  TEST_ASSERT_EQUAL_HEX8(machine_control, addresses[0]);
+  TEST_ASSERT_EQUAL_HEX8(machine_control, addresses[1]);
+}
+
+static void should_reject_a_profile_whose_length_does_not_match_its_count()
+{
+  const uint8_t encoded[] = {
+    0x01, water_heater, machine_control, 0x00, 0x00, 0x02,
+    0x00, 0x01, 0x20,
+    0x40, 0x24, 0x02,
+    0x00
+  };
+
+  TEST_ASSERT_FALSE(polling_profile_decode(&profile, max_erds, encoded, sizeof(encoded)));
+  TEST_ASSERT_FALSE(polling_profile_decode(&profile, max_erds, encoded, sizeof(encoded) - 2));
+  TEST_ASSERT_FALSE(polling_profile_decode(&profile, max_erds, encoded, POLLING_PROFILE_HEADER_SIZE - 1));
+}
+
+static void should_reject_a_profile_with_more_erds_than_fit()
+{
+  const uint8_t encoded[] = {
+    0x01, water_heater, machine_control, 0x00, 0x00, 0x02,
+    0x00, 0x01, 0x20,
+    0x40, 0x24, 0x02
+  };
+
+  TEST_ASSERT_FALSE(polling_profile_decode(&profile, 1, encoded, sizeof(encoded)));
+}
+
+static void should_reject_unknown_versions()
+{
+  const uint8_t version0[] = { 0x00, water_heater, machine_control, 0x00, 0x00, 0x00 };
+  const uint8_t version9[] = { 0x09, water_heater, machine_control, 0x00, 0x00, 0x00 };
+
+  TEST_ASSERT_EQUAL_UINT(0, polling_profile_encoded_size(version0));
+  TEST_ASSERT_EQUAL_UINT(0, polling_profile_encoded_size(version9));
+  TEST_ASSERT_FALSE(polling_profile_decode(&profile, max_erds, version0, sizeof(version0)));
+  TEST_ASSERT_FALSE(polling_profile_decode(&profile, max_erds, version9, sizeof(version9)));
+}
+
+static void GivenAProfileOnTwoBoards()
+{
+  profile.applianceType = refrigerator;
+  profile.address = machine_control;
+  profile.erdCount = 3;
+  erds[0] = 0x0001;
+  sizes[0] = 0x20;
+  addresses[0] = machine_control;
+  erds[1] = 0x1004;
+  sizes[1] = 0;
+  addresses[1] = machine_control;
+  erds[2] = 0x1205;
+  sizes[2] = 4;
+  addresses[2] = other_board;
+}
+
+static void should_encode_a_version_2_profile_with_the_board_of_every_erd()
+{
+  const uint8_t expected[] = {
+    0x02, refrigerator, machine_control, 0x00, 0x00, 0x03,
+    0x00, 0x01, 0x20, machine_control,
+    0x10, 0x04, 0x00, machine_control,
+    0x12, 0x05, 0x04, other_board
+  };
+  uint8_t encoded[POLLING_PROFILE_SIZE(max_erds)];
+
+  GivenAProfileOnTwoBoards();
+
+  TEST_ASSERT_EQUAL_UINT(sizeof(expected), polling_profile_encode(&profile, encoded, sizeof(encoded)));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, encoded, sizeof(expected));
+  TEST_ASSERT_EQUAL_UINT(sizeof(expected), polling_profile_encoded_size(encoded));
+}
+
+static void should_not_encode_a_profile_that_does_not_fit()
+{
+  uint8_t encoded[POLLING_PROFILE_SIZE(3)];
+
+  GivenAProfileOnTwoBoards();
+
+  TEST_ASSERT_EQUAL_UINT(0, polling_profile_encode(&profile, encoded, sizeof(encoded) - 1));
+  TEST_ASSERT_EQUAL_UINT(sizeof(encoded), polling_profile_encode(&profile, encoded, sizeof(encoded)));
+}
+
+static void should_decode_what_was_encoded()
+{
+  uint8_t encoded[POLLING_PROFILE_SIZE(max_erds)];
+
+  GivenAProfileOnTwoBoards();
+  size_t size = polling_profile_encode(&profile, encoded, sizeof(encoded));
+  setUp();
+
+  TEST_ASSERT_TRUE(polling_profile_decode(&profile, max_erds, encoded, size));
+  TEST_ASSERT_EQUAL_HEX8(refrigerator, profile.applianceType);
+  TEST_ASSERT_EQUAL_HEX8(machine_control, profile.address);
+  TEST_ASSERT_EQUAL_UINT16(3, profile.erdCount);
+  TEST_ASSERT_EQUAL_HEX16(0x1004, erds[1]);
+  TEST_ASSERT_EQUAL_UINT8(0, sizes[1]);
+  TEST_ASSERT_EQUAL_HEX8(machine_control, addresses[1]);
+  TEST_ASSERT_EQUAL_HEX16(0x1205, erds[2]);
+  TEST_ASSERT_EQUAL_UINT8(4, sizes[2]);
+  TEST_ASSERT_EQUAL_HEX8(other_board, addresses[2]);
+}
+
+static void should_reject_a_version_2_profile_with_version_1_entries()
+{
+  const uint8_t encoded[] = {
+    0x02, water_heater, machine_control, 0x00, 0x00, 0x02,
+    0x00, 0x01, 0x20,
+    0x40, 0x24, 0x02
+  };
+
+  TEST_ASSERT_EQUAL_UINT(POLLING_PROFILE_SIZE(2), polling_profile_encoded_size(encoded));
+  TEST_ASSERT_FALSE(polling_profile_decode(&profile, max_erds, encoded, sizeof(encoded)));
+}
+
+static void should_load_the_profile_saved_for_a_key()
+{
+  char stateDirectory[] = "/tmp/gea2-polling-profiles-XXXXXX";
+  TEST_ASSERT_NOT_NULL(mkdtemp(stateDirectory));
+  Preferences::setStateDirectory(stateDirectory);
+
+  uint32_t key = polling_profile_key(water_heater, modelNumber, sizeof(modelNumber) - 1);
+  TEST_ASSERT_FALSE(polling_profile_load(key, &profile, max_erds));
+
+  profile.applianceType = water_heater;
+  profile.address = machine_control;
+  profile.erdCount = 2;
+  erds[0] = 0x0001;
+  sizes[0] = 0x20;
+  addresses[0] = machine_control;
+  erds[1] = 0x4024;
+  sizes[1] = 2;
+  addresses[1] = machine_control;
+  TEST_ASSERT_TRUE(polling_profile_save(key, &profile));
+
+  setUp();
+  TEST_ASSERT_TRUE(polling_profile_load(key, &profile, max_erds));
+  TEST_ASSERT_EQUAL_HEX8(water_heater, profile.applianceType);
+  TEST_ASSERT_EQUAL_UINT16(2, profile.erdCount);
+  TEST_ASSERT_EQUAL_HEX16(0x4024, erds[1]);
+  TEST_ASSERT_EQUAL_UINT8(2, sizes[1]);
+  TEST_ASSERT_FALSE(polling_profile_load(key + 1, &profile, max_erds));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(should_key_models_by_appliance_type_and_model_number);
+  RUN_TEST(should_decode_a_version_1_profile);
+  RUN_TEST(should_read_every_erd_of_a_version_1_profile_from_the_machine_control);
+  RUN_TEST(should_reject_a_profile_whose_length_does_not_match_its_count);
+  RUN_TEST(should_reject_a_profile_with_more_erds_than_fit);
+  RUN_TEST(should_reject_unknown_versions);
+  RUN_TEST(should_encode_a_version_2_profile_with_the_board_of_every_erd);
+  RUN_TEST(should_not_encode_a_profile_that_does_not_fit);
+  RUN_TEST(should_decode_what_was_encoded);
+  RUN_TEST(should_reject_a_version_2_profile_with_version_1_entries);
+  RUN_TEST(should_load_the_profile_saved_for_a_key);
+  return UNITY_END();
+}
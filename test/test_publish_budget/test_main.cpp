@@ -0,0 +1,416 @@
+/*!
+ * @file
+ * @brief Publish budget of the bridge per appliance-hour.
+ *
+ * The bridge runs against a simulated water heater on a simulated bus, in simulated time. As on
+ * the adapter it publishes through the MQTT queue, with the publish counter behind it as a
+ * recording client in place of a broker, so only what leaves the queue is counted. The
+ * appliance changes one ERD every 5 seconds, so after discovery an hour of polling should
+ * publish that ERD once per change and nothing else, plus the telemetry.
+ */
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unity.h>
+
+extern "C" {
+#include "Gea2BusSniffer.h"
+#include "Gea2ErdBatchReader.h"
+#include "Gea2ErdSubscriber.h"
+#include "Gea2MqttBridge.h"
+#include "Gea2NodeScanner.h"
+#include "Gea2RoundTripEstimator.h"
+#include "MqttPublishCounter.h"
+#include "QueuedMqttClient.h"
+#include "tiny_gea2_erd_client.h"
+#include "tiny_gea_constants.h"
+#include "tiny_timer.h"
+#include "tiny_utils.h"
+}
+
+enum {
+  client_address = 0xE4,
+  appliance_address = 0xC0,
+  version_command = 0x01,
+  read_command = 0xF0,
+  write_command = 0xF1,
+  changing_erd = 0x4024,
+  change_period = 5000,
+  turnaround = 2,
+  receive_buffer_size = 255,
+  max_erd_size = 32,
+  max_pending_packets = 8,
+  ticks_per_minute = 60000,
+  warm_up_minutes = 10,
+  minutes_per_hour = 60,
+  seconds_per_hour = 3600,
+  changes_per_hour = minutes_per_hour * ticks_per_minute / change_period,
+  erd_value_message_tolerance = 5,
+  changing_erd_hex_size = 4,
+  // uptime, minHeap, currentHeap and lastErd every second, and busUtilization every 10
+  telemetry_messages_per_second = 4,
+  bus_utilization_period = 10,
+  telemetry_messages_per_hour =
+    seconds_per_hour * telemetry_messages_per_second + seconds_per_hour / bus_utilization_period,
+  // Uptime has at most 4 digits in the first hours, both heap sizes are 0 on Linux, lastErd is
+  // "0x4024" and busUtilization at most "100"
+  telemetry_bytes_per_second = 4 + 1 + 1 + 6,
+  bus_utilization_bytes = 3,
+  telemetry_bytes_per_hour =
+    seconds_per_hour * telemetry_bytes_per_second + seconds_per_hour / bus_utilization_period * bus_utilization_bytes,
+  budget_margin_percent = 10,
+  telemetry_messages_per_hour_budget = telemetry_messages_per_hour * (100 + budget_margin_percent) / 100,
+  telemetry_bytes_per_hour_budget = telemetry_bytes_per_hour * (100 + budget_margin_percent) / 100
+};
+
+typedef struct {
+  tiny_erd_t erd;
+  uint8_t size;
+  uint8_t data[max_erd_size];
+} simulated_erd_t;
+
+typedef union {
+  tiny_gea_packet_t packet;
+  uint8_t buffer[sizeof(tiny_gea_packet_t) + UINT8_MAX];
+} packet_buffer_t;
+
+typedef struct {
+  uint32_t due;
+  packet_buffer_t packet;
+} pending_packet_t;
+
+// Water heater ERDs, the same as script/gea2-appliance-simulator answers
+static simulated_erd_t erds[] = {
+  { 0x0001, 32, { 'S', 'I', 'M', 'U', 'L', 'A', 'T', 'E', 'D' } },
+  { 0x0002, 32, { 'S', 'I', 'M', '0', '0', '0', '1' } },
+  { 0x0008, 1, { 0x00 } },
+  { 0x0035, 4, { 0x00, 0x00, 0x00, 0x01 } },
+  { 0x4008, 2, { 0x00, 0x78 } },
+  { 0x4009, 1, { 0x01 } },
+  { changing_erd, 2, { 0x00, 0x00 } },
+  { 0x4025, 1, { 0x00 } }
+};
+
+static struct {
+  i_tiny_time_source_t interface;
+  tiny_time_source_ticks_t ticks;
+} time_source;
+
+// Answers as the appliance after the request and response would have crossed the bus
+static struct {
+  i_tiny_gea_interface_t interface;
+  tiny_event_t on_receive;
+  uint32_t now;
+  pending_packet_t pending[max_pending_packets];
+  uint8_t pendingCount;
+} bus;
+
+static tiny_timer_group_t timer_group;
+static tiny_gea2_erd_client_t erd_client;
+static uint8_t client_queue_buffer[1024];
+static Gea2RoundTripEstimator_t round_trip_estimator;
+static Gea2ErdBatchReader_t batch_reader;
+static Gea2ErdBatchReader_t probe_reader;
+static Gea2NodeScanner_t node_scanner;
+static Gea2BusSniffer_t bus_sniffer;
+static Gea2ErdSubscriber_t erd_subscriber;
+static MqttPublishCounter_t publish_counter;
+static QueuedMqttClient_t queued_client;
+static Gea2MqttBridge_t bridge;
+static mqtt_publish_counts_t hour;
+static uint32_t queue_drops;
+
+static const tiny_gea2_erd_client_configuration_t client_configuration = {
+  .request_timeout = 250,
+  .request_retries = 10
+};
+
+static tiny_time_source_ticks_t Ticks(i_tiny_time_source_t*)
+{
+  return time_source.ticks;
+}
+
+static const i_tiny_time_source_api_t time_source_api = { Ticks };
+
+static simulated_erd_t* FindErd(tiny_erd_t erd)
+{
+  for(auto& simulated : erds) {
+    if(simulated.erd == erd) {
+      return &simulated;
+    }
+  }
+  return nullptr;
+}
+
+static tiny_gea_packet_t* QueueResponse(const tiny_gea_packet_t* request)
+{
+  if(bus.pendingCount >= max_pending_packets) {
+    return nullptr;
+  }
+  tiny_gea_packet_t* response = &bus.pending[bus.pendingCount++].packet.packet;
+  response->destination = request->source;
+  response->source = appliance_address;
+  response->payload_length = 0;
+  return response;
+}
+
+static void Read(const tiny_gea_packet_t* request)
+{
+  tiny_gea_packet_t* response = QueueResponse(request);
+  if(response == nullptr) {
+    return;
+  }
+
+  uint8_t found = 0;
+  uint8_t length = 2;
+  for(uint8_t i = 0; (i < request->payload[1]) && (3 + i * 2 < request->payload_length); i++) {
+    const simulated_erd_t* simulated = FindErd((request->payload[2 + i * 2] << 8) | request->payload[3 + i * 2]);
+    if(simulated) {
+      response->payload[length++] = simulated->erd >> 8;
+      response->payload[length++] = simulated->erd & 0xFF;
+      response->payload[length++] = simulated->size;
+      memcpy(&response->payload[length], simulated->data, simulated->size);
+      length += simulated->size;
+      found++;
+    }
+  }
+
+  // Reads of ERDs the appliance does not have go unanswered
+  if(found == 0) {
+    bus.pendingCount--;
+    return;
+  }
+  response->payload[0] = read_command;
+  response->payload[1] = found;
+  response->payload_length = length;
+}
+
+static void Write(const tiny_gea_packet_t* request)
+{
+  if((request->payload_length < 5) || (request->payload[1] != 1)) {
+    return;
+  }
+  simulated_erd_t* simulated = FindErd((request->payload[2] << 8) | request->payload[3]);
+  if(!simulated || (simulated->size != request->payload[4]) || (request->payload_length != 5 + simulated->size)) {
+    return;
+  }
+  memcpy(simulated->data, &request->payload[5], simulated->size);
+
+  tiny_gea_packet_t* response = QueueResponse(request);
+  if(response) {
+    memcpy(response->payload, request->payload, 4);
+    response->payload_length = 4;
+  }
+}
+
+static void ApplianceReceived(const tiny_gea_packet_t* request)
+{
+  if(((request->destination != appliance_address) && (request->destination != tiny_gea_broadcast_address)) ||
+    (request->payload_length == 0)) {
+    return;
+  }
+
+  uint8_t queued = bus.pendingCount;
+  switch(request->payload[0]) {
+    case version_command: {
+      tiny_gea_packet_t* response = QueueResponse(request);
+      if(response) {
+        const uint8_t version[] = { version_command, 0, 0, 0, 1 };
+        memcpy(response->payload, version, sizeof(version));
+        response->payload_length = sizeof(version);
+      }
+    } break;
+
+    case read_command:
+      Read(request);
+      break;
+
+    case write_command:
+      Write(request);
+      break;
+  }
+
+  if(bus.pendingCount > queued) {
+    pending_packet_t* pending = &bus.pending[queued];
+    uint16_t bytes = request->payload_length + pending->packet.packet.payload_length + 2 * GEA2_ROUND_TRIP_ESTIMATOR_FRAME_OVERHEAD;
+    pending->due = bus.now + gea2_round_trip_estimator_wire_time(bytes) + turnaround;
+  }
+}
+
+static bool Send(
+  i_tiny_gea_interface_t*,
+  uint8_t destination,
+  uint8_t payload_length,
+  void* context,
+  tiny_gea_interface_send_callback_t callback)
+{
+  packet_buffer_t request;
+  request.packet.destination = destination;
+  request.packet.payload_length = payload_length;
+  request.packet.source = client_address;
+  callback(context, &request.packet);
+  ApplianceReceived(&request.packet);
+  return true;
+}
+
+static bool Forward(
+  i_tiny_gea_interface_t*,
+  uint8_t,
+  uint8_t,
+  void*,
+  tiny_gea_interface_send_callback_t)
+{
+  return false;
+}
+
+static i_tiny_event_t* OnReceive(i_tiny_gea_interface_t*)
+{
+  return &bus.on_receive.interface;
+}
+
+static const i_tiny_gea_interface_api_t bus_api = { Send, Forward, OnReceive };
+
+static void DeliverDuePackets()
+{
+  for(uint8_t i = 0; i < bus.pendingCount;) {
+    if((int32_t)(bus.now - bus.pending[i].due) < 0) {
+      i++;
+      continue;
+    }
+
+    // Delivering may queue more responses, so take the packet off the list first
+    packet_buffer_t packet = bus.pending[i].packet;
+    memmove(&bus.pending[i], &bus.pending[i + 1], (bus.pendingCount - i - 1) * sizeof(bus.pending[0]));
+    bus.pendingCount--;
+
+    tiny_gea_interface_on_receive_args_t args = { &packet.packet };
+    tiny_event_publish(&bus.on_receive, &args);
+  }
+}
+
+static void ChangeErd()
+{
+  simulated_erd_t* simulated = FindErd(changing_erd);
+  uint16_t value = ((simulated->data[0] << 8) | simulated->data[1]) + 1;
+  simulated->data[0] = value >> 8;
+  simulated->data[1] = value & 0xFF;
+}
+
+static void RunFor(uint32_t ticks)
+{
+  while(ticks-- > 0) {
+    bus.now++;
+    time_source.ticks++;
+    if((bus.now % change_period) == 0) {
+      ChangeErd();
+    }
+    DeliverDuePackets();
+    queued_mqtt_client_run_bus(&queued_client);
+    tiny_timer_group_run(&timer_group);
+    queued_mqtt_client_run_network(&queued_client);
+  }
+}
+
+static void RunApplianceHour()
+{
+  // Start without a stored poll list or profile
+  char stateDirectory[] = "/tmp/gea2-publish-budget-XXXXXX";
+  if(mkdtemp(stateDirectory)) {
+    Preferences::setStateDirectory(stateDirectory);
+  }
+
+  time_source.interface.api = &time_source_api;
+  time_source.ticks = 0;
+  bus.interface.api = &bus_api;
+  bus.now = 0;
+  bus.pendingCount = 0;
+  tiny_event_init(&bus.on_receive);
+
+  tiny_timer_group_init(&timer_group, &time_source.interface);
+  tiny_gea2_erd_client_init(
+    &erd_client,
+    &timer_group,
+    &bus.interface,
+    client_queue_buffer,
+    sizeof(client_queue_buffer),
+    &client_configuration);
+  gea2_round_trip_estimator_init(&round_trip_estimator, 250, 500, 4);
+  gea2_erd_batch_reader_init(&batch_reader, &timer_group, &bus.interface, client_address, receive_buffer_size, &round_trip_estimator, 4);
+  gea2_erd_batch_reader_init(&probe_reader, &timer_group, &bus.interface, client_address, receive_buffer_size, &round_trip_estimator, 1);
+  gea2_node_scanner_init(&node_scanner, &timer_group, &bus.interface, client_address);
+  gea2_bus_sniffer_init(&bus_sniffer, &bus.interface, client_address);
+  gea2_erd_subscriber_init(&erd_subscriber, &timer_group, &bus.interface, client_address, client_configuration.request_timeout, 2);
+  mqtt_publish_counter_init(&publish_counter, nullptr);
+  queued_mqtt_client_init(&queued_client, &publish_counter.interface);
+  gea2_mqtt_bridge_init(
+    &bridge,
+    &timer_group,
+    &erd_client.interface,
+    &batch_reader,
+    &probe_reader,
+    &node_scanner,
+    &bus_sniffer,
+    &erd_subscriber,
+    &queued_client.interface,
+    "storage");
+
+  // Discovery and the first publish of every ERD are not part of the steady state
+  RunFor(warm_up_minutes * ticks_per_minute);
+  mqtt_publish_counter_reset(&publish_counter);
+  RunFor(minutes_per_hour * ticks_per_minute);
+  hour = *mqtt_publish_counter_counts(&publish_counter);
+  queue_drops = queued_mqtt_client_dropped(&queued_client);
+  printf(
+    "Per hour: %u ERD value, %u write result and %u telemetry messages, %u telemetry bytes, %u queue drops\n",
+    (unsigned)hour.erd_values.messages,
+    (unsigned)hour.write_results.messages,
+    (unsigned)hour.telemetry.messages,
+    (unsigned)hour.telemetry.bytes,
+    (unsigned)queue_drops);
+
+  gea2_mqtt_bridge_destroy(&bridge);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void should_publish_each_erd_change_once()
+{
+  TEST_ASSERT_UINT32_WITHIN(erd_value_message_tolerance, changes_per_hour, hour.erd_values.messages);
+  TEST_ASSERT_EQUAL_UINT32(hour.erd_values.messages * changing_erd_hex_size, hour.erd_values.bytes);
+}
+
+static void should_publish_no_write_results_without_writes()
+{
+  TEST_ASSERT_EQUAL_UINT32(0, hour.write_results.messages);
+}
+
+static void should_drop_nothing_in_the_mqtt_queue()
+{
+  TEST_ASSERT_EQUAL_UINT32(0, queue_drops);
+}
+
+static void should_keep_telemetry_within_budget()
+{
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(telemetry_messages_per_hour_budget, hour.telemetry.messages);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(telemetry_bytes_per_hour_budget, hour.telemetry.bytes);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RunApplianceHour();
+  RUN_TEST(should_publish_each_erd_change_once);
+  RUN_TEST(should_publish_no_write_results_without_writes);
+  RUN_TEST(should_drop_nothing_in_the_mqtt_queue);
+  RUN_TEST(should_keep_telemetry_within_budget);
+  return UNITY_END();
+}
@@ -0,0 +1,120 @@
+/*!
+ * @file
+ * @brief Byte queue: record order, what fits, wrap around and truncated pops.
+ */
+
+#include <cstring>
+#include <unity.h>
+
+extern "C" {
+#include "SpscByteQueue.h"
+}
+
+enum {
+  length_prefix_size = 2,
+  queue_size = 16,
+  // One byte of the buffer is always left free
+  largest_record = queue_size - 1 - length_prefix_size
+};
+
+static uint8_t buffer[queue_size];
+static spsc_byte_queue_t queue;
+
+static void AssertPopped(const char* expected)
+{
+  char record[queue_size];
+  uint16_t size = strlen(expected);
+  TEST_ASSERT_EQUAL_UINT16(size, spsc_byte_queue_pop(&queue, record, sizeof(record)));
+  TEST_ASSERT_EQUAL_MEMORY(expected, record, size);
+}
+
+static void AssertEmpty()
+{
+  uint8_t record[queue_size];
+  TEST_ASSERT_EQUAL_UINT16(0, spsc_byte_queue_pop(&queue, record, sizeof(record)));
+}
+
+void setUp()
+{
+  memset(buffer, 0xA5, sizeof(buffer));
+  spsc_byte_queue_init(&queue, buffer, sizeof(buffer));
+}
+
+void tearDown()
+{
+}
+
+static void should_be_empty_after_init()
+{
+  AssertEmpty();
+}
+
+static void should_pop_records_in_the_order_they_were_pushed()
+{
+  TEST_ASSERT_TRUE(spsc_byte_queue_push(&queue, "abc", 3));
+  TEST_ASSERT_TRUE(spsc_byte_queue_push(&queue, "d", 1));
+  TEST_ASSERT_TRUE(spsc_byte_queue_push(&queue, "ef", 2));
+
+  AssertPopped("abc");
+  AssertPopped("d");
+  AssertPopped("ef");
+  AssertEmpty();
+}
+
+static void should_fill_all_but_one_byte_of_the_buffer()
+{
+  const char record[] = "0123456789abc";
+  TEST_ASSERT_EQUAL_UINT(largest_record, sizeof(record) - 1);
+
+  TEST_ASSERT_FALSE(spsc_byte_queue_push(&queue, "0123456789abcd", largest_record + 1));
+  TEST_ASSERT_TRUE(spsc_byte_queue_push(&queue, record, largest_record));
+  AssertPopped(record);
+}
+
+static void should_leave_the_queue_unchanged_when_a_record_does_not_fit()
+{
+  TEST_ASSERT_TRUE(spsc_byte_queue_push(&queue, "abcdef", 6));
+  TEST_ASSERT_FALSE(spsc_byte_queue_push(&queue, "ghijkl", 6));
+  TEST_ASSERT_TRUE(spsc_byte_queue_push(&queue, "ghijk", 5));
+  TEST_ASSERT_FALSE(spsc_byte_queue_push(&queue, "", 0));
+
+  AssertPopped("abcdef");
+  AssertPopped("ghijk");
+  AssertEmpty();
+}
+
+static void should_wrap_records_around_the_end_of_the_buffer()
+{
+  for(uint8_t i = 0; i < 3 * queue_size; i++) {
+    char record[] = { 'a', 'b', 'c', 'd', 'e', (char)('0' + i % 10), '\0' };
+    TEST_ASSERT_TRUE(spsc_byte_queue_push(&queue, record, 6));
+    TEST_ASSERT_TRUE(spsc_byte_queue_push(&queue, "xyz", 3));
+    AssertPopped(record);
+    AssertPopped("xyz");
+  }
+  AssertEmpty();
+}
+
+static void should_drop_what_does_not_fit_in_the_record_popped_into()
+{
+  char record[4];
+
+  TEST_ASSERT_TRUE(spsc_byte_queue_push(&queue, "abcdef", 6));
+  TEST_ASSERT_TRUE(spsc_byte_queue_push(&queue, "gh", 2));
+
+  TEST_ASSERT_EQUAL_UINT16(3, spsc_byte_queue_pop(&queue, record, 3));
+  TEST_ASSERT_EQUAL_MEMORY("abc", record, 3);
+  AssertPopped("gh");
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(should_be_empty_after_init);
+  RUN_TEST(should_pop_records_in_the_order_they_were_pushed);
+  RUN_TEST(should_fill_all_but_one_byte_of_the_buffer);
+  RUN_TEST(should_leave_the_queue_unchanged_when_a_record_does_not_fit);
+  RUN_TEST(should_wrap_records_around_the_end_of_the_buffer);
+  RUN_TEST(should_drop_what_does_not_fit_in_the_record_popped_into);
+  return UNITY_END();
+}